@@ -6,25 +6,65 @@
 // project
 #include "application.hpp"
 #include "opengl.hpp"
+#include "cgra/cgra_cpu_profiler.hpp"
+#include "cgra/cgra_frame_arena.hpp"
+#include "cgra/cgra_gpu_memory.hpp"
+#include "cgra/cgra_gpu_profiler.hpp"
 #include "cgra/cgra_gui.hpp"
-#include "cgra/cgra_image.hpp"
+#include "cgra/cgra_jobs.hpp"
+#include "cgra/cgra_scene.hpp"
 #include "cgra/cgra_shader.hpp"
-#include "cgra/cgra_wavefront.hpp"
 
 
 using namespace std;
 using namespace cgra;
 
 
-Application::Application(GLFWwindow *window) : m_window(window) {
+namespace {
+	//const char *teapot_texture = "work/res/textures/uv_texture.jpg";
+	const char *teapot_texture = "work/res/textures/checkerboard.jpg";
+	const char *teapot_mesh = "work/res/assets/teapot.obj";
+}
+
+
+void Application::preload() {
+	Teapot::preload();
+}
+
+
+Application::Application(GLFWwindow *window) : m_window(window), m_test_teapot(m_assets) {
 	// compile axis shader
+	m_axis_shader = m_shaders.add("work/res/shaders/axis.glsl", { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER });
+
+	// compile fallback shader for anything still compiling
+	// this is the only shader we wait for
 	{
 		shader_builder prog;
-		prog.set_shader(GL_VERTEX_SHADER, "work/res/shaders/axis.glsl");
-		prog.set_shader(GL_GEOMETRY_SHADER, "work/res/shaders/axis.glsl");
-		prog.set_shader(GL_FRAGMENT_SHADER, "work/res/shaders/axis.glsl");
-		m_axis_shader = prog.build();
+		prog.set_shader(GL_VERTEX_SHADER, "work/res/shaders/simple_grey.glsl");
+		prog.set_shader(GL_FRAGMENT_SHADER, "work/res/shaders/simple_grey.glsl");
+		m_shaders.fallback(prog.build());
 	}
+
+	m_teapot_node = m_transforms.create();
+
+	// over the GPU memory budget, unused cached assets go first
+	gpu_memory::current().evictor([this](size_t bytes) { return m_assets.evict(bytes); });
+}
+
+
+Application::~Application() {
+	gpu_memory::current().evictor(nullptr);
+}
+
+
+bool Application::setScene(const string &scene) {
+	bool debug = scene == "debug";
+	if (scene != "teapot" && scene != "textured" && scene != "wireframe" && !debug) return false;
+	m_show_axis = debug;
+	m_test_teapot.m_show_abb = debug;
+	m_test_teapot.m_show_texture = debug || scene == "textured";
+	m_test_teapot.m_show_wireframe = scene == "wireframe";
+	return true;
 }
 
 
@@ -79,9 +119,11 @@ void Application::charCallback(unsigned int c) {
 
 
 void Application::render() {
+	CGRA_GPU_SCOPE("render");
+
 	// retrieve the window hieght
-	int width, height;
-	glfwGetFramebufferSize(m_window, &width, &height);
+	int width = m_fixed_width, height = m_fixed_height;
+	if (!width || !height) glfwGetFramebufferSize(m_window, &width, &height);
 
 	// update window size
 	m_windowsize = vec2(width, height);
@@ -93,27 +135,55 @@ void Application::render() {
 	glClearColor(0.3f, 0.3f, 0.4f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	// check on any shaders still compiling, run main thread jobs
+	// and upload finished assets
+	m_shaders.poll();
+	job_system::current().run_main_jobs();
+	m_assets.update();
+	gpu_memory::current().update();
+
 	// enable flags for normal/forward rendering
-	glEnable(GL_DEPTH_TEST); 
-	glDepthFunc(GL_LESS);
+	gl_state &state = gl_state::current();
+	state.depth_test(true);
+	state.depth_func(GL_LESS);
 
 	// calculate the projection and view matrix
 	mat4 proj = perspective(1.0, float(width) / height, 0.1, 1000.0);
 	mat4 view = translate3(0, 0, -m_distance) * rotate3x(m_pitch) * rotate3y(m_yaw);
 
 	// draw axis
-	if (m_show_axis) {
-		// load shader and variables (no model matrix needed)
-		glUseProgram(m_axis_shader);
-		glUniformMatrix4fv(glGetUniformLocation(m_axis_shader, "uProjectionMatrix"), 1, false, proj.data());
-		glUniformMatrix4fv(glGetUniformLocation(m_axis_shader, "uModelViewMatrix"), 1, false, view.data());
-		// the shader requires 6 instances to draw all 6 lines for the axes
-		// geometry is created inside the shader
-		draw_dummy(6);
+	if (m_show_axis && m_shaders.ready(m_axis_shader)) {
+		draw_packet axis;
+		axis.key = draw_queue::make_key(0, false, m_axis_shader, 0, m_distance);
+		axis.program = m_axis_shader;
+		axis.draw = [=](GLuint shader) {
+			// load variables (no model matrix needed)
+			glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, proj.data());
+			glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, false, view.data());
+			// the shader requires 6 instances to draw all 6 lines for the axes
+			// geometry is created inside the shader
+			draw_dummy(6);
+		};
+		m_draw_queue.submit(std::move(axis));
 	}
 
+	// only changed subtrees are recomputed
+	m_transforms.update();
+
 	// draw the teapot
-	m_test_teapot.draw(view, proj);
+	m_test_teapot.draw(m_draw_queue, view, proj, m_transforms.world(m_teapot_node));
+
+	// draw the extra teapots
+	if (m_scene.size() != size_t(m_instance_count)) m_test_teapot.createInstances(m_scene, m_instance_count);
+	m_test_teapot.updateInstances(m_scene);
+	update_world_transforms(m_scene);
+	m_visible_instances = cull_entities(m_scene, view, proj);
+	submit_draws(m_scene, proj, m_draw_queue);
+
+	// sort and issue all the draws
+	CGRA_ZONE("draw queue");
+	CGRA_GPU_SCOPE("draw queue");
+	m_draw_queue.flush();
 }
 
 
@@ -121,7 +191,7 @@ void Application::renderGUI() {
 
 	// setup window
 	ImGui::SetNextWindowPos(ImVec2(5, 5), ImGuiCond_Once);
-	ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiCond_Once);
+	ImGui::SetNextWindowSize(ImVec2(300, 400), ImGuiCond_Once);
 	ImGui::Begin("Camera", 0);
 
 	// display current camera parameters
@@ -137,84 +207,136 @@ void Application::renderGUI() {
 	ImGui::Checkbox("Show AABB", &m_test_teapot.m_show_abb);
 	ImGui::SameLine();
 	ImGui::Checkbox("Show Texture", &m_test_teapot.m_show_texture);
+	ImGui::SliderInt("Instances", &m_instance_count, 0, 100000);
+	ImGui::Text("%zu instances visible", m_visible_instances);
+
+	// redundant state changes dropped by the state cache
+	const gl_state::counters &gl_calls = gl_state::current().last_frame();
+	ImGui::Text("GL state calls %u (%u redundant skipped)", gl_calls.issued, gl_calls.skipped);
+	const draw_queue::stats &queue_stats = m_draw_queue.last_flush();
+	ImGui::Text("%zu draws, state changes %zu (unsorted %zu)", queue_stats.packets, queue_stats.changes_sorted, queue_stats.changes_unsorted);
+
+	// where the CPU and GPU time goes
+	cpu_profiler::current().render_gui();
+	gpu_profiler::current().render_gui();
+	gpu_memory::current().render_gui();
+	frame_arena::current().render_gui();
 
 	// finish creating window
 	ImGui::End();
 }
 
 
-Teapot::Teapot() {
+Teapot::Teapot(asset_cache &assets) : m_assets(&assets) {
 
-	// compile grey shader
-	shader_builder prog;
-	prog.set_shader(GL_VERTEX_SHADER, "work/res/shaders/simple_grey.glsl");
-	prog.set_shader(GL_FRAGMENT_SHADER, "work/res/shaders/simple_grey.glsl");
-	m_grey_shader = prog.build();
-
-	// compile texture shader
-	prog = shader_builder();
-	prog.set_shader(GL_VERTEX_SHADER, "work/res/shaders/simple_texture.glsl");
-	prog.set_shader(GL_FRAGMENT_SHADER, "work/res/shaders/simple_texture.glsl");
-	m_texture_shader = prog.build();
+	// request shaders, texture and mesh
+	// shaders are compiled and the texture and mesh are loaded in the background
+	m_grey_shader = assets.load_program("work/res/shaders/simple_grey.glsl", { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER });
+	m_texture_shader = assets.load_program("work/res/shaders/simple_texture.glsl", { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER });
+	m_aabb_shader = assets.load_program("work/res/shaders/aabb.glsl", { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER });
+	m_texture = assets.load_texture(teapot_texture);
+	m_mesh = assets.load_mesh(teapot_mesh);
+}
 
-	// compile aabb shader
-	prog = shader_builder();
-	prog.set_shader(GL_VERTEX_SHADER, "work/res/shaders/aabb.glsl");
-	prog.set_shader(GL_GEOMETRY_SHADER, "work/res/shaders/aabb.glsl");
-	prog.set_shader(GL_FRAGMENT_SHADER, "work/res/shaders/aabb.glsl");
-	m_aabb_shader = prog.build();
 
-	// load texture
-	//image<float, 4> img("work/res/textures/uv_texture.jpg");
-	image<float, 4> img("work/res/textures/checkerboard.jpg");
-	m_texture = img.upload_texture();
+void Teapot::preload() {
+	asset_cache::preload_texture(teapot_texture);
+	asset_cache::preload_mesh(teapot_mesh);
+}
 
-	// load mesh
-	mesh_builder md = cgra::load_wavefront_data("work/res/assets/teapot.obj");
-	m_mesh = md.build(m_mesh);
 
-	// compute min/max
-	if (md.vertices().size()) {
-		m_min = m_max = md.vertices()[0].pos;
-		for (auto &v : md.vertices()) {
-			m_min = min(m_min, v.pos);
-			m_max = max(m_max, v.pos);
-		}
-	}
-}
+void Teapot::draw(draw_queue &queue, const cgra::mat4 &view, const cgra::mat4 &proj, const cgra::mat4 &model) {
 
+	// nothing to draw until the mesh has loaded
+	mesh_asset *geometry = m_mesh.get();
+	if (!geometry) return;
+	const vec3 min = geometry->min;
+	const vec3 max = geometry->max;
 
-void Teapot::draw(const cgra::mat4 &view, const cgra::mat4 &proj) {
+	// the texture (if loaded)
+	const GLuint texture = m_texture.ready() ? m_texture->texture : 0;
 
 	// create the model/view matrix
-	mat4 modelview = view;
+	mat4 modelview = view * model;
+
+	// view space distance to the centre for depth sorting
+	float depth = -(modelview * vec4((min + max) / 2.0f, 1)).z;
 
 
 	// draw the AABB
-	if (m_show_abb) {
-		// load shader and variables
-		glUseProgram(m_aabb_shader);
-		glUniformMatrix4fv(glGetUniformLocation(m_aabb_shader, "uProjectionMatrix"), 1, false, proj.data());
-		glUniformMatrix4fv(glGetUniformLocation(m_aabb_shader, "uModelViewMatrix"), 1, false, modelview.data());
-		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMin"), 1, m_min.data());
-		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMax"), 1, m_max.data());
-		// the shader requires 12 instances to draw all 12 lines for the aabb
-		// geometry is created inside the shader
-		draw_dummy(12);
+	// (geometry is created in the shader, so there is nothing to fall back to)
+	if (m_show_abb && m_assets->ready(m_aabb_shader)) {
+		draw_packet aabb;
+		aabb.program = m_assets->resolve(m_aabb_shader);
+		aabb.key = draw_queue::make_key(0, false, aabb.program, 0, depth);
+		aabb.draw = [=](GLuint shader) {
+			// load variables
+			glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, proj.data());
+			glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, false, modelview.data());
+			glUniform3fv(glGetUniformLocation(shader, "uMin"), 1, min.data());
+			glUniform3fv(glGetUniformLocation(shader, "uMax"), 1, max.data());
+			// the shader requires 12 instances to draw all 12 lines for the aabb
+			// geometry is created inside the shader
+			draw_dummy(12);
+		};
+		queue.submit(std::move(aabb));
 	}
 
 
-	// load shader and variables
-	GLuint shader = (m_show_texture) ? m_texture_shader : m_grey_shader;
-	glUseProgram(shader);
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, proj.data());
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, false, modelview.data());
+	// load shader (using the fallback until compiled) and texture
+	draw_packet teapot;
+	teapot.program = m_assets->resolve((m_show_texture) ? m_texture_shader : m_grey_shader);
+	teapot.texture = texture;
+	teapot.polygon_mode = (m_show_wireframe) ? GL_LINE : GL_FILL;
+	teapot.key = draw_queue::make_key(0, false, teapot.program, texture, depth);
+	const bool wireframe = m_show_wireframe;
+	teapot.draw = [=](GLuint shader) {
+		CGRA_GPU_SCOPE("teapot");
+
+		// load variables
+		glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, proj.data());
+		glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, false, modelview.data());
+		gl_state::current().uniform(glGetUniformLocation(shader, "uTexture0"), 0);  // Set our sampler (texture0) to use GL_TEXTURE0 as the source
+
+		// draw
+		geometry->geometry.draw(wireframe);
+	};
+	queue.submit(std::move(teapot));
+}
+
+
+bool Teapot::createInstances(entity_registry &scene, int count) {
+	mesh_asset *geometry = m_mesh.get();
+	if (!geometry) return false;
+	scene.clear();
+
+	// square grid on the xz plane, leaving the centre for this teapot
+	const vec3 size = geometry->max - geometry->min;
+	const float spacing = max(size.x, size.z) * 1.5f;
+	const int side = int(ceil(sqrt(float(count + 1))));
+	int created = 0;
+	for (int z = 0; z < side && created < count; z++) {
+		for (int x = 0; x < side && created < count; x++) {
+			if (x == side / 2 && z == side / 2) continue;
+			transform_component t;
+			t.translation = vec3(x - side / 2, 0, z - side / 2) * spacing;
+			bounds_component b;
+			b.min = geometry->min;
+			b.max = geometry->max;
+			create_renderable(scene, t, b, &geometry->geometry, material_component());
+			created++;
+		}
+	}
+	return true;
+}
 
-	// load texture
-	glActiveTexture(GL_TEXTURE0); // Set the location for binding the texture
-	glBindTexture(GL_TEXTURE_2D, m_texture); // Bind the texture
-	glUniform1i(glGetUniformLocation(shader, "uTexture0"), 0);  // Set our sampler (texture0) to use GL_TEXTURE0 as the source
 
-	// draw
-	m_mesh.draw(m_show_wireframe);
-}
\ No newline at end of file
+void Teapot::updateInstances(entity_registry &scene) {
+	material_component material;
+	material.program = m_assets->resolve((m_show_texture) ? m_texture_shader : m_grey_shader);
+	material.texture = m_texture.ready() ? m_texture->texture : 0;
+	material.wireframe = m_show_wireframe;
+	scene.each_chunk<material_component>([&](size_t, size_t n, material_component *m) {
+		for (size_t i = 0; i < n; i++) m[i] = material;
+	});
+}
@@ -1,34 +1,49 @@
 
 #pragma once
 
+// std
+#include <string>
+
 // project
 #include "opengl.hpp"
+#include "cgra/cgra_asset_cache.hpp"
+#include "cgra/cgra_draw_queue.hpp"
+#include "cgra/cgra_entity.hpp"
 #include "cgra/cgra_math.hpp"
 #include "cgra/cgra_mesh.hpp"
+#include "cgra/cgra_shader.hpp"
+#include "cgra/cgra_transform.hpp"
 
 
 // Teapot for displaying a textured mesh
 //
 class Teapot {
 private:
-	// shaders
-	GLuint m_texture_shader = 0;
-	GLuint m_grey_shader = 0;
-	GLuint m_aabb_shader = 0;
-
-	// data
-	GLuint m_texture;
-	cgra::mesh m_mesh;
-	cgra::vec3 m_min;
-	cgra::vec3 m_max;
+	// shaders, texture and mesh (shared through the application's asset cache)
+	cgra::asset_cache *m_assets;
+	cgra::program_handle m_texture_shader;
+	cgra::program_handle m_grey_shader;
+	cgra::program_handle m_aabb_shader;
+	cgra::texture_handle m_texture;
+	cgra::mesh_handle m_mesh;
 
 public:
 	bool m_show_abb = false;
 	bool m_show_texture = false;
 	bool m_show_wireframe = false;
 
-	Teapot();
-	void draw(const cgra::mat4 &view, const cgra::mat4 &proj);
+	Teapot(cgra::asset_cache &assets);
+
+	// starts decoding the texture and mesh (no GL context needed)
+	static void preload();
+
+	void draw(cgra::draw_queue &queue, const cgra::mat4 &view, const cgra::mat4 &proj, const cgra::mat4 &model = cgra::mat4(1));
+
+	// replaces the entities in scene with count copies of this teapot in a grid
+	// around the origin, and keeps their materials in sync with the options
+	// (returns false, creating nothing, until the mesh has loaded)
+	bool createInstances(cgra::entity_registry &scene, int count);
+	void updateInstances(cgra::entity_registry &scene);
 };
 
 
@@ -40,6 +55,11 @@ private:
 	cgra::vec2 m_windowsize;
 	GLFWwindow *m_window;
 
+	// fixed framebuffer size for offscreen rendering
+	// (zero to use the window's framebuffer size)
+	int m_fixed_width = 0;
+	int m_fixed_height = 0;
+
 	// oribital camera
 	float m_pitch = 0;
 	float m_yaw = 0;
@@ -49,6 +69,13 @@ private:
 	bool m_leftMouseDown = false;
 	cgra::vec2 m_mousePosition;
 
+	// shaders are compiled in the background
+	// and must be constructed before anything that uses them
+	cgra::shader_batch m_shaders;
+
+	// textures, meshes and programs are loaded once and shared
+	cgra::asset_cache m_assets{ m_shaders };
+
 	// axis
 	bool m_show_axis = false;
 	GLuint m_axis_shader = 0;
@@ -56,9 +83,26 @@ private:
 	// geometry
 	Teapot m_test_teapot;
 
+	// world transforms, updated once per frame before drawing
+	cgra::transform_hierarchy m_transforms;
+	cgra::transform_hierarchy::node m_teapot_node;
+
+	// extra teapots, drawn through the entity systems
+	cgra::entity_registry m_scene;
+	int m_instance_count = 0;
+	size_t m_visible_instances = 0;
+
+	// draws are submitted here and sorted to minimize state changes
+	cgra::draw_queue m_draw_queue;
+
 public:
+	// starts decoding assets on the worker threads, call before creating
+	// the window so that decoding overlaps with context creation
+	static void preload();
+
 	// setup
 	Application(GLFWwindow *);
+	~Application();
 
 	// disable copy constructors (for safety)
 	Application(const Application&) = delete;
@@ -71,6 +115,19 @@ public:
 	void keyCallback(int key, int scancode, int action, int mods);
 	void charCallback(unsigned int c);
 
+	// blocks until every asset is ready (for deterministic offscreen rendering)
+	void finishLoading() { m_assets.finish(); }
+
+	// selects a preset of display options: teapot, textured, wireframe or debug
+	// returns false for an unknown scene
+	bool setScene(const std::string &scene);
+
+	// sets the orbital camera directly (for scripted camera paths)
+	void setCamera(float pitch, float yaw, float distance) { m_pitch = pitch; m_yaw = yaw; m_distance = distance; }
+
+	// render at a fixed size instead of the window's size (for offscreen rendering)
+	void setFramebufferSize(int width, int height) { m_fixed_width = width; m_fixed_height = height; }
+
 	// rendering callbacks (every frame)
 	void render();
 	void renderGUI();
@@ -0,0 +1,151 @@
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+// system
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// project
+#include "benchmark.hpp"
+#include "opengl.hpp"
+#include "cgra/cgra_math.hpp"
+
+
+using namespace std;
+
+
+double FrameMetric::mean() const {
+	if (samples.empty()) return 0;
+	return accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+
+double FrameMetric::min() const {
+	if (samples.empty()) return 0;
+	return *min_element(samples.begin(), samples.end());
+}
+
+
+double FrameMetric::max() const {
+	if (samples.empty()) return 0;
+	return *max_element(samples.begin(), samples.end());
+}
+
+
+double FrameMetric::percentile(double p) const {
+	if (samples.empty()) return 0;
+	vector<double> sorted = samples;
+	sort(sorted.begin(), sorted.end());
+	double rank = cgra::clamp(p / 100.0, 0.0, 1.0) * (sorted.size() - 1);
+	size_t lo = size_t(floor(rank));
+	size_t hi = std::min(lo + 1, sorted.size() - 1);
+	return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+
+Benchmark::Benchmark(const string &scene, int width, int height, int warmup, int frames)
+	: m_scene(scene), m_width(width), m_height(height), m_warmup(warmup), m_frames(frames) { }
+
+
+void Benchmark::cameraPath(int frame, float &pitch, float &yaw, float &distance) const {
+	double t = (m_frames > 1) ? double(frame) / (m_frames - 1) : 0.0;
+	yaw = float(-cgra::pi + 2 * cgra::pi * t);
+	pitch = float(0.6 * sin(2 * cgra::pi * t));
+	distance = float(40 + 15 * cos(4 * cgra::pi * t));
+}
+
+
+void Benchmark::addFrame(double cpu_ms, double gpu_ms, double frame_ms) {
+	m_cpu.samples.push_back(cpu_ms);
+	m_gpu.samples.push_back(gpu_ms);
+	m_frame.samples.push_back(frame_ms);
+}
+
+
+void Benchmark::report(ostream &out) const {
+	out << "Benchmark: " << m_scene << " at " << m_width << "x" << m_height;
+	out << ", " << m_warmup << " warm-up + " << m_frames << " frames" << endl;
+	out << "Load time: " << fixed << setprecision(3) << m_load_ms << " ms" << endl;
+	out << "Peak memory: " << peakMemoryKB() << " KB" << endl;
+	out << setw(10) << "metric" << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p95";
+	out << setw(10) << "p99" << setw(10) << "min" << setw(10) << "max" << endl;
+	for (const FrameMetric *m : { &m_cpu, &m_gpu, &m_frame }) {
+		out << setw(10) << m->name << setw(10) << m->mean() << setw(10) << m->percentile(50) << setw(10) << m->percentile(95);
+		out << setw(10) << m->percentile(99) << setw(10) << m->min() << setw(10) << m->max() << endl;
+	}
+	out << defaultfloat;
+}
+
+
+bool Benchmark::writeJson(const string &filename) const {
+	ofstream out(filename);
+	if (!out) {
+		cerr << "Error: Could not open file " << filename << " for writing" << endl;
+		return false;
+	}
+
+	// renderer strings are the only free text, strip anything that needs escaping
+	auto gl_string = [](GLenum name) {
+		const char *s = reinterpret_cast<const char *>(glGetString(name));
+		string r = s ? s : "";
+		r.erase(remove_if(r.begin(), r.end(), [](char c) { return c == '"' || c == '\\' || c < ' '; }), r.end());
+		return r;
+	};
+
+	out << setprecision(9);
+	out << "{" << endl;
+	out << "\t\"scene\": \"" << m_scene << "\"," << endl;
+	out << "\t\"width\": " << m_width << "," << endl;
+	out << "\t\"height\": " << m_height << "," << endl;
+	out << "\t\"warmup\": " << m_warmup << "," << endl;
+	out << "\t\"frames\": " << m_frames << "," << endl;
+	out << "\t\"renderer\": \"" << gl_string(GL_RENDERER) << "\"," << endl;
+	out << "\t\"version\": \"" << gl_string(GL_VERSION) << "\"," << endl;
+	out << "\t\"timestamp\": " << chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() << "," << endl;
+	out << "\t\"load_ms\": " << m_load_ms << "," << endl;
+	out << "\t\"peak_memory_kb\": " << peakMemoryKB() << "," << endl;
+	out << "\t\"metrics\": {" << endl;
+	bool first = true;
+	for (const FrameMetric *m : { &m_cpu, &m_gpu, &m_frame }) {
+		if (!first) out << "," << endl;
+		first = false;
+		out << "\t\t\"" << m->name << "\": {" << endl;
+		out << "\t\t\t\"mean\": " << m->mean() << "," << endl;
+		out << "\t\t\t\"p50\": " << m->percentile(50) << "," << endl;
+		out << "\t\t\t\"p95\": " << m->percentile(95) << "," << endl;
+		out << "\t\t\t\"p99\": " << m->percentile(99) << "," << endl;
+		out << "\t\t\t\"min\": " << m->min() << "," << endl;
+		out << "\t\t\t\"max\": " << m->max() << "," << endl;
+		out << "\t\t\t\"samples\": [";
+		for (size_t i = 0; i < m->samples.size(); i++) {
+			out << (i ? ", " : "") << m->samples[i];
+		}
+		out << "]" << endl << "\t\t}";
+	}
+	out << endl << "\t}" << endl << "}" << endl;
+
+	cout << "Wrote benchmark: " << filename << endl;
+	return bool(out);
+}
+
+
+long peakMemoryKB() {
+#if defined(__unix__) || defined(__APPLE__)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+	return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+	return usage.ru_maxrss; // kilobytes on Linux
+#endif
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// std
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+// Summary statistics of per-frame samples (milliseconds)
+struct FrameMetric {
+	std::string name;
+	std::vector<double> samples;
+
+	double mean() const;
+	double min() const;
+	double max() const;
+
+	// linear interpolation between closest ranks, p in [0, 100]
+	double percentile(double p) const;
+};
+
+
+// Deterministic rendering benchmark. Drives the orbital camera along a
+// scripted path, and collects per-frame CPU, GPU and total frame times
+// (fenced with glFinish) after a number of warm-up frames.
+class Benchmark {
+private:
+	std::string m_scene;
+	int m_width;
+	int m_height;
+	int m_warmup;
+	int m_frames;
+
+	double m_load_ms = 0;
+	FrameMetric m_cpu { "cpu_ms", {} };
+	FrameMetric m_gpu { "gpu_ms", {} };
+	FrameMetric m_frame { "frame_ms", {} };
+
+public:
+	Benchmark(const std::string &scene, int width, int height, int warmup, int frames);
+
+	int warmupFrames() const { return m_warmup; }
+	int measuredFrames() const { return m_frames; }
+
+	// camera parameters for frame i of the measured frames (warm-up uses frame 0)
+	// one full orbit with a slow pitch and distance oscillation
+	void cameraPath(int frame, float &pitch, float &yaw, float &distance) const;
+
+	void setLoadTime(double ms) { m_load_ms = ms; }
+	void addFrame(double cpu_ms, double gpu_ms, double frame_ms);
+
+	const FrameMetric & cpu() const { return m_cpu; }
+	const FrameMetric & gpu() const { return m_gpu; }
+	const FrameMetric & frame() const { return m_frame; }
+
+	// human readable table
+	void report(std::ostream &out) const;
+
+	// JSON with summaries and all samples (used by the perf_compare tool)
+	// returns false if the file could not be written
+	bool writeJson(const std::string &filename) const;
+};
+
+
+// peak resident memory of this process in kilobytes (0 if unknown)
+long peakMemoryKB();
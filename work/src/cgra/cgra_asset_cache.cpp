@@ -0,0 +1,422 @@
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+// project
+#include "cgra_asset_cache.hpp"
+#include "cgra_gl_state.hpp"
+#include "cgra_gpu_memory.hpp"
+#include "cgra_image.hpp"
+#include "cgra_jobs.hpp"
+#include "cgra_soa.hpp"
+#include "cgra_startup_profiler.hpp"
+#include "cgra_wavefront.hpp"
+
+
+namespace cgra {
+
+	namespace detail {
+
+		enum class asset_kind { texture, mesh, program };
+		enum class asset_state { loading, ready, failed };
+
+		struct asset_entry {
+			std::string key;
+			std::string filename;
+			asset_kind kind = asset_kind::texture;
+			texture_params params;
+
+			std::atomic<int> refs{ 0 };
+			std::atomic<asset_state> state{ asset_state::loading };
+			size_t bytes = 0;
+			uint64_t last_used = 0;
+
+			// decoded by a job, then uploaded by a main thread job
+			// (the decoded data is freed after the upload)
+			job_handle decode;
+			job_handle upload;
+			std::string error;
+			std::unique_ptr<image<unsigned char, 4>> pixels;
+			std::unique_ptr<mesh_builder> builder;
+
+			texture_asset texture_data;
+			mesh_asset mesh_data;
+			program_asset program_data;
+		};
+
+		void asset_acquire(asset_entry *e) { e->refs.fetch_add(1, std::memory_order_relaxed); }
+		void asset_release(asset_entry *e) { e->refs.fetch_sub(1, std::memory_order_acq_rel); }
+		bool asset_ready(const asset_entry *e) { return e->state.load(std::memory_order_acquire) == asset_state::ready; }
+	}
+
+
+	using detail::asset_entry;
+	using detail::asset_kind;
+	using detail::asset_state;
+
+
+	namespace {
+
+		std::string texture_key(const std::string &filename, const texture_params &params) {
+			std::ostringstream key;
+			key << "texture:" << asset_cache::canonical_path(filename) << '|' << params.format << '|' << params.wrap;
+			return key.str();
+		}
+
+		std::string mesh_key(const std::string &filename) {
+			return "mesh:" + asset_cache::canonical_path(filename);
+		}
+
+		// for the startup report, the decoders don't say how much they read
+		uint64_t file_size(const std::string &filename) {
+			std::error_code ec;
+			auto size = std::filesystem::file_size(filename, ec);
+			return ec ? 0 : uint64_t(size);
+		}
+
+		std::string phase_name(const char *phase, const std::string &filename) {
+			return phase + std::filesystem::path(filename).filename().string();
+		}
+
+		// new entries with their decode job started, the job shares ownership
+		// so the entry outlives it even if nothing else keeps it
+		std::shared_ptr<asset_entry> decode_texture(const std::string &key, const std::string &filename, const texture_params &params) {
+			auto e = std::make_shared<asset_entry>();
+			e->key = key;
+			e->kind = asset_kind::texture;
+			e->filename = filename;
+			e->params = params;
+			e->decode = job_system::current().run([e]() {
+				startup_phase phase(phase_name("texture decode ", e->filename));
+				phase.add_bytes(file_size(e->filename));
+				try {
+					e->pixels = std::make_unique<image<unsigned char, 4>>(e->filename);
+				}
+				catch (std::exception &ex) {
+					e->error = ex.what();
+				}
+			});
+			return e;
+		}
+
+		std::shared_ptr<asset_entry> decode_mesh(const std::string &key, const std::string &filename) {
+			auto e = std::make_shared<asset_entry>();
+			e->key = key;
+			e->kind = asset_kind::mesh;
+			e->filename = filename;
+			e->decode = job_system::current().run([e]() {
+				startup_phase phase(phase_name("mesh parse ", e->filename));
+				phase.add_bytes(file_size(e->filename));
+				try {
+					e->builder = std::make_unique<mesh_builder>(load_wavefront_data(e->filename));
+					min_max(vec3_soa(e->builder->vertices()), e->mesh_data.min, e->mesh_data.max);
+				}
+				catch (std::exception &ex) {
+					e->error = ex.what();
+				}
+			});
+			return e;
+		}
+
+		// entries started by preload_texture and preload_mesh, waiting for a
+		// cache to take them over
+		std::mutex preload_mutex;
+		std::unordered_map<std::string, std::shared_ptr<asset_entry>> preloaded;
+
+		std::shared_ptr<asset_entry> take_preloaded(const std::string &key) {
+			std::lock_guard<std::mutex> lock(preload_mutex);
+			auto it = preloaded.find(key);
+			if (it == preloaded.end()) return nullptr;
+			std::shared_ptr<asset_entry> e = std::move(it->second);
+			preloaded.erase(it);
+			return e;
+		}
+
+		// starts the decode only if the key is not already being preloaded
+		template <typename Decode>
+		void preload(const std::string &key, Decode decode) {
+			std::lock_guard<std::mutex> lock(preload_mutex);
+			auto &slot = preloaded[key];
+			if (!slot) slot = decode();
+		}
+	}
+
+
+	asset_cache::asset_cache(shader_batch &shaders, size_t budget) : m_shaders(&shaders), m_budget(budget) { }
+
+
+	asset_cache::~asset_cache() {
+		// pending uploads are skipped
+		std::vector<job_handle> uploads;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closing = true;
+			for (asset_entry *e : m_loading) uploads.push_back(e->upload);
+		}
+		for (auto &u : uploads) job_system::current().wait(u);
+
+		const bool has_context = glfwGetCurrentContext() != nullptr;
+		for (auto &pair : m_entries) {
+			if (has_context) destroy(*pair.second);
+		}
+	}
+
+
+	std::string asset_cache::canonical_path(const std::string &filename) {
+		std::error_code ec;
+		auto path = std::filesystem::weakly_canonical(std::filesystem::absolute(filename, ec), ec);
+		return ec ? filename : path.generic_string();
+	}
+
+
+	asset_entry * asset_cache::find(const std::string &key) {
+		// called with the lock held
+		m_stats.requests++;
+		auto it = m_entries.find(key);
+		if (it == m_entries.end()) return nullptr;
+		m_stats.hits++;
+		it->second->last_used = m_frame;
+		return it->second.get();
+	}
+
+
+	asset_entry * asset_cache::insert(std::shared_ptr<asset_entry> entry) {
+		// called with the lock held
+		asset_entry *e = entry.get();
+		e->last_used = m_frame;
+		m_entries[e->key] = std::move(entry);
+		return e;
+	}
+
+
+	void asset_cache::start_upload(asset_entry *e) {
+		// called with the lock held
+		m_loading.push_back(e);
+		e->upload = job_system::current().then_main(e->decode, [this, e]() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_loading.erase(std::find(m_loading.begin(), m_loading.end(), e));
+			if (m_closing) {
+				e->pixels.reset();
+				e->builder.reset();
+				e->state = asset_state::failed;
+				return;
+			}
+			upload(*e);
+		});
+	}
+
+
+	void asset_cache::preload_texture(const std::string &filename, const texture_params &params) {
+		const std::string key = texture_key(filename, params);
+		preload(key, [&]() { return decode_texture(key, filename, params); });
+	}
+
+
+	void asset_cache::preload_mesh(const std::string &filename) {
+		const std::string key = mesh_key(filename);
+		preload(key, [&]() { return decode_mesh(key, filename); });
+	}
+
+
+	texture_handle asset_cache::load_texture(const std::string &filename, const texture_params &params) {
+		const std::string key = texture_key(filename, params);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		asset_entry *e = find(key);
+		if (!e) {
+			std::shared_ptr<asset_entry> entry = take_preloaded(key);
+			if (!entry) entry = decode_texture(key, filename, params);
+			e = insert(std::move(entry));
+			start_upload(e);
+		}
+		return texture_handle(e, &e->texture_data);
+	}
+
+
+	mesh_handle asset_cache::load_mesh(const std::string &filename) {
+		const std::string key = mesh_key(filename);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		asset_entry *e = find(key);
+		if (!e) {
+			std::shared_ptr<asset_entry> entry = take_preloaded(key);
+			if (!entry) entry = decode_mesh(key, filename);
+			e = insert(std::move(entry));
+			start_upload(e);
+		}
+		return mesh_handle(e, &e->mesh_data);
+	}
+
+
+	program_handle asset_cache::load_program(
+		const std::string &filename,
+		std::initializer_list<GLenum> types,
+		const std::vector<std::string> &defines
+	) {
+		std::ostringstream key;
+		key << "program:" << canonical_path(filename);
+		for (GLenum type : types) key << '|' << type;
+		for (auto &d : defines) key << "|#" << d;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		asset_entry *e = find(key.str());
+		if (!e) {
+			auto entry = std::make_shared<asset_entry>();
+			entry->key = key.str();
+			entry->kind = asset_kind::program;
+			entry->filename = filename;
+			shader_builder prog(true);
+			for (auto &d : defines) prog.define(d);
+			for (GLenum type : types) prog.set_shader(type, filename);
+			entry->program_data.program = m_shaders->add(filename, prog);
+			entry->state = asset_state::ready;
+			e = insert(std::move(entry));
+		}
+		return program_handle(e, &e->program_data);
+	}
+
+
+	void asset_cache::upload(asset_entry &e) {
+		e.decode.reset();
+		if (!e.error.empty()) {
+			std::cerr << "Error: Could not load " << e.filename << " : " << e.error << std::endl;
+			e.pixels.reset();
+			e.builder.reset();
+			e.state = asset_state::failed;
+			return;
+		}
+
+		if (e.kind == asset_kind::texture) {
+			CGRA_ZONE("texture upload");
+			startup_phase phase(phase_name("texture upload ", e.filename));
+			e.pixels->wrap({ e.params.wrap, e.params.wrap });
+			e.texture_data.texture = e.pixels->upload_texture(e.params.format, 0, "asset_cache");
+			e.texture_data.size = e.pixels->size();
+			e.bytes = gpu_memory::current().bytes(gpu_resource::texture, e.texture_data.texture);
+			e.pixels.reset();
+		}
+		else if (e.kind == asset_kind::mesh) {
+			CGRA_ZONE("mesh upload");
+			startup_phase phase(phase_name("mesh upload ", e.filename));
+			e.mesh_data.geometry = e.builder->build({}, "asset_cache");
+			gpu_memory &memory = gpu_memory::current();
+			e.bytes = memory.bytes(gpu_resource::buffer, e.mesh_data.geometry.m_vbo) + memory.bytes(gpu_resource::buffer, e.mesh_data.geometry.m_ibo);
+			e.builder.reset();
+		}
+
+		m_memory += e.bytes;
+		e.state = asset_state::ready;
+	}
+
+
+	void asset_cache::destroy(asset_entry &e) {
+		if (e.state != asset_state::ready) return;
+		if (e.kind == asset_kind::texture) {
+			gl_state::current().forget_texture(e.texture_data.texture);
+			gpu_memory::delete_textures(1, &e.texture_data.texture);
+		}
+		else if (e.kind == asset_kind::mesh) {
+			e.mesh_data.geometry.destroy();
+		}
+		else {
+			m_shaders->remove(e.program_data.program);
+			gl_state::current().forget_program(e.program_data.program);
+			glDeleteProgram(e.program_data.program);
+		}
+	}
+
+
+	void asset_cache::update() {
+		CGRA_ZONE("asset update");
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frame++;
+		for (auto &pair : m_entries) {
+			if (pair.second->refs > 0) pair.second->last_used = m_frame;
+		}
+		if (m_memory > m_budget) evict_locked(m_memory - m_budget);
+	}
+
+
+	void asset_cache::finish() {
+		// the uploads run here, on the main thread, as the decodes finish
+		std::vector<job_handle> uploads;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (asset_entry *e : m_loading) uploads.push_back(e->upload);
+		}
+		for (auto &u : uploads) job_system::current().wait(u);
+		m_shaders->finish();
+	}
+
+
+	size_t asset_cache::evict(size_t bytes) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return evict_locked(bytes);
+	}
+
+
+	size_t asset_cache::evict_locked(size_t bytes) {
+		// unused and not loading, least recently used first
+		std::vector<asset_entry *> unused;
+		for (auto &pair : m_entries) {
+			asset_entry *e = pair.second.get();
+			if (e->refs == 0 && e->state != asset_state::loading && e->bytes > 0) unused.push_back(e);
+		}
+		std::sort(unused.begin(), unused.end(), [](asset_entry *a, asset_entry *b) { return a->last_used < b->last_used; });
+
+		size_t freed = 0;
+		for (asset_entry *e : unused) {
+			if (freed >= bytes) break;
+			freed += e->bytes;
+			m_memory -= e->bytes;
+			destroy(*e);
+			m_stats.evictions++;
+			const std::string key = e->key;
+			m_entries.erase(key);
+		}
+		return freed;
+	}
+
+
+	size_t asset_cache::release_unused() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t count = 0;
+		for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+			asset_entry &e = *it->second;
+			if (e.refs == 0 && e.state != asset_state::loading) {
+				m_memory -= e.bytes;
+				destroy(e);
+				m_stats.evictions++;
+				count++;
+				it = m_entries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		return count;
+	}
+
+
+	size_t asset_cache::memory() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_memory;
+	}
+
+
+	size_t asset_cache::size() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+
+	asset_cache::stats asset_cache::statistics() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+}
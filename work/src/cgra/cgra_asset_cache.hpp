@@ -0,0 +1,201 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// project
+#include "cgra_math.hpp"
+#include "cgra_mesh.hpp"
+#include "cgra_shader.hpp"
+#include <opengl.hpp>
+
+
+namespace cgra {
+
+	namespace detail {
+		struct asset_entry;
+		void asset_acquire(asset_entry *e);
+		void asset_release(asset_entry *e);
+		bool asset_ready(const asset_entry *e);
+	}
+
+
+	// load parameters, part of the cache key
+	struct texture_params {
+		GLenum format = GL_RGBA8;
+		GLenum wrap = GL_REPEAT;
+	};
+
+	struct texture_asset {
+		GLuint texture = 0;
+		ivec2 size{ 0 };
+	};
+
+	struct mesh_asset {
+		mesh geometry;
+		vec3 min{ 0 };
+		vec3 max{ 0 };
+	};
+
+	// the program may still be compiling, see asset_cache::resolve
+	struct program_asset {
+		GLuint program = 0;
+	};
+
+
+	// Reference counted handle to an asset in an asset_cache. get() returns
+	// nullptr for an empty handle or while the asset is loading (or if it
+	// failed to load). Handles must not outlive their cache.
+	template <typename T>
+	class asset_handle {
+	private:
+		friend class asset_cache;
+		detail::asset_entry *m_entry = nullptr;
+		T *m_asset = nullptr;
+
+		asset_handle(detail::asset_entry *e, T *asset) : m_entry(e), m_asset(asset) { detail::asset_acquire(e); }
+
+	public:
+		asset_handle() { }
+
+		asset_handle(const asset_handle &other) : m_entry(other.m_entry), m_asset(other.m_asset) {
+			if (m_entry) detail::asset_acquire(m_entry);
+		}
+
+		asset_handle(asset_handle &&other) noexcept : m_entry(other.m_entry), m_asset(other.m_asset) {
+			other.m_entry = nullptr;
+			other.m_asset = nullptr;
+		}
+
+		asset_handle & operator=(asset_handle other) noexcept {
+			std::swap(m_entry, other.m_entry);
+			std::swap(m_asset, other.m_asset);
+			return *this;
+		}
+
+		~asset_handle() { reset(); }
+
+		void reset() {
+			if (m_entry) detail::asset_release(m_entry);
+			m_entry = nullptr;
+			m_asset = nullptr;
+		}
+
+		bool empty() const { return !m_entry; }
+		bool ready() const { return m_entry && detail::asset_ready(m_entry); }
+		T * get() const { return ready() ? m_asset : nullptr; }
+
+		T * operator->() const {
+			assert(ready());
+			return m_asset;
+		}
+
+		friend bool operator==(const asset_handle &a, const asset_handle &b) { return a.m_entry == b.m_entry; }
+		friend bool operator!=(const asset_handle &a, const asset_handle &b) { return a.m_entry != b.m_entry; }
+	};
+
+	using texture_handle = asset_handle<texture_asset>;
+	using mesh_handle = asset_handle<mesh_asset>;
+	using program_handle = asset_handle<program_asset>;
+
+
+	// Loads each texture, mesh and shader program once, keyed by canonical
+	// path and load parameters, and shares it through reference counted
+	// handles. Textures and meshes are decoded by jobs (see cgra_jobs.hpp),
+	// so requests (from any thread) return immediately, and concurrent
+	// requests for the same asset share one load. Each is uploaded by a main
+	// thread job once it has decoded. update() frees the least recently used
+	// assets that have no handles left while the estimated GPU memory is over
+	// budget.
+	class asset_cache {
+	public:
+		struct stats {
+			size_t requests = 0;
+			size_t hits = 0;       // requests that shared an existing entry
+			size_t evictions = 0;
+		};
+
+	private:
+		shader_batch *m_shaders;
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, std::shared_ptr<detail::asset_entry>> m_entries;
+		std::vector<detail::asset_entry *> m_loading;
+		size_t m_budget;
+		size_t m_memory = 0;
+		uint64_t m_frame = 0;
+		bool m_closing = false;
+		stats m_stats;
+
+		detail::asset_entry * find(const std::string &key);
+		detail::asset_entry * insert(std::shared_ptr<detail::asset_entry> e);
+		void start_upload(detail::asset_entry *e);
+		void upload(detail::asset_entry &e);
+		void destroy(detail::asset_entry &e);
+		size_t evict_locked(size_t bytes);
+
+	public:
+		explicit asset_cache(shader_batch &shaders, size_t budget = size_t(256) << 20);
+
+		// must be destroyed on the main thread, GL objects are only deleted
+		// if a context is still current
+		~asset_cache();
+
+		asset_cache(const asset_cache &) = delete;
+		asset_cache & operator=(const asset_cache &) = delete;
+
+		// absolute path with "." and ".." removed, or filename if it doesn't exist
+		static std::string canonical_path(const std::string &filename);
+
+		// starts decoding a texture or mesh before any cache (or GL context)
+		// exists. The first load of the same file (and parameters) takes it over,
+		// until then preloading it again does nothing
+		static void preload_texture(const std::string &filename, const texture_params &params = {});
+		static void preload_mesh(const std::string &filename);
+
+		texture_handle load_texture(const std::string &filename, const texture_params &params = {});
+		mesh_handle load_mesh(const std::string &filename);
+
+		// compiled through the shader batch, main thread only
+		program_handle load_program(
+			const std::string &filename,
+			std::initializer_list<GLenum> types,
+			const std::vector<std::string> &defines = {}
+		);
+
+		// the program if it has compiled, otherwise the batch's fallback
+		GLuint resolve(const program_handle &h) const { return h.empty() ? m_shaders->fallback() : m_shaders->resolve(h.m_asset->program); }
+		bool ready(const program_handle &h) const { return !h.empty() && m_shaders->ready(h.m_asset->program); }
+
+		// evicts over budget, call once per frame on the main thread (finished
+		// loads are uploaded by job_system::run_main_jobs)
+		void update();
+
+		// blocks until every requested asset is loaded and uploaded
+		void finish();
+
+		// frees the least recently used unused assets until at least bytes
+		// have been freed (or none are left), returns the bytes freed
+		size_t evict(size_t bytes);
+
+		// frees every unused asset, returns how many
+		size_t release_unused();
+
+		size_t budget() const { return m_budget; }
+		void budget(size_t bytes) { m_budget = bytes; }
+
+		// estimated GPU memory used by loaded assets
+		size_t memory() const;
+		size_t size() const;
+		stats statistics() const;
+		shader_batch & shaders() { return *m_shaders; }
+	};
+}
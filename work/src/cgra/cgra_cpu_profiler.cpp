@@ -0,0 +1,172 @@
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// project
+#include "cgra_cpu_profiler.hpp"
+#include "cgra_gui.hpp"
+
+
+namespace cgra {
+
+	cpu_profiler & cpu_profiler::current() {
+		static cpu_profiler profiler;
+		return profiler;
+	}
+
+
+	cpu_profiler::thread_buffer & cpu_profiler::local() {
+		thread_local thread_buffer *buffer = nullptr;
+		if (!buffer) {
+			// buffers are owned by the profiler so they outlive their thread
+			std::lock_guard<std::mutex> lock(m_threads_mutex);
+			m_threads.push_back(std::make_unique<thread_buffer>());
+			buffer = m_threads.back().get();
+			buffer->thread = uint32_t(m_threads.size() - 1);
+		}
+		return *buffer;
+	}
+
+
+	void cpu_profiler::end_frame() {
+		uint64_t t = now();
+
+		{
+			std::lock_guard<std::mutex> lock(m_threads_mutex);
+			for (auto &b : m_threads) {
+				uint64_t w = b->written.load(std::memory_order_acquire);
+
+				// the writer lapped us, skip what was overwritten
+				if (w - b->read > ring_size) {
+					m_lost += size_t(w - b->read - ring_size);
+					b->read = w - ring_size;
+				}
+
+				size_t first = m_events.size();
+				for (uint64_t i = b->read; i < w; i++) {
+					m_events.push_back(b->events[i % ring_size]);
+				}
+
+				// anything overwritten while we were copying is dropped
+				uint64_t w2 = b->written.load(std::memory_order_acquire);
+				if (w2 - b->read > ring_size) {
+					size_t torn = std::min(size_t(w2 - b->read - ring_size), m_events.size() - first);
+					m_events.erase(m_events.begin() + first, m_events.begin() + first + torn);
+					m_lost += torn;
+				}
+
+				b->read = w;
+			}
+		}
+
+		m_frames.push_back({ m_frame_begin, t });
+		m_frame_begin = t;
+
+		// only keep the last max_frames frames
+		while (m_frames.size() > max_frames) m_frames.pop_front();
+		uint64_t oldest = m_frames.front().begin;
+		while (!m_events.empty() && m_events.front().end < oldest) m_events.pop_front();
+	}
+
+
+	bool cpu_profiler::export_chrome_trace(const std::string &filename, size_t n) const {
+		std::ofstream out(filename);
+		if (!out) {
+			std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+			return false;
+		}
+
+		n = std::min(n, m_frames.size());
+		uint64_t oldest = n ? m_frames[m_frames.size() - n].begin : 0;
+
+		// complete ("X") events with microsecond timestamps
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		char buf[256];
+		for (size_t i = m_frames.size() - n; i < m_frames.size(); i++) {
+			const frame_range &f = m_frames[i];
+			std::snprintf(buf, sizeof(buf),
+				"%s{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":\"frames\"}",
+				first ? "" : ",", f.begin * 1e-3, (f.end - f.begin) * 1e-3);
+			out << buf;
+			first = false;
+		}
+		for (auto &e : m_events) {
+			if (e.begin < oldest) continue;
+			// zone names are string literals, but escape quotes to be safe
+			std::string name = e.name;
+			for (size_t p = 0; (p = name.find_first_of("\"\\", p)) != std::string::npos; p += 2) name.insert(p, 1, '\\');
+			std::snprintf(buf, sizeof(buf),
+				"%s{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+				first ? "" : ",", name.c_str(), e.begin * 1e-3, (e.end - e.begin) * 1e-3, e.thread);
+			out << buf;
+			first = false;
+		}
+		out << "]}" << std::endl;
+
+		std::cout << "Wrote trace: " << filename << std::endl;
+		return bool(out);
+	}
+
+
+	void cpu_profiler::render_gui() {
+#ifndef CGRA_NO_CPU_PROFILER
+		if (!ImGui::CollapsingHeader("CPU Profiler")) return;
+
+		ImGui::Checkbox("Enabled##cpu", &m_enabled);
+		ImGui::SameLine();
+		ImGui::Text("(%zu zones lost)", m_lost);
+
+		ImGui::SliderInt("Frames", &m_export_frames, 1, int(max_frames));
+		if (ImGui::Button("Export Chrome trace")) {
+			std::ostringstream filename;
+			filename << "trace_" << (std::chrono::system_clock::now().time_since_epoch() / std::chrono::milliseconds(1)) << ".json";
+			export_chrome_trace(filename.str(), size_t(m_export_frames));
+		}
+
+		if (m_frames.empty()) return;
+		const frame_range &f = m_frames.back();
+		double frame_ms = (f.end - f.begin) * 1e-6;
+		ImGui::Text("Last frame %.3f ms", frame_ms);
+
+		// flame graph of the last complete frame, one band of rows per thread
+		const float row = ImGui::GetTextLineHeightWithSpacing();
+		const float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+		uint32_t max_depth = 0, max_thread = 0;
+		for (auto &e : m_events) {
+			if (e.end < f.begin || e.begin > f.end) continue;
+			max_depth = std::max(max_depth, e.depth);
+			max_thread = std::max(max_thread, e.thread);
+		}
+		const float band = row * (max_depth + 1);
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImGui::InvisibleButton("##flame", ImVec2(width, band * (max_thread + 1)));
+
+		ImDrawList *draw_list = ImGui::GetWindowDrawList();
+		const double scale = width / double(std::max<uint64_t>(f.end - f.begin, 1));
+		for (auto &e : m_events) {
+			if (e.end < f.begin || e.begin > f.end) continue;
+			float x0 = origin.x + float((std::max(e.begin, f.begin) - f.begin) * scale);
+			float x1 = origin.x + float((std::min(e.end, f.end) - f.begin) * scale);
+			float y0 = origin.y + e.thread * band + e.depth * row;
+			ImVec2 p0(x0, y0), p1(std::max(x1, x0 + 1), y0 + row - 1);
+
+			// colour from the name so zones are recognisable between frames
+			size_t h = std::hash<std::string>()(e.name);
+			ImU32 col = IM_COL32(80 + (h & 0x7F), 80 + ((h >> 8) & 0x7F), 80 + ((h >> 16) & 0x7F), 255);
+			draw_list->AddRectFilled(p0, p1, col);
+			if (x1 - x0 > ImGui::CalcTextSize(e.name).x + 4) {
+				draw_list->AddText(ImVec2(x0 + 2, y0), IM_COL32_BLACK, e.name);
+			}
+			if (ImGui::IsMouseHoveringRect(p0, p1)) {
+				ImGui::SetTooltip("%s: %.3f ms (thread %u)", e.name, (e.end - e.begin) * 1e-6, e.thread);
+			}
+		}
+#endif
+	}
+
+}
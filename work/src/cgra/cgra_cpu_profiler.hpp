@@ -0,0 +1,140 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Times a CPU zone (until the end of the enclosing block)
+// Define CGRA_NO_CPU_PROFILER to compile all zones out
+#ifndef CGRA_NO_CPU_PROFILER
+#define CGRA_ZONE_CAT_IMPL(a, b) a##b
+#define CGRA_ZONE_CAT(a, b) CGRA_ZONE_CAT_IMPL(a, b)
+#define CGRA_ZONE(name) ::cgra::cpu_zone CGRA_ZONE_CAT(cgra_zone_, __LINE__)(name)
+#else
+#define CGRA_ZONE(name)
+#endif
+
+
+namespace cgra {
+
+	// Low overhead CPU profiler. Zones are written to a per-thread ring
+	// buffer (single writer, no locks) when they end and are drained by the
+	// main thread at the end of every frame. The last max_frames frames are
+	// kept for the flame graph and Chrome trace export.
+	class cpu_profiler {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static constexpr size_t ring_size = 1 << 14;
+		static constexpr size_t max_frames = 120;
+
+		struct zone_event {
+			const char *name;
+			uint64_t begin; // nanoseconds since the profiler was created
+			uint64_t end;
+			uint32_t depth;
+			uint32_t thread;
+		};
+
+		// single producer (owning thread), single consumer (main thread) ring
+		struct thread_buffer {
+			uint32_t thread = 0;
+			uint32_t depth = 0;
+			std::array<zone_event, ring_size> events;
+			std::atomic<uint64_t> written { 0 };
+			uint64_t read = 0;
+		};
+
+		struct frame_range {
+			uint64_t begin;
+			uint64_t end;
+		};
+
+	private:
+		clock::time_point m_epoch = clock::now();
+		bool m_enabled = true;
+
+		// registration happens once per thread so a lock is fine here
+		std::mutex m_threads_mutex;
+		std::vector<std::unique_ptr<thread_buffer>> m_threads;
+
+		// drained history (main thread only)
+		std::deque<zone_event> m_events;
+		std::deque<frame_range> m_frames;
+		uint64_t m_frame_begin = 0;
+		size_t m_lost = 0;
+
+		// GUI state
+		int m_export_frames = 10;
+
+		cpu_profiler() { }
+
+	public:
+		cpu_profiler(const cpu_profiler &) = delete;
+		cpu_profiler & operator=(const cpu_profiler &) = delete;
+
+		static cpu_profiler & current();
+
+		bool enabled() const { return m_enabled; }
+		void enabled(bool e) { m_enabled = e; }
+
+		uint64_t now() const {
+			return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_epoch).count());
+		}
+
+		// ring buffer for the calling thread
+		thread_buffer & local();
+
+		// drains every thread's ring buffer and marks a frame boundary, call on the main thread
+		void end_frame();
+
+		const std::deque<frame_range> & frames() const { return m_frames; }
+		const std::deque<zone_event> & events() const { return m_events; }
+
+		// writes the last n frames as Chrome trace-event JSON (chrome://tracing, Perfetto)
+		// returns false if the file could not be written
+		bool export_chrome_trace(const std::string &filename, size_t n = max_frames) const;
+
+		// flame graph of the last frame and trace export inside the current ImGui window
+		void render_gui();
+	};
+
+
+	// RAII zone marker, use CGRA_ZONE
+	class cpu_zone {
+	private:
+		cpu_profiler::thread_buffer *m_buffer = nullptr;
+		const char *m_name;
+		uint64_t m_begin;
+
+	public:
+		explicit cpu_zone(const char *name) : m_name(name) {
+			cpu_profiler &p = cpu_profiler::current();
+			if (!p.enabled()) return;
+			m_buffer = &p.local();
+			m_buffer->depth++;
+			m_begin = p.now();
+		}
+
+		cpu_zone(const cpu_zone &) = delete;
+		cpu_zone & operator=(const cpu_zone &) = delete;
+
+		~cpu_zone() {
+			if (!m_buffer) return;
+			uint64_t end = cpu_profiler::current().now();
+			uint64_t w = m_buffer->written.load(std::memory_order_relaxed);
+			m_buffer->depth--;
+			m_buffer->events[w % cpu_profiler::ring_size] = { m_name, m_begin, end, m_buffer->depth, m_buffer->thread };
+			m_buffer->written.store(w + 1, std::memory_order_release);
+		}
+	};
+
+}
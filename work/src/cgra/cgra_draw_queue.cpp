@@ -0,0 +1,111 @@
+
+// std
+#include <cstring>
+
+// project
+#include "cgra_draw_queue.hpp"
+
+
+namespace {
+
+	// program, texture and polygon mode changes between consecutive packets
+	template <typename It, typename Get>
+	size_t count_state_changes(It begin, It end, Get get) {
+		size_t changes = 0;
+		const cgra::draw_packet *last = nullptr;
+		for (It it = begin; it != end; ++it) {
+			const cgra::draw_packet &p = get(*it);
+			if (!last || last->program != p.program) changes++;
+			if (!last || last->texture != p.texture) changes++;
+			if (!last || last->polygon_mode != p.polygon_mode) changes++;
+			if (!last || last->transparent != p.transparent) changes++;
+			last = &p;
+		}
+		return changes;
+	}
+
+}
+
+
+namespace cgra {
+
+	uint64_t draw_queue::make_key(unsigned pass, bool transparent, GLuint program, GLuint material, float depth) {
+		// the bits of a non-negative float sort the same as its value
+		// so we keep the top 24 bits (sign is always zero)
+		uint32_t depth_bits;
+		depth = (depth > 0) ? depth : 0.f;
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+		uint64_t d = depth_bits >> 7;
+		uint64_t p = program & 0xFFF;
+		uint64_t m = material & 0xFFFF;
+
+		// [63..60] pass | [59] transparent | 59 bits of ordering
+		uint64_t key = (uint64_t(pass & 0xF) << 60) | (uint64_t(transparent) << 59);
+		if (transparent) {
+			// back-to-front, then by state
+			key |= ((~d & 0xFFFFFF) << 35) | (p << 23) | (m << 7);
+		}
+		else {
+			// by state, then front-to-back
+			key |= (p << 47) | (m << 31) | (d << 7);
+		}
+		return key;
+	}
+
+
+	void draw_queue::radix_sort() {
+		// LSD radix sort on 8-bit digits, stable so equal keys keep submission order
+		m_scratch.resize(m_order.size());
+		for (int shift = 0; shift < 64; shift += 8) {
+			size_t count[257] = { };
+			for (auto &e : m_order) count[((e.first >> shift) & 0xFF) + 1]++;
+
+			// skip digits that are the same for every key
+			if (count[((m_order[0].first >> shift) & 0xFF) + 1] == m_order.size()) continue;
+
+			for (int i = 0; i < 256; i++) count[i + 1] += count[i];
+			for (auto &e : m_order) m_scratch[count[(e.first >> shift) & 0xFF]++] = e;
+			m_order.swap(m_scratch);
+		}
+	}
+
+
+	void draw_queue::flush() {
+		m_last_flush = stats();
+		m_last_flush.packets = m_packets.size();
+		if (m_packets.empty()) return;
+
+		m_last_flush.changes_unsorted = count_state_changes(
+			m_packets.begin(), m_packets.end(), [](const draw_packet &p) -> const draw_packet & { return p; }
+		);
+
+		m_order.clear();
+		for (uint32_t i = 0; i < m_packets.size(); i++) {
+			m_order.emplace_back(m_packets[i].key, i);
+		}
+		radix_sort();
+
+		m_last_flush.changes_sorted = count_state_changes(
+			m_order.begin(), m_order.end(), [this](const std::pair<uint64_t, uint32_t> &e) -> const draw_packet & { return m_packets[e.second]; }
+		);
+
+		// replay, the state cache drops anything that didn't change
+		gl_state &state = gl_state::current();
+		for (auto &e : m_order) {
+			draw_packet &p = m_packets[e.second];
+			state.use_program(p.program);
+			if (p.texture) state.bind_texture(0, GL_TEXTURE_2D, p.texture);
+			state.polygon_mode(p.polygon_mode);
+			state.blend(p.transparent);
+			state.depth_mask(!p.transparent);
+			if (p.transparent) state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			if (p.draw) p.draw(p.program);
+		}
+
+		// glClear skips the depth buffer while writes are off
+		state.depth_mask(true);
+
+		m_packets.clear();
+	}
+
+}
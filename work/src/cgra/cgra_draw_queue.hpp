@@ -0,0 +1,61 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// project
+#include <opengl.hpp>
+
+
+namespace cgra {
+
+	// A single draw submitted to a draw_queue. The queue sets the program,
+	// texture, polygon mode and blending, then calls draw which should set
+	// any per-draw uniforms and issue the actual draw call(s).
+	struct draw_packet {
+		uint64_t key = 0;
+		GLuint program = 0;
+		GLuint texture = 0; // bound to unit 0 as GL_TEXTURE_2D if not zero
+		GLenum polygon_mode = GL_FILL;
+		bool transparent = false; // enables alpha blending
+		std::function<void(GLuint program)> draw;
+	};
+
+
+	// Collects draw packets over a frame and replays them sorted by their
+	// 64-bit key. Keys made with make_key sort by pass, then opaque before
+	// transparent, then opaque packets by program, material and front-to-back
+	// depth (for early-z) and transparent packets back-to-front.
+	class draw_queue {
+	public:
+		struct stats {
+			size_t packets = 0;
+			size_t changes_unsorted = 0; // state changes if replayed in submission order
+			size_t changes_sorted = 0; // state changes actually replayed
+		};
+
+	private:
+		std::vector<draw_packet> m_packets;
+		std::vector<std::pair<uint64_t, uint32_t>> m_order;
+		std::vector<std::pair<uint64_t, uint32_t>> m_scratch;
+		stats m_last_flush;
+
+		void radix_sort();
+
+	public:
+		// builds a sort key, depth is the (non-negative) view space distance
+		// program and material are truncated to 12 and 16 bits
+		static uint64_t make_key(unsigned pass, bool transparent, GLuint program, GLuint material, float depth);
+
+		void submit(draw_packet packet) { m_packets.push_back(std::move(packet)); }
+
+		// sorts and replays every submitted packet, then clears the queue
+		void flush();
+
+		size_t size() const { return m_packets.size(); }
+		const stats & last_flush() const { return m_last_flush; }
+	};
+
+}
@@ -0,0 +1,168 @@
+
+// std
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+// project
+#include "cgra_entity.hpp"
+
+
+namespace {
+
+	struct component_info {
+		size_t size;
+		size_t align;
+	};
+
+	std::mutex components_mutex;
+	std::vector<component_info> components;
+
+	component_info info_of(uint32_t id) {
+		std::lock_guard<std::mutex> lock(components_mutex);
+		return components[id];
+	}
+
+	size_t align_up(size_t x, size_t align) {
+		return (x + align - 1) / align * align;
+	}
+}
+
+
+namespace cgra {
+
+	namespace detail {
+
+		uint32_t register_component(size_t size, size_t align) {
+			std::lock_guard<std::mutex> lock(components_mutex);
+			if (components.size() >= entity_registry::max_components) {
+				throw std::length_error("too many entity component types");
+			}
+			components.push_back({ size, align });
+			return uint32_t(components.size() - 1);
+		}
+	}
+
+
+	void entity_registry::clear() {
+		*this = entity_registry();
+	}
+
+
+	uint32_t entity_registry::archetype_for(uint64_t mask) {
+		auto it = m_archetype_index.find(mask);
+		if (it != m_archetype_index.end()) return it->second;
+
+		auto a = std::make_unique<archetype>();
+		a->mask = mask;
+		a->offset.fill(0);
+		a->stride.fill(0);
+		size_t row_size = sizeof(entity);
+		std::vector<component_info> infos;
+		for (uint32_t id = 0; id < max_components; id++) {
+			if (!((mask >> id) & 1)) continue;
+			const component_info info = info_of(id);
+			assert(info.align <= alignof(chunk));
+			a->components.push_back(id);
+			a->stride[id] = uint32_t(info.size);
+			infos.push_back(info);
+			row_size += info.size;
+		}
+		if (row_size > entity_chunk_bytes) throw std::length_error("entity components do not fit in a chunk");
+
+		// arrays one after another, each aligned for its type,
+		// with as many entities as still fit after padding
+		for (a->capacity = entity_chunk_bytes / row_size; ; a->capacity--) {
+			if (a->capacity == 0) throw std::length_error("entity components do not fit in a chunk once aligned");
+			size_t offset = a->capacity * sizeof(entity);
+			for (size_t i = 0; i < infos.size(); i++) {
+				offset = align_up(offset, infos[i].align);
+				a->offset[a->components[i]] = uint32_t(offset);
+				offset += a->capacity * infos[i].size;
+			}
+			if (offset <= entity_chunk_bytes) break;
+		}
+
+		m_archetypes.push_back(std::move(a));
+		const uint32_t index = uint32_t(m_archetypes.size() - 1);
+		m_archetype_index[mask] = index;
+		return index;
+	}
+
+
+	size_t entity_registry::push_row(archetype &a, entity e) {
+		const size_t row = a.size++;
+		if (row == a.chunks.size() * a.capacity) a.chunks.push_back(std::make_unique<chunk>());
+		a.entities(row / a.capacity)[row % a.capacity] = e;
+		return row;
+	}
+
+
+	void entity_registry::remove_row(archetype &a, size_t row) {
+		// fill the gap with the last entity so chunks stay packed
+		const size_t last = a.size - 1;
+		if (row != last) {
+			for (uint32_t id : a.components) {
+				std::memcpy(a.get(id, row), a.get(id, last), a.stride[id]);
+			}
+			const entity moved = a.entities(last / a.capacity)[last % a.capacity];
+			a.entities(row / a.capacity)[row % a.capacity] = moved;
+			m_records[moved.index].row = uint32_t(row);
+		}
+		a.size--;
+		if (a.size == (a.chunks.size() - 1) * a.capacity) a.chunks.pop_back();
+	}
+
+
+	entity entity_registry::allocate(uint64_t mask) {
+		entity e;
+		if (m_free.empty()) {
+			e.index = uint32_t(m_records.size());
+			m_records.emplace_back();
+		} else {
+			e.index = m_free.back();
+			m_free.pop_back();
+		}
+		record &r = m_records[e.index];
+		e.generation = r.generation;
+		r.archetype = archetype_for(mask);
+		r.row = uint32_t(push_row(*m_archetypes[r.archetype], e));
+		m_size++;
+		return e;
+	}
+
+
+	void entity_registry::destroy(entity e) {
+		assert(alive(e));
+		record &r = m_records[e.index];
+		remove_row(*m_archetypes[r.archetype], r.row);
+		r.archetype = npos;
+		r.generation++;
+		m_free.push_back(e.index);
+		m_size--;
+	}
+
+
+	void entity_registry::move(entity e, uint64_t mask) {
+		const uint32_t to_index = archetype_for(mask);
+		record &r = m_records[e.index];
+		archetype &from = *m_archetypes[r.archetype];
+		archetype &to = *m_archetypes[to_index];
+		const size_t row = push_row(to, e);
+		for (uint32_t id : to.components) {
+			if ((from.mask >> id) & 1) std::memcpy(to.get(id, row), from.get(id, r.row), to.stride[id]);
+		}
+		remove_row(from, r.row);
+		r.archetype = to_index;
+		r.row = uint32_t(row);
+	}
+
+
+	void entity_registry::chunks_with(uint64_t mask, std::vector<chunk_ref> &chunks) const {
+		for (auto &a : m_archetypes) {
+			if ((a->mask & mask) != mask) continue;
+			for (size_t c = 0; c < a->chunks.size(); c++) chunks.push_back({ a.get(), c });
+		}
+	}
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// project
+#include "cgra_flat_hash.hpp"
+#include "cgra_jobs.hpp"
+
+
+namespace cgra {
+
+	// Handle to an entity in an entity_registry. The generation changes
+	// when an index is reused, so stale handles are detected.
+	struct entity {
+		uint32_t index = uint32_t(-1);
+		uint32_t generation = 0;
+
+		friend bool operator==(const entity &a, const entity &b) { return a.index == b.index && a.generation == b.generation; }
+		friend bool operator!=(const entity &a, const entity &b) { return !(a == b); }
+	};
+
+
+	// bytes per chunk of entities
+	constexpr size_t entity_chunk_bytes = 16 * 1024;
+
+
+	namespace detail {
+
+		// components are numbered in the order they are first used
+		uint32_t register_component(size_t size, size_t align);
+
+		template <typename T>
+		uint32_t component_id() {
+			static const uint32_t id = register_component(sizeof(T), alignof(T));
+			return id;
+		}
+	}
+
+
+	// Entity-component store. Entities with the same set of component types
+	// (an archetype) are kept together in 16 KB chunks, each holding a
+	// structure-of-arrays: one array per component type. Systems iterate
+	// over chunks with each_chunk, which walks each array linearly and
+	// processes the chunks in parallel.
+	//
+	// Components are plain data: they must be trivially destructible and
+	// are moved around with memcpy, so they can't point into themselves
+	// (cgra_math types are fine). Up to 64 component types can be used. Creating,
+	// destroying, adding or removing components moves other entities, which
+	// invalidates component pointers (but not entity handles).
+	//
+	//     entity_registry reg;
+	//     entity e = reg.create(position{...}, velocity{...});
+	//     reg.each_chunk<position, const velocity>([](size_t, size_t n, position *p, const velocity *v) {
+	//         for (size_t i = 0; i < n; i++) p[i].value += v[i].value;
+	//     });
+	class entity_registry {
+	public:
+		static constexpr size_t max_components = 64;
+
+		// parallel iteration is used for at least this many chunks
+		static constexpr size_t parallel_chunks = 16;
+
+	private:
+		static constexpr uint32_t npos = uint32_t(-1);
+
+		struct chunk {
+			alignas(64) unsigned char data[entity_chunk_bytes];
+		};
+
+		struct archetype {
+			uint64_t mask = 0;
+			size_t capacity = 0; // entities per chunk
+			size_t size = 0;
+			std::vector<uint32_t> components; // ids
+			std::array<uint32_t, max_components> offset; // byte offset in a chunk by component id
+			std::array<uint32_t, max_components> stride; // component size by id
+			std::vector<std::unique_ptr<chunk>> chunks;
+
+			unsigned char * get(uint32_t id, size_t row) const {
+				return chunks[row / capacity]->data + offset[id] + (row % capacity) * stride[id];
+			}
+
+			entity * entities(size_t c) const { return reinterpret_cast<entity *>(chunks[c]->data); }
+			size_t chunk_size(size_t c) const { return std::min(capacity, size - c * capacity); }
+		};
+
+		struct record {
+			uint32_t archetype = npos;
+			uint32_t row = 0;
+			uint32_t generation = 0;
+		};
+
+		struct chunk_ref {
+			const archetype *a;
+			size_t c;
+		};
+
+		std::vector<std::unique_ptr<archetype>> m_archetypes;
+		flat_hash_map<uint64_t, uint32_t> m_archetype_index;
+		std::vector<record> m_records;
+		std::vector<uint32_t> m_free;
+		size_t m_size = 0;
+
+		template <typename ...Cs>
+		static uint64_t mask_of() {
+			uint64_t mask = 0;
+			(void) std::initializer_list<int>{ (mask |= uint64_t(1) << detail::component_id<std::remove_cv_t<Cs>>(), 0)... };
+			return mask;
+		}
+
+		const record & record_of(entity e) const {
+			assert(alive(e));
+			return m_records[e.index];
+		}
+
+		uint32_t archetype_for(uint64_t mask);
+		entity allocate(uint64_t mask);
+		size_t push_row(archetype &a, entity e);
+		void remove_row(archetype &a, size_t row);
+		void move(entity e, uint64_t mask);
+		void chunks_with(uint64_t mask, std::vector<chunk_ref> &chunks) const;
+
+		template <typename C>
+		static C * column(const chunk_ref &r) {
+			const uint32_t id = detail::component_id<std::remove_cv_t<C>>();
+			return reinterpret_cast<C *>(r.a->chunks[r.c]->data + r.a->offset[id]);
+		}
+
+		template <typename C>
+		C * get_unchecked(const record &r) const {
+			return reinterpret_cast<C *>(m_archetypes[r.archetype]->get(detail::component_id<std::remove_cv_t<C>>(), r.row));
+		}
+
+	public:
+		entity_registry() { }
+
+		entity_registry(const entity_registry &) = delete;
+		entity_registry & operator=(const entity_registry &) = delete;
+		entity_registry(entity_registry &&) = default;
+		entity_registry & operator=(entity_registry &&) = default;
+
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		void clear();
+
+		bool alive(entity e) const {
+			return e.index < m_records.size() && m_records[e.index].generation == e.generation && m_records[e.index].archetype != npos;
+		}
+
+		template <typename ...Cs>
+		entity create(const Cs &...cs) {
+			static_assert(std::conjunction<std::is_trivially_destructible<Cs>...>::value, "components must be trivially destructible");
+			const entity e = allocate(mask_of<Cs...>());
+			const record &r = m_records[e.index];
+			(void) std::initializer_list<int>{ (new (get_unchecked<Cs>(r)) Cs(cs), 0)... };
+			return e;
+		}
+
+		// destroys e and its components
+		void destroy(entity e);
+
+		template <typename C>
+		bool has(entity e) const {
+			return (m_archetypes[record_of(e).archetype]->mask >> detail::component_id<std::remove_cv_t<C>>()) & 1;
+		}
+
+		// nullptr if e does not have a C
+		template <typename C>
+		C * get(entity e) {
+			return has<C>(e) ? get_unchecked<C>(record_of(e)) : nullptr;
+		}
+
+		template <typename C>
+		const C * get(entity e) const {
+			return has<C>(e) ? get_unchecked<C>(record_of(e)) : nullptr;
+		}
+
+		// adds (or replaces) a component, moving e to another archetype
+		template <typename C>
+		void add(entity e, const C &c) {
+			static_assert(std::is_trivially_destructible<C>::value, "components must be trivially destructible");
+			if (!has<C>(e)) move(e, m_archetypes[record_of(e).archetype]->mask | mask_of<C>());
+			new (get_unchecked<C>(record_of(e))) C(c);
+		}
+
+		template <typename C>
+		void remove(entity e) {
+			if (has<C>(e)) move(e, m_archetypes[record_of(e).archetype]->mask & ~mask_of<C>());
+		}
+
+		// number of chunks each_chunk would visit
+		template <typename ...Cs>
+		size_t chunk_count() const {
+			std::vector<chunk_ref> chunks;
+			chunks_with(mask_of<Cs...>(), chunks);
+			return chunks.size();
+		}
+
+		// calls f(chunk, n, Cs *...) for every chunk of entities that have all
+		// of Cs, where chunk counts from 0 to chunk_count<Cs...>() and each
+		// pointer is to an array of n components. Chunks are processed in
+		// parallel, so f must be thread safe, and it must not create or destroy
+		// entities or add or remove components.
+		template <typename ...Cs, typename F>
+		void each_chunk(F f) {
+			std::vector<chunk_ref> chunks;
+			chunks_with(mask_of<Cs...>(), chunks);
+			auto range = [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					const chunk_ref &r = chunks[i];
+					f(i, r.a->chunk_size(r.c), column<Cs>(r)...);
+				}
+			};
+			if (chunks.size() >= parallel_chunks) parallel_for(0, chunks.size(), 4, range);
+			else range(0, chunks.size());
+		}
+
+		// calls f(e, Cs &...) for every entity that has all of Cs, see each_chunk
+		template <typename ...Cs, typename F>
+		void each(F f) {
+			std::vector<chunk_ref> chunks;
+			chunks_with(mask_of<Cs...>(), chunks);
+			auto range = [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					const chunk_ref &r = chunks[i];
+					const entity *es = r.a->entities(r.c);
+					auto columns = std::make_tuple(column<Cs>(r)...);
+					const size_t count = r.a->chunk_size(r.c);
+					for (size_t j = 0; j < count; j++) {
+						std::apply([&](auto *...cs) { f(es[j], cs[j]...); }, columns);
+					}
+				}
+			};
+			if (chunks.size() >= parallel_chunks) parallel_for(0, chunks.size(), 4, range);
+			else range(0, chunks.size());
+		}
+	};
+}
@@ -0,0 +1,125 @@
+
+// std
+#include <algorithm>
+
+// project
+#include "cgra_fast_math.hpp"
+#include "cgra_jobs.hpp"
+
+
+namespace cgra {
+
+	namespace fast {
+
+		namespace {
+
+			using namespace detail;
+
+			// elements per chunk, also the grain for splitting across threads
+			constexpr size_t chunk_size = 4096;
+
+#ifdef CGRA_SIMD_SSE2
+			inline float4 load(float4, const float *p) { return { _mm_loadu_ps(p) }; }
+			inline void store(float *p, float4 a) { _mm_storeu_ps(p, a.v); }
+#endif
+
+			inline float load(float, const float *p) { return *p; }
+			inline void store(float *p, float a) { *p = a; }
+
+			// calls f(lane, i) for every i in [0, n), 4 at a time where possible
+			// and in parallel for large n
+			template <typename F>
+			void parallel_simd(size_t n, F f) {
+				const size_t chunks = (n + chunk_size - 1) / chunk_size;
+				auto range = [&](size_t begin, size_t end) {
+					for (size_t c = begin; c < end; c++) {
+						size_t i = c * chunk_size;
+						const size_t last = std::min(n, i + chunk_size);
+#ifdef CGRA_SIMD_SSE2
+						for (; i + 4 <= last; i += 4) f(float4{}, i);
+#endif
+						for (; i < last; i++) f(0.f, i);
+					}
+				};
+				if (n >= soa_parallel_threshold) parallel_for(0, chunks, 1, range);
+				else range(0, chunks);
+			}
+
+			template <typename F>
+			void unary(F f, const float *x, float *r, size_t n) {
+				parallel_simd(n, [&](auto t, size_t i) { store(r + i, f(load(t, x + i))); });
+			}
+
+			template <typename F>
+			void binary(F f, const float *x, const float *y, float *r, size_t n) {
+				parallel_simd(n, [&](auto t, size_t i) { store(r + i, f(load(t, x + i), load(t, y + i))); });
+			}
+
+			template <typename F>
+			void unary(F f, const vec3_soa &in, vec3_soa &out) {
+				out.resize(in.size());
+				unary(f, in.x(), out.x(), in.size());
+				unary(f, in.y(), out.y(), in.size());
+				unary(f, in.z(), out.z(), in.size());
+			}
+
+			template <typename F>
+			void unary(F f, const vec4_soa &in, vec4_soa &out) {
+				out.resize(in.size());
+				unary(f, in.x(), out.x(), in.size());
+				unary(f, in.y(), out.y(), in.size());
+				unary(f, in.z(), out.z(), in.size());
+				unary(f, in.w(), out.w(), in.size());
+			}
+		}
+
+
+		void rsqrt(const float *x, float *r, size_t n) { unary(rsqrt_f(), x, r, n); }
+		void sqrt(const float *x, float *r, size_t n) { unary(sqrt_f(), x, r, n); }
+		void sin(const float *x, float *r, size_t n) { unary(sin_f(), x, r, n); }
+		void cos(const float *x, float *r, size_t n) { unary(cos_f(), x, r, n); }
+		void atan2(const float *y, const float *x, float *r, size_t n) { binary(atan2_f(), y, x, r, n); }
+		void exp(const float *x, float *r, size_t n) { unary(exp_f(), x, r, n); }
+		void log(const float *x, float *r, size_t n) { unary(log_f(), x, r, n); }
+		void pow(const float *x, const float *y, float *r, size_t n) { binary(pow_f(), x, y, r, n); }
+
+		void rsqrt(const vec3_soa &in, vec3_soa &out) { unary(rsqrt_f(), in, out); }
+		void sqrt(const vec3_soa &in, vec3_soa &out) { unary(sqrt_f(), in, out); }
+		void sin(const vec3_soa &in, vec3_soa &out) { unary(sin_f(), in, out); }
+		void cos(const vec3_soa &in, vec3_soa &out) { unary(cos_f(), in, out); }
+		void exp(const vec3_soa &in, vec3_soa &out) { unary(exp_f(), in, out); }
+		void log(const vec3_soa &in, vec3_soa &out) { unary(log_f(), in, out); }
+
+		void rsqrt(const vec4_soa &in, vec4_soa &out) { unary(rsqrt_f(), in, out); }
+		void sqrt(const vec4_soa &in, vec4_soa &out) { unary(sqrt_f(), in, out); }
+		void sin(const vec4_soa &in, vec4_soa &out) { unary(sin_f(), in, out); }
+		void cos(const vec4_soa &in, vec4_soa &out) { unary(cos_f(), in, out); }
+		void exp(const vec4_soa &in, vec4_soa &out) { unary(exp_f(), in, out); }
+		void log(const vec4_soa &in, vec4_soa &out) { unary(log_f(), in, out); }
+
+
+		void length(const vec3_soa &in, std::vector<float> &out) {
+			out.resize(in.size());
+			const float *ix = in.x(), *iy = in.y(), *iz = in.z();
+			float *o = out.data();
+			parallel_simd(in.size(), [&](auto t, size_t i) {
+				const auto x = load(t, ix + i), y = load(t, iy + i), z = load(t, iz + i);
+				store(o + i, sqrt_kernel(x * x + y * y + z * z));
+			});
+		}
+
+
+		void normalize(const vec3_soa &in, vec3_soa &out) {
+			out.resize(in.size());
+			const float *ix = in.x(), *iy = in.y(), *iz = in.z();
+			float *ox = out.x(), *oy = out.y(), *oz = out.z();
+			parallel_simd(in.size(), [&](auto t, size_t i) {
+				const auto x = load(t, ix + i), y = load(t, iy + i), z = load(t, iz + i);
+				const auto s = lane_rsqrt_unchecked(x * x + y * y + z * z);
+				store(ox + i, x * s);
+				store(oy + i, y * s);
+				store(oz + i, z * s);
+			});
+		}
+	}
+}
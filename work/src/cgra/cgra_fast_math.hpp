@@ -0,0 +1,357 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// project
+#include "cgra_math.hpp"
+#include "cgra_soa.hpp"
+
+
+namespace cgra {
+
+	// Fast approximations of rsqrt, sqrt, sin, cos, atan2, exp, log and pow for
+	// float, float vectors, arrays and SoA containers. These are opt-in: call
+	// fast::sin(x) etc. where the exact std versions are too slow (particles,
+	// procedural noise and animation). With SSE2 every overload computes 4 values
+	// at a time using the same arithmetic, so scalars, vectors and arrays give
+	// identical results. Maximum errors (checked by math_bench --accuracy):
+	//
+	//    rsqrt, sqrt     relative 4e-7, denormals count as 0 (rsqrt(0) = inf)
+	//    sin, cos        absolute 1.5e-7 for |x| <= 8192 (grows past that)
+	//    atan2           absolute 3e-7, for finite x and y
+	//    exp             relative 1.5e-7 for results above FLT_MIN (x > -87.3),
+	//                    0 below -103.97 and inf above 88.72
+	//    log             absolute 1e-7 for x in [0.5, 2], relative 1.5e-7 elsewhere,
+	//                    -inf for 0 and nan for x < 0
+	//    pow             exp(y * log(x)) for x > 0, the relative error is within
+	//                    2e-7 * (1 + |y * log(x)|)
+	//    normalize       absolute 4e-7 per component
+	//
+	// The rsqrt estimate instruction may differ between CPU vendors, so rsqrt,
+	// sqrt, length and normalize are only repeatable on the same hardware.
+	namespace fast {
+
+		namespace detail {
+
+			// the kernels are written once against these lane helpers and run
+			// with float4 (4 values at a time) or, without SSE2, float
+#ifdef CGRA_SIMD_SSE2
+			struct float4 { __m128 v; };
+			struct uint4 { __m128i v; };
+
+			inline float4 operator+(float4 a, float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+			inline float4 operator-(float4 a, float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+			inline float4 operator*(float4 a, float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+			inline float4 operator/(float4 a, float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+			inline float4 operator|(float4 a, float4 b) { return { _mm_or_ps(a.v, b.v) }; }
+			inline float4 splat(float4, float x) { return { _mm_set1_ps(x) }; }
+			inline float4 lane_min(float4 a, float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+			inline float4 lane_max(float4 a, float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+			inline float4 lane_round(float4 a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+
+			// comparisons give masks with every bit set where true
+			inline float4 lane_lt(float4 a, float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+			inline float4 lane_eq(float4 a, float4 b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+			inline float4 lane_nan(float4 a) { return { _mm_cmpunord_ps(a.v, a.v) }; }
+			inline float4 select(float4 m, float4 a, float4 b) { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+
+			inline uint4 operator+(uint4 a, uint4 b) { return { _mm_add_epi32(a.v, b.v) }; }
+			inline uint4 operator-(uint4 a, uint4 b) { return { _mm_sub_epi32(a.v, b.v) }; }
+			inline uint4 operator&(uint4 a, uint4 b) { return { _mm_and_si128(a.v, b.v) }; }
+			inline uint4 operator|(uint4 a, uint4 b) { return { _mm_or_si128(a.v, b.v) }; }
+			inline uint4 operator^(uint4 a, uint4 b) { return { _mm_xor_si128(a.v, b.v) }; }
+			inline uint4 operator<<(uint4 a, int s) { return { _mm_slli_epi32(a.v, s) }; }
+			inline uint4 operator>>(uint4 a, int s) { return { _mm_srli_epi32(a.v, s) }; }
+			inline uint4 splat(uint4, uint32_t x) { return { _mm_set1_epi32(int(x)) }; }
+			inline uint4 to_bits(float4 a) { return { _mm_castps_si128(a.v) }; }
+			inline float4 from_bits(uint4 a) { return { _mm_castsi128_ps(a.v) }; }
+
+			// integral float to two's complement, and back
+			inline uint4 lane_to_int(float4 a) { return { _mm_cvttps_epi32(a.v) }; }
+			inline float4 lane_to_float(uint4 a) { return { _mm_cvtepi32_ps(a.v) }; }
+
+			// mask of the lanes where (a & bit) != 0
+			inline float4 lane_test(uint4 a, uint32_t bit) {
+				const __m128i b = _mm_set1_epi32(int(bit));
+				return { _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a.v, b), b)) };
+			}
+
+			// 1 / sqrt(x) from the 12-bit estimate with one Newton step
+			// nan for 0, denormals and inf (used where those don't matter)
+			inline float4 lane_rsqrt_unchecked(float4 x) {
+				const float4 y = { _mm_rsqrt_ps(x.v) };
+				return y * (splat(x, 1.5f) - splat(x, 0.5f) * x * y * y);
+			}
+
+			inline float4 lane_rsqrt(float4 x) {
+				const float4 y = { _mm_rsqrt_ps(x.v) };
+				// the estimate is already exact for 0 (and denormals) and inf
+				const float4 ax = { _mm_andnot_ps(_mm_set1_ps(-0.f), x.v) };
+				return select(lane_lt(ax, splat(x, std::numeric_limits<float>::min())) | lane_eq(y, splat(x, 0.f)), y, lane_rsqrt_unchecked(x));
+			}
+#endif
+
+			inline float splat(float, float x) { return x; }
+			inline float lane_min(float a, float b) { return b < a ? b : a; }
+			inline float lane_max(float a, float b) { return a < b ? b : a; }
+			inline float lane_round(float a) { return std::nearbyint(a); }
+
+			inline bool lane_lt(float a, float b) { return a < b; }
+			inline bool lane_eq(float a, float b) { return a == b; }
+			inline bool lane_nan(float a) { return a != a; }
+			inline float select(bool m, float a, float b) { return m ? a : b; }
+
+			inline uint32_t splat(uint32_t, uint32_t x) { return x; }
+
+			inline uint32_t to_bits(float a) {
+				uint32_t b;
+				std::memcpy(&b, &a, sizeof(b));
+				return b;
+			}
+
+			inline float from_bits(uint32_t b) {
+				float a;
+				std::memcpy(&a, &b, sizeof(a));
+				return a;
+			}
+
+			// out of range gives 0x80000000, like cvttps2dq
+			inline uint32_t lane_to_int(float a) { return std::abs(a) < 2147483648.f ? uint32_t(int32_t(a)) : 0x80000000u; }
+			inline float lane_to_float(uint32_t a) { return float(int32_t(a)); }
+			inline bool lane_test(uint32_t a, uint32_t bit) { return (a & bit) != 0; }
+
+			// 1 / sqrt(x) from the bit-level estimate (3.5% error) with three Newton steps
+			inline float lane_rsqrt(float x) {
+				if (std::abs(x) < std::numeric_limits<float>::min()) return std::copysign(std::numeric_limits<float>::infinity(), x);
+				if (!(x > 0) || x == std::numeric_limits<float>::infinity()) return 1 / std::sqrt(x);
+				float y = from_bits(0x5f375a86u - (to_bits(x) >> 1));
+				for (int i = 0; i < 3; i++) y = y * (1.5f - 0.5f * x * y * y);
+				return y;
+			}
+
+			inline float lane_rsqrt_unchecked(float x) { return lane_rsqrt(x); }
+
+			template <typename V>
+			inline V sqrt_kernel(V x) {
+				using U = decltype(to_bits(x));
+				const V ax = from_bits(to_bits(x) & splat(U(), 0x7fffffffu));
+				const V r = select(lane_eq(x, splat(x, std::numeric_limits<float>::infinity())), x, x * lane_rsqrt(x));
+				return select(lane_lt(ax, splat(x, std::numeric_limits<float>::min())), x * splat(x, 0.f), r);
+			}
+
+			// sin(x + quadrant * pi / 2), the cephes sinf/cosf polynomials on
+			// [-pi/4, pi/4] after a 3 part Cody-Waite reduction by pi / 2
+			template <typename V>
+			inline V sin_kernel(V x, uint32_t quadrant) {
+				using U = decltype(to_bits(x));
+				const V j = lane_round(x * splat(x, 0.636619772f));
+				const V r = ((x - j * splat(x, 1.5703125f)) - j * splat(x, 4.837512969970703125e-4f)) - j * splat(x, 7.54978995489188216e-8f);
+				const U q = lane_to_int(j) + splat(U(), quadrant);
+				const V z = r * r;
+				const V s = r + r * z * (splat(x, -1.6666654611e-1f) + z * (splat(x, 8.3321608736e-3f) + z * splat(x, -1.9515295891e-4f)));
+				const V c = splat(x, 1.f) - splat(x, 0.5f) * z + z * z * (splat(x, 4.166664568298827e-2f) + z * (splat(x, -1.388731625493765e-3f) + z * splat(x, 2.443315711809948e-5f)));
+				// odd quadrants use cos, the second half of the period is negated
+				const V res = select(lane_test(q, 1), c, s);
+				return from_bits(to_bits(res) ^ ((q & splat(U(), 2)) << 30));
+			}
+
+			// atan of the smaller over the larger magnitude, reduced to |t| <= tan(pi/8)
+			// then placed in the right octant with the signs of x and y (so the zero
+			// and -0 cases match std::atan2)
+			template <typename V>
+			inline V atan2_kernel(V y, V x) {
+				using U = decltype(to_bits(x));
+				const U sign = splat(U(), 0x80000000u), magnitude = splat(U(), 0x7fffffffu);
+				const V ax = from_bits(to_bits(x) & magnitude), ay = from_bits(to_bits(y) & magnitude);
+				const V num = lane_min(ax, ay), den = lane_max(ax, ay);
+				const V a = select(lane_eq(den, splat(x, 0.f)), splat(x, 0.f), num / den);
+				const auto big = lane_lt(splat(x, 0.414213562f), a);
+				const V t = select(big, (a - splat(x, 1.f)) / (a + splat(x, 1.f)), a);
+				const V z = t * t;
+				V r = (((splat(x, 8.05374449538e-2f) * z - splat(x, 1.38776856032e-1f)) * z + splat(x, 1.99777106478e-1f)) * z - splat(x, 3.33329491539e-1f)) * z * t + t;
+				r = select(big, r + splat(x, 0.785398163f), r);
+				r = select(lane_lt(ax, ay), splat(x, 1.57079633f) - r, r);
+				r = select(lane_test(to_bits(x), 0x80000000u), splat(x, 3.14159265f) - r, r);
+				return from_bits(to_bits(r) | (to_bits(y) & sign));
+			}
+
+			// 2^k for integral k in [-126, 127]
+			template <typename V>
+			inline V pow2(V k) {
+				using U = decltype(to_bits(k));
+				return from_bits((lane_to_int(k) + splat(U(), 127)) << 23);
+			}
+
+			// cephes expf, 2^n is applied in two halves so that
+			// results below FLT_MIN (down to the smallest denormal) are correct
+			template <typename V>
+			inline V exp_kernel(V x) {
+				const V hi = splat(x, 88.7228394f), lo = splat(x, -103.972084f);
+				const V c = lane_min(lane_max(x, lo), hi);
+				const V n = lane_round(c * splat(x, 1.44269504088896341f));
+				const V r = (c - n * splat(x, 0.693359375f)) - n * splat(x, -2.12194440e-4f);
+				const V z = r * r;
+				V p = ((((splat(x, 1.9875691500e-4f) * r + splat(x, 1.3981999507e-3f)) * r + splat(x, 8.3334519073e-3f)) * r + splat(x, 4.1665795894e-2f)) * r + splat(x, 1.6666665459e-1f)) * r + splat(x, 5.0000001201e-1f);
+				p = p * z + r + splat(x, 1.f);
+				const V h = lane_round(n * splat(x, 0.5f));
+				p = p * pow2(h) * pow2(n - h);
+				p = select(lane_lt(hi, x), splat(x, std::numeric_limits<float>::infinity()), p);
+				p = select(lane_lt(x, lo), splat(x, 0.f), p);
+				return select(lane_nan(x), x, p);
+			}
+
+			// cephes logf, with denormals scaled up first
+			template <typename V>
+			inline V log_kernel(V x) {
+				using U = decltype(to_bits(x));
+				const V inf = splat(x, std::numeric_limits<float>::infinity());
+				const auto denormal = lane_lt(x, splat(x, std::numeric_limits<float>::min()));
+				const U b = to_bits(select(denormal, x * splat(x, 8388608.f), x));
+				V e = lane_to_float((b >> 23) - splat(U(), 126)) - select(denormal, splat(x, 23.f), splat(x, 0.f));
+				V m = from_bits((b & splat(U(), 0x007fffffu)) | splat(U(), 0x3f000000u));
+				// m in [sqrt(0.5), sqrt(2)) - 1
+				const auto small = lane_lt(m, splat(x, 0.707106781186547524f));
+				e = e - select(small, splat(x, 1.f), splat(x, 0.f));
+				m = select(small, m + m, m) - splat(x, 1.f);
+				const V z = m * m;
+				V y = (((((((splat(x, 7.0376836292e-2f) * m - splat(x, 1.1514610310e-1f)) * m + splat(x, 1.1676998740e-1f)) * m - splat(x, 1.2420140846e-1f)) * m
+					+ splat(x, 1.4249322787e-1f)) * m - splat(x, 1.6668057665e-1f)) * m + splat(x, 2.0000714765e-1f)) * m - splat(x, 2.4999993993e-1f)) * m + splat(x, 3.3333331174e-1f);
+				y = y * m * z + e * splat(x, -2.12194440e-4f) - splat(x, 0.5f) * z;
+				V r = m + y + e * splat(x, 0.693359375f);
+				r = select(lane_eq(x, inf), inf, r);
+				r = select(lane_lt(x, splat(x, 0.f)), splat(x, std::numeric_limits<float>::quiet_NaN()), r);
+				r = select(lane_eq(x, splat(x, 0.f)), splat(x, -std::numeric_limits<float>::infinity()), r);
+				return select(lane_nan(x), x, r);
+			}
+
+			// runs a kernel on a scalar or on each group of 4 components of a vector
+#ifdef CGRA_SIMD_SSE2
+			template <typename F, typename ...Args>
+			inline float apply(F f, float x, Args ...args) {
+				return _mm_cvtss_f32(f(float4{ _mm_set_ss(x) }, float4{ _mm_set_ss(args) }...).v);
+			}
+
+			// components i to i + 3 of v, padded with 0
+			template <size_t N>
+			inline float4 load4(const basic_vec<float, N> &v, size_t i) {
+				auto at = [&](size_t k) { return i + k < N ? v[i + k] : 0.f; };
+				return { _mm_setr_ps(at(0), at(1), at(2), at(3)) };
+			}
+
+			template <size_t N>
+			inline void store4(basic_vec<float, N> &v, size_t i, float4 a) {
+				alignas(16) float t[4];
+				_mm_store_ps(t, a.v);
+				for (size_t k = 0; k < 4 && i + k < N; k++) v[i + k] = t[k];
+			}
+
+			template <size_t N, typename F, typename ...Args>
+			inline basic_vec<float, N> apply(F f, const basic_vec<float, N> &v, const Args &...args) {
+				basic_vec<float, N> r;
+				for (size_t i = 0; i < N; i += 4) store4(r, i, f(load4(v, i), load4(args, i)...));
+				return r;
+			}
+#else
+			template <typename F, typename ...Args>
+			inline float apply(F f, float x, Args ...args) {
+				return f(x, args...);
+			}
+
+			template <size_t N, typename F, typename ...Args>
+			inline basic_vec<float, N> apply(F f, const basic_vec<float, N> &v, const Args &...args) {
+				basic_vec<float, N> r;
+				for (size_t i = 0; i < N; i++) r[i] = f(v[i], args[i]...);
+				return r;
+			}
+#endif
+
+			struct rsqrt_f { template <typename V> V operator()(V x) const { return lane_rsqrt(x); } };
+			struct rsqrt_unchecked_f { template <typename V> V operator()(V x) const { return lane_rsqrt_unchecked(x); } };
+			struct sqrt_f { template <typename V> V operator()(V x) const { return sqrt_kernel(x); } };
+			struct sin_f { template <typename V> V operator()(V x) const { return sin_kernel(x, 0); } };
+			struct cos_f { template <typename V> V operator()(V x) const { return sin_kernel(x, 1); } };
+			struct exp_f { template <typename V> V operator()(V x) const { return exp_kernel(x); } };
+			struct log_f { template <typename V> V operator()(V x) const { return log_kernel(x); } };
+			struct atan2_f { template <typename V> V operator()(V y, V x) const { return atan2_kernel(y, x); } };
+			struct pow_f { template <typename V> V operator()(V x, V y) const { return exp_kernel(y * log_kernel(x)); } };
+		}
+
+		inline float rsqrt(float x) { return detail::apply(detail::rsqrt_f(), x); }
+		inline float sqrt(float x) { return detail::apply(detail::sqrt_f(), x); }
+		inline float sin(float x) { return detail::apply(detail::sin_f(), x); }
+		inline float cos(float x) { return detail::apply(detail::cos_f(), x); }
+		inline float atan2(float y, float x) { return detail::apply(detail::atan2_f(), y, x); }
+		inline float exp(float x) { return detail::apply(detail::exp_f(), x); }
+		inline float log(float x) { return detail::apply(detail::log_f(), x); }
+		inline float pow(float x, float y) { return detail::apply(detail::pow_f(), x, y); }
+
+		// component-wise
+		template <size_t N>
+		inline basic_vec<float, N> rsqrt(const basic_vec<float, N> &v) { return detail::apply(detail::rsqrt_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> sqrt(const basic_vec<float, N> &v) { return detail::apply(detail::sqrt_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> sin(const basic_vec<float, N> &v) { return detail::apply(detail::sin_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> cos(const basic_vec<float, N> &v) { return detail::apply(detail::cos_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> atan2(const basic_vec<float, N> &y, const basic_vec<float, N> &x) { return detail::apply(detail::atan2_f(), y, x); }
+
+		template <size_t N>
+		inline basic_vec<float, N> exp(const basic_vec<float, N> &v) { return detail::apply(detail::exp_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> log(const basic_vec<float, N> &v) { return detail::apply(detail::log_f(), v); }
+
+		template <size_t N>
+		inline basic_vec<float, N> pow(const basic_vec<float, N> &x, const basic_vec<float, N> &y) { return detail::apply(detail::pow_f(), x, y); }
+
+		template <size_t N>
+		inline float length(const basic_vec<float, N> &v) { return fast::sqrt(dot(v, v)); }
+
+		// nan for a zero vector like cgra::normalize (and for vectors shorter than 1e-19)
+		template <size_t N>
+		inline basic_vec<float, N> normalize(const basic_vec<float, N> &v) { return v * detail::apply(detail::rsqrt_unchecked_f(), dot(v, v)); }
+
+
+		// Bulk versions for arrays (r may be the same array as an input) and,
+		// component-wise, for SoA containers. Outputs are resized to match the input.
+		// Arrays larger than soa_parallel_threshold are split across threads with
+		// parallel_for, which does not change the results.
+		void rsqrt(const float *x, float *r, size_t n);
+		void sqrt(const float *x, float *r, size_t n);
+		void sin(const float *x, float *r, size_t n);
+		void cos(const float *x, float *r, size_t n);
+		void atan2(const float *y, const float *x, float *r, size_t n);
+		void exp(const float *x, float *r, size_t n);
+		void log(const float *x, float *r, size_t n);
+		void pow(const float *x, const float *y, float *r, size_t n);
+
+		void rsqrt(const vec3_soa &in, vec3_soa &out);
+		void sqrt(const vec3_soa &in, vec3_soa &out);
+		void sin(const vec3_soa &in, vec3_soa &out);
+		void cos(const vec3_soa &in, vec3_soa &out);
+		void exp(const vec3_soa &in, vec3_soa &out);
+		void log(const vec3_soa &in, vec3_soa &out);
+
+		void rsqrt(const vec4_soa &in, vec4_soa &out);
+		void sqrt(const vec4_soa &in, vec4_soa &out);
+		void sin(const vec4_soa &in, vec4_soa &out);
+		void cos(const vec4_soa &in, vec4_soa &out);
+		void exp(const vec4_soa &in, vec4_soa &out);
+		void log(const vec4_soa &in, vec4_soa &out);
+
+		void length(const vec3_soa &in, std::vector<float> &out);
+		void normalize(const vec3_soa &in, vec3_soa &out);
+	}
+}
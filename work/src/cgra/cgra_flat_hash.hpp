@@ -0,0 +1,318 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// project
+#include "cgra_math.hpp"
+
+
+namespace cgra {
+
+	namespace detail {
+
+		// Open addressing hash table with linear probing, used by flat_hash_map and
+		// flat_hash_set. Slots are stored in one array (no allocation per element)
+		// beside an array of tags: 0 for an empty slot, otherwise the high bits of the
+		// hash, so most non-matching slots are skipped without comparing keys. Erase
+		// shifts the following slots back instead of leaving tombstones.
+		template <typename Key, typename Slot, typename KeyOf, typename Hash, typename KeyEqual>
+		class flat_hash_table {
+		public:
+			static constexpr size_t npos = size_t(-1);
+
+			template <bool Const>
+			class basic_iterator {
+			private:
+				friend class flat_hash_table;
+				using table_t = std::conditional_t<Const, const flat_hash_table, flat_hash_table>;
+
+				table_t *m_table = nullptr;
+				size_t m_i = 0;
+
+				void skip_empty() {
+					while (m_i < m_table->m_tags.size() && m_table->m_tags[m_i] == 0) m_i++;
+				}
+
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = Slot;
+				using difference_type = std::ptrdiff_t;
+				using pointer = std::conditional_t<Const, const Slot *, Slot *>;
+				using reference = std::conditional_t<Const, const Slot &, Slot &>;
+
+				basic_iterator() { }
+				basic_iterator(table_t *table, size_t i) : m_table(table), m_i(i) { skip_empty(); }
+
+				operator basic_iterator<true>() const { return basic_iterator<true>(m_table, m_i); }
+
+				reference operator*() const { return m_table->m_slots[m_i]; }
+				pointer operator->() const { return &m_table->m_slots[m_i]; }
+
+				basic_iterator & operator++() {
+					m_i++;
+					skip_empty();
+					return *this;
+				}
+
+				basic_iterator operator++(int) {
+					basic_iterator r = *this;
+					++*this;
+					return r;
+				}
+
+				friend bool operator==(const basic_iterator &a, const basic_iterator &b) { return a.m_i == b.m_i; }
+				friend bool operator!=(const basic_iterator &a, const basic_iterator &b) { return a.m_i != b.m_i; }
+			};
+
+			using iterator = basic_iterator<false>;
+			using const_iterator = basic_iterator<true>;
+
+		private:
+			std::vector<Slot> m_slots;
+			std::vector<uint32_t> m_tags;
+			size_t m_size = 0;
+			size_t m_mask = 0;
+			Hash m_hash;
+			KeyEqual m_equal;
+
+			static uint32_t tag_of(uint64_t h) {
+				return uint32_t(h >> 32) | 1;
+			}
+
+			// the slot for key, or the empty slot where it would go
+			size_t probe(const Key &key, uint64_t h, bool &found) const {
+				const uint32_t tag = tag_of(h);
+				for (size_t i = size_t(h) & m_mask; ; i = (i + 1) & m_mask) {
+					if (m_tags[i] == 0) {
+						found = false;
+						return i;
+					}
+					if (m_tags[i] == tag && m_equal(KeyOf()(m_slots[i]), key)) {
+						found = true;
+						return i;
+					}
+				}
+			}
+
+			void rehash(size_t capacity) {
+				std::vector<Slot> slots(capacity);
+				std::vector<uint32_t> tags(capacity, 0);
+				const size_t mask = capacity - 1;
+				for (size_t i = 0; i < m_tags.size(); i++) {
+					if (m_tags[i] == 0) continue;
+					size_t j = size_t(m_hash(KeyOf()(m_slots[i]))) & mask;
+					while (tags[j] != 0) j = (j + 1) & mask;
+					tags[j] = m_tags[i];
+					slots[j] = std::move(m_slots[i]);
+				}
+				m_slots = std::move(slots);
+				m_tags = std::move(tags);
+				m_mask = mask;
+			}
+
+		public:
+			flat_hash_table() { }
+
+			size_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+			size_t capacity() const { return m_tags.size(); }
+
+			// tables are kept at most 3/4 full
+			void reserve(size_t n) {
+				size_t capacity = std::max<size_t>(m_tags.size(), 8);
+				while (n > capacity / 4 * 3) capacity *= 2;
+				if (capacity != m_tags.size()) rehash(capacity);
+			}
+
+			void clear() {
+				std::fill(m_tags.begin(), m_tags.end(), 0);
+				std::fill(m_slots.begin(), m_slots.end(), Slot());
+				m_size = 0;
+			}
+
+			iterator begin() { return iterator(this, 0); }
+			iterator end() { return iterator(this, m_tags.size()); }
+			const_iterator begin() const { return const_iterator(this, 0); }
+			const_iterator end() const { return const_iterator(this, m_tags.size()); }
+
+			size_t find_index(const Key &key) const {
+				if (m_size == 0) return npos;
+				bool found;
+				const size_t i = probe(key, m_hash(key), found);
+				return found ? i : npos;
+			}
+
+			iterator at_index(size_t i) { return i == npos ? end() : iterator(this, i); }
+			const_iterator at_index(size_t i) const { return i == npos ? end() : const_iterator(this, i); }
+
+			// inserts make_slot() if key is not present
+			// returns the index of the slot for key and whether it was inserted
+			template <typename MakeSlot>
+			std::pair<size_t, bool> insert(const Key &key, MakeSlot &&make_slot) {
+				reserve(m_size + 1);
+				const uint64_t h = m_hash(key);
+				bool found;
+				const size_t i = probe(key, h, found);
+				if (found) return { i, false };
+				m_slots[i] = make_slot();
+				m_tags[i] = tag_of(h);
+				m_size++;
+				return { i, true };
+			}
+
+			size_t erase(const Key &key) {
+				size_t i = find_index(key);
+				if (i == npos) return 0;
+				// move back every following slot that may do so without
+				// being placed before its home slot, until an empty slot
+				for (size_t j = (i + 1) & m_mask; m_tags[j] != 0; j = (j + 1) & m_mask) {
+					const size_t home = size_t(m_hash(KeyOf()(m_slots[j]))) & m_mask;
+					if (((j - home) & m_mask) >= ((j - i) & m_mask)) {
+						m_slots[i] = std::move(m_slots[j]);
+						m_tags[i] = m_tags[j];
+						i = j;
+					}
+				}
+				m_slots[i] = Slot();
+				m_tags[i] = 0;
+				m_size--;
+				return 1;
+			}
+		};
+
+		template <typename Key, typename T>
+		struct flat_map_key_of {
+			const Key & operator()(const std::pair<Key, T> &p) const { return p.first; }
+		};
+
+		template <typename Key>
+		struct flat_set_key_of {
+			const Key & operator()(const Key &k) const { return k; }
+		};
+	}
+
+
+	// Hash map without per-element allocations, for vertex welding, spatial
+	// hashing, voxel lookups and similar, e.g. flat_hash_map<ivec3, int>.
+	// Keys are hashed with hash64 by default, which handles -0 and 0 as equal.
+	// Keys and values must be default constructible and are moved when the table
+	// grows or an element is erased, so insert and erase invalidate iterators
+	// and references. Elements are std::pair<Key, T>; don't modify the keys.
+	template <typename Key, typename T, typename Hash = hasher, typename KeyEqual = std::equal_to<Key>>
+	class flat_hash_map {
+	private:
+		using table_t = detail::flat_hash_table<Key, std::pair<Key, T>, detail::flat_map_key_of<Key, T>, Hash, KeyEqual>;
+		table_t m_table;
+
+	public:
+		using key_type = Key;
+		using mapped_type = T;
+		using value_type = std::pair<Key, T>;
+		using iterator = typename table_t::iterator;
+		using const_iterator = typename table_t::const_iterator;
+
+		flat_hash_map() { }
+		explicit flat_hash_map(size_t n) { reserve(n); }
+
+		size_t size() const { return m_table.size(); }
+		bool empty() const { return m_table.empty(); }
+		size_t capacity() const { return m_table.capacity(); }
+		void reserve(size_t n) { m_table.reserve(n); }
+		void clear() { m_table.clear(); }
+
+		iterator begin() { return m_table.begin(); }
+		iterator end() { return m_table.end(); }
+		const_iterator begin() const { return m_table.begin(); }
+		const_iterator end() const { return m_table.end(); }
+
+		iterator find(const Key &key) { return m_table.at_index(m_table.find_index(key)); }
+		const_iterator find(const Key &key) const { return m_table.at_index(m_table.find_index(key)); }
+		bool contains(const Key &key) const { return m_table.find_index(key) != table_t::npos; }
+		size_t count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+		// throws std::out_of_range if key is not present
+		T & at(const Key &key) {
+			const size_t i = m_table.find_index(key);
+			if (i == table_t::npos) throw std::out_of_range("flat_hash_map::at");
+			return m_table.at_index(i)->second;
+		}
+
+		const T & at(const Key &key) const {
+			const size_t i = m_table.find_index(key);
+			if (i == table_t::npos) throw std::out_of_range("flat_hash_map::at");
+			return m_table.at_index(i)->second;
+		}
+
+		// constructs the value from args only if key is not present
+		template <typename ...Args>
+		std::pair<iterator, bool> try_emplace(const Key &key, Args &&...args) {
+			auto r = m_table.insert(key, [&]() {
+				return value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+			});
+			return { m_table.at_index(r.first), r.second };
+		}
+
+		std::pair<iterator, bool> insert(const value_type &v) {
+			return try_emplace(v.first, v.second);
+		}
+
+		template <typename M>
+		std::pair<iterator, bool> insert_or_assign(const Key &key, M &&value) {
+			auto r = try_emplace(key, std::forward<M>(value));
+			if (!r.second) r.first->second = std::forward<M>(value);
+			return r;
+		}
+
+		T & operator[](const Key &key) { return try_emplace(key).first->second; }
+
+		size_t erase(const Key &key) { return m_table.erase(key); }
+	};
+
+
+	// Hash set without per-element allocations, see flat_hash_map
+	template <typename Key, typename Hash = hasher, typename KeyEqual = std::equal_to<Key>>
+	class flat_hash_set {
+	private:
+		using table_t = detail::flat_hash_table<Key, Key, detail::flat_set_key_of<Key>, Hash, KeyEqual>;
+		table_t m_table;
+
+	public:
+		using key_type = Key;
+		using value_type = Key;
+		using iterator = typename table_t::const_iterator;
+		using const_iterator = typename table_t::const_iterator;
+
+		flat_hash_set() { }
+		explicit flat_hash_set(size_t n) { reserve(n); }
+
+		size_t size() const { return m_table.size(); }
+		bool empty() const { return m_table.empty(); }
+		size_t capacity() const { return m_table.capacity(); }
+		void reserve(size_t n) { m_table.reserve(n); }
+		void clear() { m_table.clear(); }
+
+		const_iterator begin() const { return m_table.begin(); }
+		const_iterator end() const { return m_table.end(); }
+
+		const_iterator find(const Key &key) const { return m_table.at_index(m_table.find_index(key)); }
+		bool contains(const Key &key) const { return m_table.find_index(key) != table_t::npos; }
+		size_t count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+		std::pair<const_iterator, bool> insert(const Key &key) {
+			auto r = m_table.insert(key, [&]() { return key; });
+			return { static_cast<const table_t &>(m_table).at_index(r.first), r.second };
+		}
+
+		size_t erase(const Key &key) { return m_table.erase(key); }
+	};
+}
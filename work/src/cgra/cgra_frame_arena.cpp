@@ -0,0 +1,152 @@
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// project
+#include "cgra_frame_arena.hpp"
+#include "cgra_gui.hpp"
+
+
+namespace cgra {
+
+	void linear_arena::add_block(size_t min_size) {
+		const size_t size = std::max(m_block_size, min_size);
+		// the rest of the current block is abandoned
+		if (!m_blocks.empty()) m_used += m_blocks.back().size - m_offset;
+		m_blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+		m_offset = 0;
+		m_heap_allocations++;
+	}
+
+
+	void * linear_arena::allocate(size_t bytes, size_t align) {
+		assert(align && (align & (align - 1)) == 0);
+		bytes = std::max<size_t>(bytes, 1);
+
+		uintptr_t base = m_blocks.empty() ? 0 : uintptr_t(m_blocks.back().data.get());
+		size_t padding = (align - ((base + m_offset) & (align - 1))) & (align - 1);
+		if (m_blocks.empty() || m_offset + padding + bytes > m_blocks.back().size) {
+			// new[] only guarantees max_align_t alignment, leave room for more
+			add_block(bytes + (align > alignof(std::max_align_t) ? align : 0));
+			base = uintptr_t(m_blocks.back().data.get());
+			padding = (align - (base & (align - 1))) & (align - 1);
+		}
+
+		unsigned char *p = m_blocks.back().data.get() + m_offset + padding;
+		m_offset += padding + bytes;
+		m_used += padding + bytes;
+#if CGRA_FRAME_ARENA_DEBUG
+		std::memset(p, 0xCD, bytes);
+#endif
+		return p;
+	}
+
+
+	void linear_arena::deallocate(void *p, size_t bytes) {
+		if (!p) return;
+		bytes = std::max<size_t>(bytes, 1);
+#if CGRA_FRAME_ARENA_DEBUG
+		std::memset(p, 0xDD, bytes);
+#endif
+		if (m_blocks.empty()) return;
+		unsigned char *top = m_blocks.back().data.get() + m_offset;
+		if (static_cast<unsigned char *>(p) + bytes == top) {
+			m_offset -= bytes;
+			m_used -= bytes;
+		}
+	}
+
+
+	void linear_arena::reset() {
+#if CGRA_FRAME_ARENA_DEBUG
+		for (size_t i = 0; i < m_blocks.size(); i++) {
+			std::memset(m_blocks[i].data.get(), 0xDD, i + 1 < m_blocks.size() ? m_blocks[i].size : m_offset);
+		}
+#endif
+		// grew over the frame, replace the blocks with one that fits them all
+		if (m_blocks.size() > 1) {
+			const size_t size = capacity();
+			m_blocks.clear();
+			m_blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+			m_heap_allocations++;
+		}
+		m_offset = 0;
+		m_used = 0;
+	}
+
+
+	size_t linear_arena::capacity() const {
+		size_t size = 0;
+		for (auto &b : m_blocks) size += b.size;
+		return size;
+	}
+
+
+	frame_arena & frame_arena::current() {
+		static frame_arena arena;
+		return arena;
+	}
+
+
+	frame_arena::thread_arenas & frame_arena::local() {
+		thread_local thread_arenas *arenas = nullptr;
+		if (!arenas) {
+			// arenas are owned by the frame_arena so they outlive their thread
+			std::lock_guard<std::mutex> lock(m_threads_mutex);
+			m_threads.push_back(std::make_unique<thread_arenas>());
+			arenas = m_threads.back().get();
+		}
+		return *arenas;
+	}
+
+
+	void frame_arena::end_frame() {
+		const uint64_t frame = m_frame.load(std::memory_order_relaxed);
+		stats s;
+		{
+			std::lock_guard<std::mutex> lock(m_threads_mutex);
+			for (auto &t : m_threads) {
+				linear_arena &finished = t->arenas[frame & 1];
+				linear_arena &next = t->arenas[(frame + 1) & 1];
+				s.used += finished.used();
+
+				// the frame before last, now free to reuse
+				next.reset();
+				s.capacity += finished.capacity() + next.capacity();
+				s.heap_allocations += finished.heap_allocations() + next.heap_allocations();
+			}
+			s.threads = m_threads.size();
+		}
+
+		// the arenas count every heap allocation they have made
+		const size_t heap_total = s.heap_allocations;
+		s.heap_allocations = heap_total - m_heap_total;
+		m_heap_total = heap_total;
+
+		m_last = s;
+		m_peak = std::max(m_peak, s.used);
+		m_history[m_history_index] = float(s.used / 1024.0);
+		m_history_index = (m_history_index + 1) % history_size;
+
+		// workers read the frame when they allocate, see the class comment
+		m_frame.store(frame + 1, std::memory_order_release);
+	}
+
+
+	void frame_arena::render_gui() {
+		if (!ImGui::CollapsingHeader("Frame Arena")) return;
+
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "%.1f KB, peak %.1f KB", m_last.used / 1024.0, m_peak / 1024.0);
+		const float max_kb = *std::max_element(m_history.begin(), m_history.end());
+		ImGui::PlotLines("##frame_arena", m_history.data(), int(history_size), int(m_history_index), overlay, 0.f, std::max(max_kb, 1.f), ImVec2(0, 60));
+		ImGui::Text("%.1f KB reserved by %zu threads", m_last.capacity / 1024.0, m_last.threads);
+		ImGui::Text("%zu heap allocations last frame", m_last.heap_allocations);
+#if CGRA_FRAME_ARENA_DEBUG
+		ImGui::Text("Debug poisoning on");
+#endif
+	}
+}
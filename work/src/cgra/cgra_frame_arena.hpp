@@ -0,0 +1,164 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+// Debug builds poison freed arena memory (0xDD) and fill new allocations
+// (0xCD), so use after the end of a frame shows up quickly
+// Define CGRA_FRAME_ARENA_DEBUG as 0 or 1 to override
+#ifndef CGRA_FRAME_ARENA_DEBUG
+#ifdef NDEBUG
+#define CGRA_FRAME_ARENA_DEBUG 0
+#else
+#define CGRA_FRAME_ARENA_DEBUG 1
+#endif
+#endif
+
+
+namespace cgra {
+
+	// Bump allocator over a list of heap blocks. Memory is only freed all at
+	// once by reset(), which keeps a single block as big as all the blocks
+	// it had, so once it has grown to fit a frame it no longer touches the
+	// heap. Not thread safe.
+	class linear_arena {
+	private:
+		struct block {
+			std::unique_ptr<unsigned char[]> data;
+			size_t size;
+		};
+
+		std::vector<block> m_blocks;
+		size_t m_block_size;
+		size_t m_offset = 0;   // into the last block
+		size_t m_used = 0;     // including padding and abandoned block tails
+		size_t m_heap_allocations = 0;
+
+		void add_block(size_t min_size);
+
+	public:
+		explicit linear_arena(size_t block_size = size_t(64) << 10) : m_block_size(block_size) { }
+
+		linear_arena(const linear_arena &) = delete;
+		linear_arena & operator=(const linear_arena &) = delete;
+
+		// align must be a power of two
+		void * allocate(size_t bytes, size_t align);
+
+		// gives the memory back if it was the last allocation, so a vector
+		// that grows in place of its last buffer reuses it
+		void deallocate(void *p, size_t bytes);
+
+		void reset();
+
+		size_t used() const { return m_used; }
+		size_t capacity() const;
+		size_t heap_allocations() const { return m_heap_allocations; }
+	};
+
+
+	// Per-frame, double-buffered memory for transient data (culling
+	// results, draw lists, debug geometry). Memory allocated during a frame
+	// stays valid until the end of the next frame, so results can be
+	// consumed one frame late, and is then released all at once. Each
+	// thread (the main thread and every job worker) allocates from its own
+	// pair of arenas, so allocation never locks.
+	//
+	// end_frame must be called on the main thread at the frame boundary,
+	// while no other thread is allocating.
+	class frame_arena {
+	public:
+		static constexpr size_t history_size = 120;
+
+		struct stats {
+			size_t used = 0;             // bytes allocated in the frame, over all threads
+			size_t capacity = 0;         // bytes reserved by every arena
+			size_t heap_allocations = 0; // blocks taken from the heap in the frame
+			size_t threads = 0;
+		};
+
+	private:
+		struct thread_arenas {
+			std::array<linear_arena, 2> arenas;
+		};
+
+		// registration happens once per thread so a lock is fine here
+		std::mutex m_threads_mutex;
+		std::vector<std::unique_ptr<thread_arenas>> m_threads;
+		std::atomic<uint64_t> m_frame{ 0 };
+
+		// main thread only
+		stats m_last;
+		size_t m_peak = 0;
+		size_t m_heap_total = 0;
+		std::array<float, history_size> m_history{ }; // KB per frame
+		size_t m_history_index = 0;
+
+		frame_arena() { }
+
+		thread_arenas & local();
+
+	public:
+		frame_arena(const frame_arena &) = delete;
+		frame_arena & operator=(const frame_arena &) = delete;
+
+		static frame_arena & current();
+
+		// align must be a power of two
+		void * allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+			return local().arenas[m_frame.load(std::memory_order_relaxed) & 1].allocate(bytes, align);
+		}
+
+		// only gives the memory back if it was the thread's last allocation
+		void deallocate(void *p, size_t bytes) {
+			local().arenas[m_frame.load(std::memory_order_relaxed) & 1].deallocate(p, bytes);
+		}
+
+		// releases the previous frame's memory and starts a new frame
+		void end_frame();
+
+		uint64_t frame() const { return m_frame.load(std::memory_order_relaxed); }
+		const stats & last_frame() const { return m_last; }
+		size_t peak() const { return m_peak; }
+
+		// usage graph and peak inside the current ImGui window
+		void render_gui();
+	};
+
+
+	// STL allocator over frame_arena::current(), for containers that live
+	// no longer than the next frame. Reserve where the size is known, since
+	// the buffers a container grows out of are only reclaimed at the end of
+	// the frame after next.
+	template <typename T>
+	class frame_allocator {
+	public:
+		using value_type = T;
+
+		frame_allocator() noexcept { }
+		template <typename U> frame_allocator(const frame_allocator<U> &) noexcept { }
+
+		T * allocate(size_t n) {
+			if (n > size_t(-1) / sizeof(T)) throw std::bad_alloc();
+			return static_cast<T *>(frame_arena::current().allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T *p, size_t n) noexcept {
+			frame_arena::current().deallocate(p, n * sizeof(T));
+		}
+
+		template <typename U> bool operator==(const frame_allocator<U> &) const noexcept { return true; }
+		template <typename U> bool operator!=(const frame_allocator<U> &) const noexcept { return false; }
+	};
+
+	template <typename T>
+	using frame_vector = std::vector<T, frame_allocator<T>>;
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+// std
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+// only needs the GL types and functions, not all of opengl.hpp
+// (opengl.hpp includes this header for draw_dummy)
+#include <GL/glew.h>
+
+
+namespace cgra {
+
+	// Shadows the GL state that we change often so that redundant calls
+	// can be dropped. All binding and state changes for the program, VAO,
+	// buffers, textures, samplers, polygon mode, depth and blend should go
+	// through this object, otherwise the cache will be out of date. Objects
+	// that are deleted should be forgotten since GL reuses names.
+	//
+	// Code that changes state behind our back must either restore it (like
+	// the ImGui backend does) or call invalidate().
+	class gl_state {
+	public:
+		struct counters {
+			unsigned issued = 0;
+			unsigned skipped = 0;
+		};
+
+		static constexpr unsigned max_texture_units = 32;
+
+	private:
+		// sentinel for state we don't know about
+		static constexpr GLuint unknown = GLuint(-1);
+
+		// texture targets we cache, others are passed through
+		static constexpr std::array<GLenum, 5> texture_targets {{
+			GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_1D
+		}};
+
+		// buffer targets we cache, others (GL_ELEMENT_ARRAY_BUFFER is VAO state) are passed through
+		static constexpr std::array<GLenum, 6> buffer_targets {{
+			GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+			GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER
+		}};
+
+		GLuint m_program;
+		GLuint m_vao;
+		std::array<GLuint, buffer_targets.size()> m_buffers;
+		GLuint m_active_texture;
+		std::array<std::array<GLuint, texture_targets.size()>, max_texture_units> m_textures;
+		std::array<GLuint, max_texture_units> m_samplers;
+		GLuint m_polygon_mode;
+		GLuint m_depth_test;
+		GLuint m_depth_func;
+		GLuint m_depth_mask;
+		GLuint m_blend;
+		GLuint m_blend_src;
+		GLuint m_blend_dst;
+		GLuint m_cull_face;
+
+		// sampler/int uniforms, keyed by program and location
+		std::unordered_map<uint64_t, GLint> m_uniforms;
+
+		counters m_frame;
+		counters m_last_frame;
+
+		template <size_t N>
+		static int find_target(const std::array<GLenum, N> &targets, GLenum target) {
+			for (size_t i = 0; i < N; i++) {
+				if (targets[i] == target) return int(i);
+			}
+			return -1;
+		}
+
+		static uint64_t uniform_key(GLuint program, GLint location) {
+			return (uint64_t(program) << 32) | uint32_t(location);
+		}
+
+		// returns true if the call must be issued and updates the cached value
+		bool change(GLuint &cached, GLuint value) {
+			if (cached == value) {
+				m_frame.skipped++;
+				return false;
+			}
+			cached = value;
+			m_frame.issued++;
+			return true;
+		}
+
+		void pass_through() { m_frame.issued++; }
+
+	public:
+		gl_state() { invalidate(); }
+
+		// state for the current context (we only use one)
+		static gl_state & current() {
+			static gl_state state;
+			return state;
+		}
+
+		// forget everything, the next call for any state will be issued
+		void invalidate() {
+			m_program = unknown;
+			m_vao = unknown;
+			m_buffers.fill(unknown);
+			m_active_texture = unknown;
+			for (auto &unit : m_textures) unit.fill(unknown);
+			m_samplers.fill(unknown);
+			m_polygon_mode = unknown;
+			m_depth_test = unknown;
+			m_depth_func = unknown;
+			m_depth_mask = unknown;
+			m_blend = unknown;
+			m_blend_src = unknown;
+			m_blend_dst = unknown;
+			m_cull_face = unknown;
+			m_uniforms.clear();
+		}
+
+		// call once per frame, moves the counters to last_frame()
+		void end_frame() {
+			m_last_frame = m_frame;
+			m_frame = counters();
+		}
+
+		const counters & frame() const { return m_frame; }
+		const counters & last_frame() const { return m_last_frame; }
+
+
+		// programs and uniforms
+		//
+
+		void use_program(GLuint program) {
+			if (change(m_program, program)) glUseProgram(program);
+		}
+
+		// sets an int (usually sampler) uniform on the currently bound program
+		void uniform(GLint location, GLint value) {
+			if (location < 0) return;
+			auto it = m_uniforms.find(uniform_key(m_program, location));
+			if (m_program != unknown && it != m_uniforms.end() && it->second == value) {
+				m_frame.skipped++;
+				return;
+			}
+			if (m_program != unknown) m_uniforms[uniform_key(m_program, location)] = value;
+			glUniform1i(location, value);
+			pass_through();
+		}
+
+		// call when a program is deleted or relinked (which resets its uniforms)
+		void forget_program(GLuint program) {
+			if (m_program == program) m_program = unknown;
+			for (auto it = m_uniforms.begin(); it != m_uniforms.end(); ) {
+				if ((it->first >> 32) == program) it = m_uniforms.erase(it);
+				else ++it;
+			}
+		}
+
+
+		// vertex arrays and buffers
+		//
+
+		void bind_vertex_array(GLuint vao) {
+			if (change(m_vao, vao)) glBindVertexArray(vao);
+		}
+
+		void bind_buffer(GLenum target, GLuint buffer) {
+			int i = find_target(buffer_targets, target);
+			if (i < 0) {
+				glBindBuffer(target, buffer);
+				pass_through();
+			}
+			else if (change(m_buffers[i], buffer)) {
+				glBindBuffer(target, buffer);
+			}
+		}
+
+		void forget_vertex_array(GLuint vao) {
+			if (m_vao == vao) m_vao = unknown;
+		}
+
+		void forget_buffer(GLuint buffer) {
+			for (auto &b : m_buffers) {
+				if (b == buffer) b = unknown;
+			}
+		}
+
+
+		// textures and samplers
+		//
+
+		// unit is an index (0, 1, ...), not GL_TEXTUREi
+		void active_texture(GLuint unit) {
+			if (change(m_active_texture, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+		}
+
+		void bind_texture(GLuint unit, GLenum target, GLuint texture) {
+			int i = find_target(texture_targets, target);
+			if (unit >= max_texture_units || i < 0) {
+				active_texture(unit);
+				glBindTexture(target, texture);
+				pass_through();
+			}
+			else if (m_textures[unit][i] == texture) {
+				m_frame.skipped++;
+			}
+			else {
+				active_texture(unit);
+				m_textures[unit][i] = texture;
+				glBindTexture(target, texture);
+				m_frame.issued++;
+			}
+		}
+
+		void bind_sampler(GLuint unit, GLuint sampler) {
+			if (unit >= max_texture_units) {
+				glBindSampler(unit, sampler);
+				pass_through();
+			}
+			else if (change(m_samplers[unit], sampler)) {
+				glBindSampler(unit, sampler);
+			}
+		}
+
+		void forget_texture(GLuint texture) {
+			for (auto &unit : m_textures) {
+				for (auto &t : unit) {
+					if (t == texture) t = unknown;
+				}
+			}
+		}
+
+
+		// fixed function state
+		//
+
+		void polygon_mode(GLenum mode) {
+			if (change(m_polygon_mode, mode)) glPolygonMode(GL_FRONT_AND_BACK, mode);
+		}
+
+		void depth_test(bool enable) {
+			if (change(m_depth_test, enable)) {
+				if (enable) glEnable(GL_DEPTH_TEST);
+				else glDisable(GL_DEPTH_TEST);
+			}
+		}
+
+		void depth_func(GLenum func) {
+			if (change(m_depth_func, func)) glDepthFunc(func);
+		}
+
+		void depth_mask(bool write) {
+			if (change(m_depth_mask, write)) glDepthMask(write);
+		}
+
+		void blend(bool enable) {
+			if (change(m_blend, enable)) {
+				if (enable) glEnable(GL_BLEND);
+				else glDisable(GL_BLEND);
+			}
+		}
+
+		void blend_func(GLenum src, GLenum dst) {
+			if (m_blend_src == src && m_blend_dst == dst) {
+				m_frame.skipped++;
+				return;
+			}
+			m_blend_src = src;
+			m_blend_dst = dst;
+			glBlendFunc(src, dst);
+			pass_through();
+		}
+
+		void cull_face(bool enable) {
+			if (change(m_cull_face, enable)) {
+				if (enable) glEnable(GL_CULL_FACE);
+				else glDisable(GL_CULL_FACE);
+			}
+		}
+	};
+
+}
@@ -0,0 +1,236 @@
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// project
+#include "cgra_gpu_memory.hpp"
+#include "cgra_gui.hpp"
+
+
+namespace {
+
+	const char *kind_names[] = { "buffers", "textures", "renderbuffers" };
+
+	double megabytes(size_t bytes) {
+		return bytes / double(1 << 20);
+	}
+
+	const char * format_name(GLenum format) {
+		switch (format) {
+		case 0: return "-";
+		case GL_RGBA8: return "RGBA8";
+		case GL_RGBA: return "RGBA";
+		case GL_RGB8: return "RGB8";
+		case GL_RGB: return "RGB";
+		case GL_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGBA16F: return "RGBA16F";
+		case GL_RGBA32F: return "RGBA32F";
+		case GL_DEPTH_COMPONENT24: return "DEPTH24";
+		case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+		case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+		default: return "other";
+		}
+	}
+}
+
+
+namespace cgra {
+
+	gpu_memory & gpu_memory::current() {
+		static gpu_memory memory;
+		return memory;
+	}
+
+
+	size_t gpu_memory::texel_bytes(GLenum internal_format) {
+		switch (internal_format) {
+		case GL_R8: case GL_RED: case GL_STENCIL_INDEX8:
+			return 1;
+		case GL_RG8: case GL_RG: case GL_R16F: case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: case GL_RGBA16: case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGBA32F: case GL_RGB32F:
+			return 16;
+		default:
+			// RGBA8, and RGB8 and 24-bit depth which drivers pad to 4 bytes
+			return 4;
+		}
+	}
+
+
+	void gpu_memory::record(const allocation &a) {
+		auto it = m_allocations.find(key(a.kind, a.name));
+		if (it != m_allocations.end()) {
+			// respecified, replaces the old storage
+			m_totals[size_t(it->second.kind)] -= it->second.bytes;
+			it->second = a;
+		}
+		else {
+			m_allocations.emplace(key(a.kind, a.name), a);
+		}
+		m_totals[size_t(a.kind)] += a.bytes;
+		m_peak = std::max(m_peak, total());
+	}
+
+
+	void gpu_memory::release(gpu_resource kind, GLsizei n, const GLuint *names) {
+		for (GLsizei i = 0; i < n; i++) {
+			auto it = m_allocations.find(key(kind, names[i]));
+			if (it == m_allocations.end()) continue;
+			m_totals[size_t(kind)] -= it->second.bytes;
+			m_allocations.erase(it);
+		}
+	}
+
+
+	void gpu_memory::buffer_data(GLenum target, GLuint buffer, GLsizeiptr size, const void *data, GLenum usage, const char *owner) {
+		glBufferData(target, size, data, usage);
+		allocation a;
+		a.kind = gpu_resource::buffer;
+		a.name = buffer;
+		a.bytes = size_t(size);
+		a.owner = owner;
+		record(a);
+	}
+
+
+	void gpu_memory::tex_image_2d(GLuint texture, GLenum internal_format, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, const void *pixels, bool mipmaps, const char *owner)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, pixels);
+		allocation a;
+		a.kind = gpu_resource::texture;
+		a.name = texture;
+		a.format = internal_format;
+		a.width = width;
+		a.height = height;
+		a.owner = owner;
+
+		// each level is half the size of the last, down to 1x1
+		const size_t texel = texel_bytes(internal_format);
+		for (GLsizei w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+			a.bytes += size_t(w) * h * texel;
+			if (!mipmaps || (w == 1 && h == 1)) break;
+			a.levels++;
+		}
+		record(a);
+	}
+
+
+	void gpu_memory::renderbuffer_storage(GLuint renderbuffer, GLenum internal_format, GLsizei width, GLsizei height, const char *owner) {
+		glRenderbufferStorage(GL_RENDERBUFFER, internal_format, width, height);
+		allocation a;
+		a.kind = gpu_resource::renderbuffer;
+		a.name = renderbuffer;
+		a.bytes = size_t(width) * height * texel_bytes(internal_format);
+		a.format = internal_format;
+		a.width = width;
+		a.height = height;
+		a.owner = owner;
+		record(a);
+	}
+
+
+	void GLAPIENTRY gpu_memory::delete_buffers(GLsizei n, const GLuint *buffers) {
+		current().release(gpu_resource::buffer, n, buffers);
+		glDeleteBuffers(n, buffers);
+	}
+
+
+	void GLAPIENTRY gpu_memory::delete_textures(GLsizei n, const GLuint *textures) {
+		current().release(gpu_resource::texture, n, textures);
+		glDeleteTextures(n, textures);
+	}
+
+
+	void GLAPIENTRY gpu_memory::delete_renderbuffers(GLsizei n, const GLuint *renderbuffers) {
+		current().release(gpu_resource::renderbuffer, n, renderbuffers);
+		glDeleteRenderbuffers(n, renderbuffers);
+	}
+
+
+	void gpu_memory::update() {
+		if (total() <= m_budget) {
+			m_over = false;
+			return;
+		}
+
+		// only unused cached assets can go, so this may not get under budget
+		if (m_evict && m_evictor) m_evictor(total() - m_budget);
+
+		// warn once each time the budget is crossed
+		if (total() > m_budget && !m_over) {
+			std::cerr << "Warning: GPU memory " << megabytes(total()) << " MB is over the budget of " << megabytes(m_budget) << " MB" << std::endl;
+			m_over = true;
+		}
+	}
+
+
+	void gpu_memory::render_gui() {
+		if (!ImGui::CollapsingHeader("GPU Memory")) return;
+
+		const size_t used = total();
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "%.1f / %.0f MB", megabytes(used), megabytes(m_budget));
+		if (used > m_budget) ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.f));
+		ImGui::ProgressBar(m_budget ? std::min(float(double(used) / m_budget), 1.f) : 1.f, ImVec2(-1, 0), overlay);
+		if (used > m_budget) {
+			ImGui::PopStyleColor();
+			ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "Over budget by %.1f MB", megabytes(used - m_budget));
+		}
+		ImGui::Text("%zu allocations, peak %.1f MB", m_allocations.size(), megabytes(m_peak));
+
+		int budget_mb = int(m_budget >> 20);
+		if (ImGui::SliderInt("Budget (MB)", &budget_mb, 16, 4096)) m_budget = size_t(budget_mb) << 20;
+		ImGui::Checkbox("Evict unused assets over budget", &m_evict);
+		if (m_evictor && ImGui::Button("Evict unused assets")) m_evictor(used);
+
+		// totals by category, then by owner within it
+		std::map<std::string, size_t> owners[3];
+		for (auto &p : m_allocations) owners[size_t(p.second.kind)][p.second.owner] += p.second.bytes;
+
+		ImGui::Columns(2, "gpu_memory");
+		ImGui::Text("Category"); ImGui::NextColumn();
+		ImGui::Text("MB"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (size_t k = 0; k < 3; k++) {
+			ImGui::Text("%s", kind_names[k]); ImGui::NextColumn();
+			ImGui::Text("%.2f", megabytes(m_totals[k])); ImGui::NextColumn();
+			for (auto &o : owners[k]) {
+				ImGui::Text("  %s", o.first.c_str()); ImGui::NextColumn();
+				ImGui::Text("%.2f", megabytes(o.second)); ImGui::NextColumn();
+			}
+		}
+		ImGui::Columns(1);
+
+		// every allocation, largest first
+		ImGui::Checkbox("Show allocations", &m_show_allocations);
+		if (!m_show_allocations) return;
+		std::vector<const allocation *> sorted;
+		for (auto &p : m_allocations) sorted.push_back(&p.second);
+		std::sort(sorted.begin(), sorted.end(), [](const allocation *a, const allocation *b) { return a->bytes > b->bytes; });
+		ImGui::Columns(4, "gpu_allocations");
+		ImGui::Text("Owner"); ImGui::NextColumn();
+		ImGui::Text("Format"); ImGui::NextColumn();
+		ImGui::Text("Size"); ImGui::NextColumn();
+		ImGui::Text("KB"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (const allocation *a : sorted) {
+			ImGui::Text("%s %u", a->owner, a->name); ImGui::NextColumn();
+			ImGui::Text("%s", format_name(a->format)); ImGui::NextColumn();
+			if (a->kind == gpu_resource::buffer) ImGui::Text("-");
+			else ImGui::Text("%dx%d, %d mips", a->width, a->height, a->levels);
+			ImGui::NextColumn();
+			ImGui::Text("%.1f", a->bytes / 1024.0); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+// only needs the GL types and functions, not all of opengl.hpp
+#include <GL/glew.h>
+
+
+namespace cgra {
+
+	enum class gpu_resource { buffer, texture, renderbuffer };
+
+
+	// Accounts for the GPU memory of every buffer, texture and renderbuffer.
+	// Storage should be allocated and deleted through this object (the
+	// allocation calls act on the object currently bound, like the GL calls
+	// they wrap), so that the sizes are known. Sizes are estimates: drivers
+	// pad, compress and keep extra copies. Main thread only.
+	//
+	// Over budget, update() warns once and (if enabled) calls the evictor,
+	// which the application points at asset_cache::evict.
+	class gpu_memory {
+	public:
+		struct allocation {
+			gpu_resource kind;
+			GLuint name;
+			size_t bytes = 0;
+			GLenum format = 0;          // internal format, 0 for buffers
+			GLsizei width = 0;          // texels, 0 for buffers
+			GLsizei height = 0;
+			int levels = 1;             // mip levels
+			const char *owner = "";     // tag, a string literal
+		};
+
+		// frees at least the given bytes if it can, returns the bytes freed
+		using evictor_t = std::function<size_t(size_t bytes)>;
+
+	private:
+		std::unordered_map<uint64_t, allocation> m_allocations;
+		size_t m_totals[3] = { 0, 0, 0 };
+		size_t m_peak = 0;
+
+		size_t m_budget = size_t(512) << 20;
+		bool m_evict = true;
+		bool m_over = false;
+		evictor_t m_evictor;
+
+		// GUI state
+		bool m_show_allocations = false;
+
+		gpu_memory() { }
+
+		static uint64_t key(gpu_resource kind, GLuint name) { return (uint64_t(kind) << 32) | name; }
+		void record(const allocation &a);
+		void release(gpu_resource kind, GLsizei n, const GLuint *names);
+
+	public:
+		gpu_memory(const gpu_memory &) = delete;
+		gpu_memory & operator=(const gpu_memory &) = delete;
+
+		static gpu_memory & current();
+
+		// bytes per texel of an internal format (an estimate for packed and unknown formats)
+		static size_t texel_bytes(GLenum internal_format);
+
+		// glBufferData on the buffer bound to target
+		void buffer_data(GLenum target, GLuint buffer, GLsizeiptr size, const void *data, GLenum usage, const char *owner);
+
+		// glTexImage2D of level 0 on the texture bound to GL_TEXTURE_2D,
+		// with room for the full mip chain if mipmaps is true
+		void tex_image_2d(GLuint texture, GLenum internal_format, GLsizei width, GLsizei height,
+			GLenum format, GLenum type, const void *pixels, bool mipmaps, const char *owner);
+
+		// glRenderbufferStorage on the bound renderbuffer
+		void renderbuffer_storage(GLuint renderbuffer, GLenum internal_format, GLsizei width, GLsizei height, const char *owner);
+
+		// the glDelete* functions, and they forget the objects (also usable as gl_object destroyers)
+		static void GLAPIENTRY delete_buffers(GLsizei n, const GLuint *buffers);
+		static void GLAPIENTRY delete_textures(GLsizei n, const GLuint *textures);
+		static void GLAPIENTRY delete_renderbuffers(GLsizei n, const GLuint *renderbuffers);
+
+		size_t total() const { return m_totals[0] + m_totals[1] + m_totals[2]; }
+		size_t total(gpu_resource kind) const { return m_totals[size_t(kind)]; }
+		size_t peak() const { return m_peak; }
+		size_t count() const { return m_allocations.size(); }
+
+		// recorded size of an object, 0 if it has no storage
+		size_t bytes(gpu_resource kind, GLuint name) const {
+			auto it = m_allocations.find(key(kind, name));
+			return it == m_allocations.end() ? 0 : it->second.bytes;
+		}
+		const std::unordered_map<uint64_t, allocation> & allocations() const { return m_allocations; }
+
+		size_t budget() const { return m_budget; }
+		void budget(size_t bytes) { m_budget = bytes; }
+		bool evict_over_budget() const { return m_evict; }
+		void evict_over_budget(bool e) { m_evict = e; }
+		void evictor(evictor_t f) { m_evictor = std::move(f); }
+
+		// checks the budget, call once per frame
+		void update();
+
+		// totals by category and owner, budget and allocation list inside the current ImGui window
+		void render_gui();
+	};
+}
@@ -0,0 +1,207 @@
+
+// std
+#include <algorithm>
+#include <cstdio>
+
+// project
+#include "cgra_gpu_profiler.hpp"
+#include "cgra_gui.hpp"
+
+
+namespace cgra {
+
+	float gpu_profiler::scope_stats::average() const {
+		float sum = 0;
+		size_t n = 0;
+		for (size_t i = 0; i < history_size; i++) {
+			if (!recorded[i]) continue;
+			sum += history[i];
+			n++;
+		}
+		return n ? sum / n : 0;
+	}
+
+
+	float gpu_profiler::scope_stats::maximum() const {
+		return *std::max_element(history.begin(), history.end());
+	}
+
+
+	gpu_profiler & gpu_profiler::current() {
+		static gpu_profiler profiler;
+		return profiler;
+	}
+
+
+	GLuint gpu_profiler::acquire() {
+		if (m_pool.empty()) {
+			// grow in batches so we rarely call into the driver
+			m_pool.resize(64);
+			glGenQueries(GLsizei(m_pool.size()), m_pool.data());
+		}
+		GLuint q = m_pool.back();
+		m_pool.pop_back();
+		return q;
+	}
+
+
+	void gpu_profiler::release(frame &f) {
+		for (auto &e : f.events) {
+			m_pool.push_back(e.begin);
+			m_pool.push_back(e.end);
+		}
+		f.events.clear();
+		f.pending = false;
+	}
+
+
+	bool gpu_profiler::collect(frame &f) {
+		if (f.events.empty()) {
+			f.pending = false;
+			return true;
+		}
+
+		// timestamps complete in order, so if the last query
+		// is available then all of them are
+		GLint available = 0;
+		glGetQueryObjectiv(f.events.front().end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return false;
+
+		// rebuild paths to match nested scopes
+		std::vector<std::string> path;
+		for (auto &e : f.events) {
+			GLuint64 t0 = 0, t1 = 0;
+			glGetQueryObjectui64v(e.begin, GL_QUERY_RESULT, &t0);
+			glGetQueryObjectui64v(e.end, GL_QUERY_RESULT, &t1);
+
+			path.resize(e.depth);
+			std::string p = path.empty() ? e.name : path.back() + "/" + e.name;
+			path.push_back(p);
+
+			auto it = m_stats_index.find(p);
+			if (it == m_stats_index.end()) {
+				it = m_stats_index.emplace(p, m_stats.size()).first;
+				m_stats.emplace_back();
+				m_stats.back().path = p;
+				m_stats.back().name = e.name;
+				m_stats.back().depth = e.depth;
+			}
+
+			// scopes entered more than once in a frame are summed
+			scope_stats &s = m_stats[it->second];
+			float ms = float(double(t1 - t0) * 1e-6);
+			if (e.depth == 0) {
+				m_history_index = (m_history_index + 1) % history_size;
+				for (auto &other : m_stats) {
+					other.history[m_history_index] = 0;
+					other.recorded[m_history_index] = false;
+				}
+			}
+			s.history[m_history_index] += ms;
+			s.recorded[m_history_index] = true;
+			s.samples++;
+		}
+
+		release(f);
+		return true;
+	}
+
+
+	void gpu_profiler::begin_frame() {
+#ifndef CGRA_NO_GPU_PROFILER
+		if (!m_enabled) return;
+
+		// read back every finished frame, oldest first
+		for (size_t i = 1; i < frame_latency; i++) {
+			frame &f = m_frames[(m_frame_index + i) % frame_latency];
+			if (f.pending) collect(f);
+		}
+
+		// never wait on the slot we need, drop it instead
+		frame &f = current_frame();
+		if (f.pending && !collect(f)) {
+			release(f);
+			m_dropped++;
+		}
+
+		m_in_frame = true;
+		push("frame");
+#endif
+	}
+
+
+	void gpu_profiler::end_frame() {
+#ifndef CGRA_NO_GPU_PROFILER
+		if (!m_in_frame) return;
+
+		// close any scopes left open
+		while (!m_open.empty()) pop();
+
+		current_frame().pending = true;
+		m_in_frame = false;
+		m_frame_index++;
+#endif
+	}
+
+
+	void gpu_profiler::push(const char *name) {
+		if (!m_in_frame) return;
+		event e;
+		e.name = name;
+		e.depth = int(m_open.size());
+		e.begin = acquire();
+		e.end = acquire();
+		glQueryCounter(e.begin, GL_TIMESTAMP);
+		m_open.push_back(current_frame().events.size());
+		current_frame().events.push_back(e);
+	}
+
+
+	void gpu_profiler::pop() {
+		if (!m_in_frame || m_open.empty()) return;
+		glQueryCounter(current_frame().events[m_open.back()].end, GL_TIMESTAMP);
+		m_open.pop_back();
+	}
+
+
+	void gpu_profiler::shutdown() {
+		for (auto &f : m_frames) release(f);
+		if (!m_pool.empty()) glDeleteQueries(GLsizei(m_pool.size()), m_pool.data());
+		m_pool.clear();
+		m_open.clear();
+		m_in_frame = false;
+	}
+
+
+	void gpu_profiler::render_gui() {
+#ifndef CGRA_NO_GPU_PROFILER
+		if (!ImGui::CollapsingHeader("GPU Profiler")) return;
+
+		ImGui::Checkbox("Enabled", &m_enabled);
+		ImGui::SameLine();
+		ImGui::Text("(%zu frames dropped)", m_dropped);
+		if (m_stats.empty()) return;
+
+		// frame time graph, oldest to newest
+		const scope_stats &root = m_stats.front();
+		int offset = int((m_history_index + 1) % history_size);
+		char overlay[32];
+		std::snprintf(overlay, sizeof(overlay), "avg %.3f ms", root.average());
+		ImGui::PlotLines("##gpu_frame", root.history.data(), int(history_size), offset, overlay, 0.f, std::max(root.maximum(), 1.f), ImVec2(0, 60));
+
+		// per scope table
+		ImGui::Columns(3, "gpu_scopes");
+		ImGui::Text("Scope"); ImGui::NextColumn();
+		ImGui::Text("Avg ms"); ImGui::NextColumn();
+		ImGui::Text("Max ms"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (auto &s : m_stats) {
+			ImGui::Text("%*s%s", s.depth * 2, "", s.name.c_str()); ImGui::NextColumn();
+			ImGui::Text("%.3f", s.average()); ImGui::NextColumn();
+			ImGui::Text("%.3f", s.maximum()); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+#endif
+	}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// std
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// project
+#include <opengl.hpp>
+
+
+// Times a GPU scope (until the end of the enclosing block)
+// Define CGRA_NO_GPU_PROFILER to compile all scopes out
+#ifndef CGRA_NO_GPU_PROFILER
+#define CGRA_GPU_SCOPE_CAT_IMPL(a, b) a##b
+#define CGRA_GPU_SCOPE_CAT(a, b) CGRA_GPU_SCOPE_CAT_IMPL(a, b)
+#define CGRA_GPU_SCOPE(name) ::cgra::gpu_scope CGRA_GPU_SCOPE_CAT(cgra_gpu_scope_, __LINE__)(name)
+#else
+#define CGRA_GPU_SCOPE(name)
+#endif
+
+
+namespace cgra {
+
+	// GPU profiler using GL_TIMESTAMP queries (so scopes can nest).
+	// Queries come from a pool and are only read back once available,
+	// usually 2-3 frames later, so the profiler never stalls the pipeline.
+	// Frames whose results still aren't available when their slot is
+	// needed again are dropped rather than waited on.
+	class gpu_profiler {
+	public:
+		static constexpr size_t frame_latency = 4;
+		static constexpr size_t history_size = 120;
+
+		struct scope_stats {
+			std::string path;
+			std::string name;
+			int depth = 0;
+			std::array<float, history_size> history { }; // milliseconds
+			std::array<bool, history_size> recorded { }; // history entries of frames the scope ran in
+			size_t samples = 0;
+			// over the frames in the history that the scope ran in
+			float average() const;
+			float maximum() const;
+		};
+
+	private:
+		struct event {
+			const char *name;
+			int depth;
+			GLuint begin;
+			GLuint end;
+		};
+
+		struct frame {
+			std::vector<event> events;
+			bool pending = false;
+		};
+
+		bool m_enabled = true;
+		bool m_in_frame = false;
+		std::array<frame, frame_latency> m_frames;
+		size_t m_frame_index = 0;
+		std::vector<size_t> m_open;
+		std::vector<GLuint> m_pool;
+		size_t m_dropped = 0;
+
+		std::vector<scope_stats> m_stats;
+		std::unordered_map<std::string, size_t> m_stats_index;
+		size_t m_history_index = 0;
+
+		GLuint acquire();
+		void release(frame &f);
+		bool collect(frame &f);
+		frame & current_frame() { return m_frames[m_frame_index % frame_latency]; }
+
+	public:
+		gpu_profiler() { }
+		gpu_profiler(const gpu_profiler &) = delete;
+		gpu_profiler & operator=(const gpu_profiler &) = delete;
+
+		// profiler for the current context (we only use one)
+		static gpu_profiler & current();
+
+		bool enabled() const { return m_enabled; }
+		void enabled(bool e) { m_enabled = e; }
+
+		// reads back finished frames and opens the root "frame" scope
+		void begin_frame();
+		// closes the root scope
+		void end_frame();
+
+		void push(const char *name);
+		void pop();
+
+		const std::vector<scope_stats> & stats() const { return m_stats; }
+		size_t dropped_frames() const { return m_dropped; }
+
+		// deletes every query, call before the context is destroyed
+		void shutdown();
+
+		// per-scope table and frame time graph inside the current ImGui window
+		void render_gui();
+	};
+
+
+	// RAII helper for gpu_profiler push/pop, use CGRA_GPU_SCOPE
+	class gpu_scope {
+	public:
+		explicit gpu_scope(const char *name) { gpu_profiler::current().push(name); }
+		gpu_scope(const gpu_scope &) = delete;
+		gpu_scope & operator=(const gpu_scope &) = delete;
+		~gpu_scope() { gpu_profiler::current().pop(); }
+	};
+
+}
@@ -14,6 +14,8 @@
 #include <stb_image_write.h>
 
 // project
+#include "cgra_cpu_profiler.hpp"
+#include "cgra_gpu_memory.hpp"
 #include "cgra_math.hpp"
 #include <opengl.hpp>
 
@@ -114,6 +116,7 @@ namespace cgra {
 		image(int w, int h) : m_size(w, h), m_data(m_size.x*m_size.y*N, 0) { }
 
 		image(const std::string &filename) : m_size(-1, -1) {
+			CGRA_ZONE("image load");
 			// vertical flipping
 			stbi_set_flip_vertically_on_load(true);
 			int w, h, n;
@@ -193,17 +196,18 @@ namespace cgra {
 		}
 
 
-		GLuint upload_texture(GLenum format = GL_RGBA8, GLuint tex = 0) const {
+		// owner tags the texture in gpu_memory
+		GLuint upload_texture(GLenum format = GL_RGBA8, GLuint tex = 0, const char *owner = "image") const {
+			CGRA_ZONE("image upload");
 			if (!tex) glGenTextures(1, &tex);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, tex);
+			gl_state::current().bind_texture(0, GL_TEXTURE_2D, tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_wrap.x);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, m_wrap.y);
-			glTexImage2D(
-				GL_TEXTURE_2D, 0, format, m_size.x, m_size.y, 0,
-				detail::gl_image_format<N>::value, detail::gl_type_format<T>::value, m_data.data()
+			gpu_memory::current().tex_image_2d(
+				tex, format, m_size.x, m_size.y,
+				detail::gl_image_format<N>::value, detail::gl_type_format<T>::value, m_data.data(), true, owner
 			);
 			glGenerateMipmap(GL_TEXTURE_2D);
 			return tex;
@@ -246,15 +250,22 @@ namespace cgra {
 			}
 		}
 
+		// creates an image from the given framebuffer (0 for the default framebuffer)
+		static image read_framebuffer(GLuint fbo, int w, int h) {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+			image img(w, h);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, w, h, detail::gl_image_format<N>::value, detail::gl_type_format<T>::value, img.data());
+			return img;
+		}
+
 		// creates an image from FB 0
 		static image screenshot(bool write) {
 			using namespace std;
 			int w, h;
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 			glfwGetFramebufferSize(glfwGetCurrentContext(), &w, &h);
 
-			image img(w, h);
-			glReadPixels(0, 0, w, h, detail::gl_image_format<N>::value, detail::gl_type_format<T>::value, img.data());
+			image img = read_framebuffer(0, w, h);
 
 			if (write) {
 				ostringstream filename_ss;
@@ -0,0 +1,283 @@
+
+// std
+#include <cassert>
+#include <random>
+
+// project
+#include "cgra_jobs.hpp"
+
+
+namespace {
+
+	// the system the calling thread belongs to, and the index of its deque
+	// (-1 for threads without one)
+	thread_local cgra::job_system *t_system = nullptr;
+	thread_local int t_queue = -1;
+
+	void lock_job(cgra::detail::job *j) {
+		while (j->lock.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+	}
+
+	void unlock_job(cgra::detail::job *j) {
+		j->lock.clear(std::memory_order_release);
+	}
+
+	// jobs freed by this thread, reused before going to the allocator
+	// (the alive flag covers releases during thread exit)
+	constexpr size_t max_cached_jobs = 4096;
+
+	struct job_cache {
+		std::vector<cgra::detail::job *> jobs;
+		~job_cache() {
+			for (cgra::detail::job *j : jobs) delete j;
+			alive = false;
+		}
+		static thread_local bool alive;
+	};
+
+	thread_local bool job_cache::alive = true;
+	thread_local job_cache t_cache;
+}
+
+
+namespace cgra {
+
+	namespace detail {
+
+		void job_acquire(job *j) {
+			j->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void job_release(job *j) {
+			if (j->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+			// destroys the function of a job that was never submitted
+			if (!j->ran) j->invoke(*j, false);
+			if (job_cache::alive && t_cache.jobs.size() < max_cached_jobs) {
+				t_cache.jobs.push_back(j);
+			} else {
+				delete j;
+			}
+		}
+	}
+
+	using detail::job;
+
+
+	job_system & job_system::current() {
+		static job_system system;
+		return system;
+	}
+
+
+	unsigned job_system::default_workers() {
+		const unsigned threads = std::thread::hardware_concurrency();
+		return threads > 2 ? threads - 1 : 1;
+	}
+
+
+	job_system::job_system(unsigned workers) : m_previous_system(t_system), m_previous_queue(t_queue) {
+		for (unsigned i = 0; i <= workers; i++) m_deques.push_back(std::make_unique<detail::work_deque>());
+		t_system = this;
+		t_queue = 0;
+		for (unsigned i = 1; i <= workers; i++) m_threads.emplace_back([this, i]() { worker(int(i)); });
+	}
+
+
+	job_system::~job_system() {
+		{
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto &t : m_threads) t.join();
+		t_system = m_previous_system;
+		t_queue = m_previous_queue;
+	}
+
+
+	bool job_system::is_main_thread() const {
+		return t_system == this && t_queue == 0;
+	}
+
+
+	job * job_system::allocate(job *parent, bool main_thread) {
+		job *j;
+		if (job_cache::alive && !t_cache.jobs.empty()) {
+			j = t_cache.jobs.back();
+			t_cache.jobs.pop_back();
+			j->unfinished.store(1, std::memory_order_relaxed);
+			j->blockers.store(1, std::memory_order_relaxed);
+			j->ran = false;
+			j->finished = false;
+		} else {
+			j = new job;
+		}
+		j->main_thread = main_thread;
+		j->parent = parent;
+		if (parent) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+		return j;
+	}
+
+
+	void job_system::depends(const job_handle &j, const job_handle &dependency) {
+		job *d = dependency.m_job;
+		if (!d) return;
+		lock_job(d);
+		if (!d->finished) {
+			// released once the dependency finishes
+			detail::job_acquire(j.m_job);
+			j.m_job->blockers.fetch_add(1, std::memory_order_relaxed);
+			d->continuations.push_back(j.m_job);
+		}
+		unlock_job(d);
+	}
+
+
+	void job_system::submit(job *j) {
+		// the scheduler's reference, released once the job is done
+		detail::job_acquire(j);
+		unblock(j);
+	}
+
+
+	void job_system::unblock(job *j) {
+		if (j->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(j);
+	}
+
+
+	void job_system::enqueue(job *j) {
+		if (j->main_thread) {
+			std::lock_guard<std::mutex> lock(m_main_mutex);
+			m_main.push_back(j);
+			m_main_size.fetch_add(1, std::memory_order_release);
+			return;
+		}
+
+		if (t_system != this || t_queue < 0 || !m_deques[t_queue]->push(j)) {
+			// not one of our threads, or its deque is full
+			std::lock_guard<std::mutex> lock(m_shared_mutex);
+			m_shared.push_back(j);
+			m_shared_size.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// wake a sleeping worker (see worker for the other half)
+		m_queued.fetch_add(1, std::memory_order_seq_cst);
+		if (m_sleeping.load(std::memory_order_seq_cst) > 0) {
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_wake.notify_one();
+		}
+	}
+
+
+	void job_system::finish(job *j) {
+		while (j) {
+			if (j->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+			// done, start anything that was waiting on it
+			lock_job(j);
+			j->finished = true;
+			std::vector<job *> continuations = std::move(j->continuations);
+			unlock_job(j);
+			for (job *c : continuations) {
+				unblock(c);
+				detail::job_release(c);
+			}
+
+			// then the parent may be done too
+			job *parent = j->parent;
+			detail::job_release(j);
+			j = parent;
+		}
+	}
+
+
+	void job_system::execute(job *j) {
+		j->invoke(*j, true);
+		j->ran = true;
+		finish(j);
+	}
+
+
+	job * job_system::find_job(int queue) {
+		// own deque first
+		if (queue >= 0) {
+			if (job *j = m_deques[queue]->pop()) {
+				m_queued.fetch_sub(1, std::memory_order_relaxed);
+				return j;
+			}
+		}
+
+		// then anything submitted from other threads
+		if (m_shared_size.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(m_shared_mutex);
+			if (!m_shared.empty()) {
+				job *j = m_shared.front();
+				m_shared.pop_front();
+				m_shared_size.fetch_sub(1, std::memory_order_relaxed);
+				m_queued.fetch_sub(1, std::memory_order_relaxed);
+				return j;
+			}
+		}
+
+		// then steal, starting from a random victim
+		thread_local std::minstd_rand rng(std::random_device{}());
+		const size_t n = m_deques.size();
+		const size_t first = rng() % n;
+		for (size_t k = 0; k < n; k++) {
+			const size_t victim = (first + k) % n;
+			if (int(victim) == queue) continue;
+			if (job *j = m_deques[victim]->steal()) {
+				m_queued.fetch_sub(1, std::memory_order_relaxed);
+				return j;
+			}
+		}
+		return nullptr;
+	}
+
+
+	void job_system::worker(int queue) {
+		t_system = this;
+		t_queue = queue;
+		while (true) {
+			if (job *j = find_job(queue)) {
+				execute(j);
+				continue;
+			}
+
+			// sleep until something is queued (see enqueue for the other half)
+			std::unique_lock<std::mutex> lock(m_sleep_mutex);
+			if (m_stop) return;
+			m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+			m_wake.wait(lock, [this]() { return m_stop || m_queued.load(std::memory_order_seq_cst) > 0; });
+			m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+
+	void job_system::wait(const job_handle &h) {
+		const bool main = is_main_thread();
+		const int queue = t_system == this ? t_queue : -1;
+		while (!h.done()) {
+			if (main && run_main_jobs()) continue;
+			if (job *j = find_job(queue)) {
+				execute(j);
+				continue;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+
+	size_t job_system::run_main_jobs() {
+		assert(is_main_thread());
+		if (m_main_size.load(std::memory_order_acquire) == 0) return 0;
+		std::vector<job *> jobs;
+		{
+			std::lock_guard<std::mutex> lock(m_main_mutex);
+			jobs.swap(m_main);
+			m_main_size.store(0, std::memory_order_relaxed);
+		}
+		for (job *j : jobs) execute(j);
+		return jobs.size();
+	}
+}
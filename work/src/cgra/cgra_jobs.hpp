@@ -0,0 +1,323 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace cgra {
+
+	namespace detail {
+
+		struct job {
+			// runs (if run is true) and then destroys the stored function
+			void (*invoke)(job &j, bool run) = nullptr;
+			alignas(std::max_align_t) unsigned char storage[64];
+
+			std::atomic<int> refs{ 0 };       // handles, dependencies and the scheduler while submitted
+			std::atomic<int> unfinished{ 1 }; // itself and its unfinished children
+			std::atomic<int> blockers{ 1 };   // unfinished dependencies, plus one until submitted
+			job *parent = nullptr;
+			bool main_thread = false;
+			bool ran = false;
+
+			// jobs waiting on this one, guarded by lock
+			std::atomic_flag lock = ATOMIC_FLAG_INIT;
+			bool finished = false;
+			std::vector<job *> continuations;
+		};
+
+		void job_acquire(job *j);
+		void job_release(job *j);
+
+
+		// Chase-Lev work-stealing deque with a fixed capacity. The owning
+		// thread pushes and pops at the bottom, other threads steal from the
+		// top. See Le et al., "Correct and Efficient Work-Stealing for Weak
+		// Memory Models" (PPoPP 2013).
+		class work_deque {
+		public:
+			static constexpr int64_t capacity = 1 << 13;
+
+		private:
+			alignas(64) std::atomic<int64_t> m_top{ 0 };
+			alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+			std::unique_ptr<std::atomic<job *>[]> m_buffer{ new std::atomic<job *>[capacity] };
+
+		public:
+			// owner only, returns false if the deque is full
+			bool push(job *j) {
+				const int64_t b = m_bottom.load(std::memory_order_relaxed);
+				const int64_t t = m_top.load(std::memory_order_acquire);
+				if (b - t >= capacity) return false;
+				m_buffer[b & (capacity - 1)].store(j, std::memory_order_relaxed);
+				m_bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			// owner only, newest first
+			job * pop() {
+				const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = m_top.load(std::memory_order_relaxed);
+				if (t > b) {
+					m_bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				job *j = m_buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+				if (t == b) {
+					// last one, race the thieves for it
+					if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) j = nullptr;
+					m_bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return j;
+			}
+
+			// any thread, oldest first
+			job * steal() {
+				int64_t t = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const int64_t b = m_bottom.load(std::memory_order_acquire);
+				if (t >= b) return nullptr;
+				job *j = m_buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+				if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+				return j;
+			}
+		};
+	}
+
+
+	// Reference counted handle to a job. A job is done once it, and every
+	// job created with it as the parent, has run.
+	class job_handle {
+	private:
+		friend class job_system;
+		detail::job *m_job = nullptr;
+
+		explicit job_handle(detail::job *j) : m_job(j) { detail::job_acquire(j); }
+
+	public:
+		job_handle() { }
+		job_handle(const job_handle &other) : m_job(other.m_job) { if (m_job) detail::job_acquire(m_job); }
+		job_handle(job_handle &&other) noexcept : m_job(other.m_job) { other.m_job = nullptr; }
+
+		job_handle & operator=(job_handle other) noexcept {
+			std::swap(m_job, other.m_job);
+			return *this;
+		}
+
+		~job_handle() { reset(); }
+
+		void reset() {
+			if (m_job) detail::job_release(m_job);
+			m_job = nullptr;
+		}
+
+		bool empty() const { return !m_job; }
+		bool done() const { return !m_job || m_job->unfinished.load(std::memory_order_acquire) == 0; }
+	};
+
+
+	// Work-stealing job scheduler. Each worker thread (and the main thread)
+	// has a Chase-Lev deque: jobs submitted from a worker go on its own deque
+	// and are run newest first, and idle workers steal the oldest jobs from
+	// the others. Jobs submitted from any other thread go on a shared queue.
+	//
+	// Jobs can depend on other jobs (see depends and then), and jobs created
+	// with a parent are part of it for wait and done. Jobs created with
+	// create_main only ever run on the main thread, in run_main_jobs or
+	// while the main thread waits, which is the place for GL calls.
+	//
+	// Jobs must not throw. Every created job must be submitted, or its parent
+	// and anything depending on it will never finish.
+	class job_system {
+	private:
+		std::vector<std::unique_ptr<detail::work_deque>> m_deques; // [0] is the main thread's
+		std::vector<std::thread> m_threads;
+
+		std::mutex m_shared_mutex;
+		std::deque<detail::job *> m_shared;
+		std::atomic<size_t> m_shared_size{ 0 };
+
+		std::mutex m_main_mutex;
+		std::vector<detail::job *> m_main;
+		std::atomic<size_t> m_main_size{ 0 };
+
+		// sleeping workers
+		std::mutex m_sleep_mutex;
+		std::condition_variable m_wake;
+		std::atomic<int64_t> m_queued{ 0 };
+		std::atomic<int> m_sleeping{ 0 };
+		bool m_stop = false;
+
+		// the system and deque of the calling thread, restored when this system is destroyed
+		job_system *m_previous_system;
+		int m_previous_queue;
+
+		detail::job * allocate(detail::job *parent, bool main_thread);
+		void submit(detail::job *j);
+		void enqueue(detail::job *j);
+		void unblock(detail::job *j);
+		void finish(detail::job *j);
+		void execute(detail::job *j);
+		detail::job * find_job(int queue);
+		void worker(int queue);
+
+		template <typename F>
+		static void store(detail::job *j, F &&f) {
+			using fn_t = std::decay_t<F>;
+			if constexpr (sizeof(fn_t) <= sizeof(j->storage) && alignof(fn_t) <= alignof(std::max_align_t)) {
+				new (j->storage) fn_t(std::forward<F>(f));
+				j->invoke = [](detail::job &j, bool run) {
+					fn_t &fn = *std::launder(reinterpret_cast<fn_t *>(j.storage));
+					if (run) fn();
+					fn.~fn_t();
+				};
+			} else {
+				// too big to store inline
+				*reinterpret_cast<fn_t **>(j->storage) = new fn_t(std::forward<F>(f));
+				j->invoke = [](detail::job &j, bool run) {
+					fn_t *fn = *reinterpret_cast<fn_t **>(j.storage);
+					if (run) (*fn)();
+					delete fn;
+				};
+			}
+		}
+
+		// runs f over [begin, end) as a child of parent, splitting off the
+		// upper half as another job until the range is at most grain
+		template <typename F>
+		void spawn_range(detail::job *parent, size_t begin, size_t end, size_t grain, const F *f) {
+			detail::job *j = allocate(parent, false);
+			store(j, [this, parent, begin, end, grain, f]() {
+				size_t e = end;
+				while (e - begin > grain) {
+					const size_t mid = begin + (e - begin) / 2;
+					spawn_range(parent, mid, e, grain, f);
+					e = mid;
+				}
+				(*f)(begin, e);
+			});
+			submit(j);
+		}
+
+	public:
+		// the system used by parallel_for, created on first use
+		// (which should be on the main thread)
+		static job_system & current();
+
+		// one less than the number of hardware threads, but at least one
+		static unsigned default_workers();
+
+		// the calling thread becomes this system's main thread
+		explicit job_system(unsigned workers = default_workers());
+		~job_system();
+
+		job_system(const job_system &) = delete;
+		job_system & operator=(const job_system &) = delete;
+
+		unsigned workers() const { return unsigned(m_threads.size()); }
+		bool is_main_thread() const;
+
+		// creates a job that runs f() once it is submitted and its
+		// dependencies are done. The parent (if any) is not done until this
+		// job is, and must not have been submitted yet or must still be running.
+		template <typename F>
+		job_handle create(F &&f, job_handle parent = job_handle()) {
+			detail::job *j = allocate(parent.m_job, false);
+			store(j, std::forward<F>(f));
+			return job_handle(j);
+		}
+
+		// as create, but f only runs on the main thread
+		template <typename F>
+		job_handle create_main(F &&f) {
+			detail::job *j = allocate(nullptr, true);
+			store(j, std::forward<F>(f));
+			return job_handle(j);
+		}
+
+		// j will not start until dependency is done, call before submitting j
+		void depends(const job_handle &j, const job_handle &dependency);
+
+		void submit(const job_handle &j) { submit(j.m_job); }
+
+		// creates and submits a job
+		template <typename F>
+		job_handle run(F &&f) {
+			job_handle j = create(std::forward<F>(f));
+			submit(j);
+			return j;
+		}
+
+		// creates and submits a main thread job
+		template <typename F>
+		job_handle run_main(F &&f) {
+			job_handle j = create_main(std::forward<F>(f));
+			submit(j);
+			return j;
+		}
+
+		// creates and submits a job that runs after dependency is done
+		template <typename F>
+		job_handle then(const job_handle &dependency, F &&f) {
+			job_handle j = create(std::forward<F>(f));
+			depends(j, dependency);
+			submit(j);
+			return j;
+		}
+
+		// as then, but f runs on the main thread
+		template <typename F>
+		job_handle then_main(const job_handle &dependency, F &&f) {
+			job_handle j = create_main(std::forward<F>(f));
+			depends(j, dependency);
+			submit(j);
+			return j;
+		}
+
+		// runs other jobs until j is done. A worker must not wait on a main
+		// thread job while the main thread is waiting on that worker
+		void wait(const job_handle &j);
+
+		// runs the main thread jobs that are ready, call once per frame on the
+		// main thread, returns how many ran
+		size_t run_main_jobs();
+
+		// calls f(b, e) for subranges [b, e) of [begin, end) no larger than
+		// grain (when non-zero), in parallel, and returns when all are done.
+		// With grain zero, the range is split into a few pieces per thread
+		template <typename F>
+		void parallel_for(size_t begin, size_t end, size_t grain, const F &f) {
+			if (begin >= end) return;
+			if (!grain) grain = std::max<size_t>(1, (end - begin) / (4 * (workers() + 1)));
+			if (end - begin <= grain || m_threads.empty()) {
+				f(begin, end);
+				return;
+			}
+			job_handle root = create([]() { });
+			spawn_range(root.m_job, begin, end, grain, &f);
+			submit(root);
+			wait(root);
+		}
+	};
+
+
+	// job_system::current().parallel_for(begin, end, grain, f)
+	template <typename F>
+	inline void parallel_for(size_t begin, size_t end, size_t grain, const F &f) {
+		job_system::current().parallel_for(begin, end, grain, f);
+	}
+}
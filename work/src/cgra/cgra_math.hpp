@@ -48,6 +48,8 @@
 #include <cassert>
 #include <cmath>
 #include <climits>
+#include <cstdint>
+#include <cstring>
 
 #include <algorithm>
 #include <array>
@@ -58,6 +60,7 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <exception>
@@ -89,6 +92,39 @@
 #define CGRA_CONSTEXPR_FUNCTION constexpr
 #endif
 
+// detects constant evaluation (the C++20 std::is_constant_evaluated) so the SIMD
+// operators can use the generic code at compile time and intrinsics at runtime;
+// without it, the float vec4 and mat4 operators are not constexpr unless CGRA_NO_SIMD
+#if defined(__has_builtin) && !defined(CGRA_IS_CONSTANT_EVALUATED)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define CGRA_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#if !defined(CGRA_IS_CONSTANT_EVALUATED) && ((defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925))
+#define CGRA_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#ifdef CGRA_IS_CONSTANT_EVALUATED
+#define CGRA_HAVE_IS_CONSTANT_EVALUATED
+#else
+#define CGRA_IS_CONSTANT_EVALUATED() false
+#endif
+
+// SIMD paths for float vec4 and mat4 operators, picked from the instruction
+// sets the compiler is targeting (-msse2, -msse4.1, -mavx or /arch:AVX)
+// define CGRA_NO_SIMD to always use the generic implementations
+#if !defined(CGRA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CGRA_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define CGRA_SIMD_SSE41
+#include <smmintrin.h>
+#endif
+#if defined(__AVX__)
+#define CGRA_SIMD_AVX
+#include <immintrin.h>
+#endif
+#endif
+
 // we may need these macros to define ctors that intellisense can constexpr-eval
 
 // normal magic ctor definition is dragged in from base class
@@ -1364,6 +1400,15 @@ namespace cgra {
 			}
 		};
 
+		// alignment of vector data storage
+		// float vec4 (and so mat4 columns) are aligned for SIMD loads and stores,
+		// independent of CGRA_NO_SIMD so the layout doesn't depend on compiler flags
+		template <typename T, size_t N>
+		struct vec_data_align : std::integral_constant<size_t, alignof(T)> {};
+
+		template <>
+		struct vec_data_align<float, 4> : std::integral_constant<size_t, 16> {};
+
 		// base type for vector data storage
 		// specializations must be default constructible, copyable, movable and destructible;
 		// this means care must be taken to handle unions correctly.
@@ -1568,7 +1613,7 @@ namespace cgra {
 		};
 
 		template <typename T, typename X>
-		class basic_vec_data<T, 4, X> {
+		class alignas(vec_data_align<T, 4>::value) basic_vec_data<T, 4, X> {
 		public:
 			union { T x, r, s; };
 			union { T y, g, t; };
@@ -1776,7 +1821,7 @@ namespace cgra {
 		};
 
 		template <typename T>
-		class basic_vec_data<T, 4, std::enable_if_t<std::is_trivially_destructible<T>::value>> {
+		class alignas(vec_data_align<T, 4>::value) basic_vec_data<T, 4, std::enable_if_t<std::is_trivially_destructible<T>::value>> {
 		public:
 			union {
 				simple_array<T, 4> m_data;
@@ -2811,13 +2856,13 @@ namespace cgra {
 
 				// scalar any; returns conversion to bool
 				template <typename T, enable_if_want_bool_fns_t<T> = 0>
-				inline auto any(const T &x) {
+				CGRA_CONSTEXPR_FUNCTION auto any(const T &x) {
 					return bool(x);
 				}
 
 				// scalar all; returns conversion to bool
 				template <typename T, enable_if_want_bool_fns_t<T> = 0>
-				inline auto all(const T &x) {
+				CGRA_CONSTEXPR_FUNCTION auto all(const T &x) {
 					return bool(x);
 				}
 
@@ -2855,54 +2900,54 @@ namespace cgra {
 
 				// sum of all x in v, i.e., v[0] + v[1] + ...
 				template <typename VecT, typename = enable_if_array_t<VecT>>
-				inline auto sum(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto sum(const VecT &v) {
 					return fold(detail::op::add(), array_value_t<VecT>{}, v);
 				}
 
 				// product of all x in v, i.e., v[0] * v[1] * ...
 				template <typename VecT, typename = enable_if_array_t<VecT>>
-				inline auto product(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto product(const VecT &v) {
 					return fold(detail::op::mul(), array_value_t<VecT>{1}, v);
 				}
 
 				// dot product of v1 and v2, i.e., (v1[0] * v2[0]) + (v1[1] * v2[1]) + ...
 				template <typename VecT1, typename VecT2, typename = enable_if_array_t<VecT1, VecT2>>
-				inline auto dot(const VecT1 &v1, const VecT2 &v2) {
+				CGRA_CONSTEXPR_FUNCTION auto dot(const VecT1 &v1, const VecT2 &v2) {
 					auto vprod = zip_with(detail::op::mul(), v1, v2);
 					return fold(detail::op::add(), array_value_t<decltype(vprod)>{}, std::move(vprod));
 				}
 
 				// true iff any component of v is true; empty => false
 				template <typename VecT, enable_if_array_t<VecT> = 0>
-				inline auto any(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto any(const VecT &v) {
 					using cgra::detail::scalars::any;
 					return fold([](const auto &x1, const auto &x2) { return any(x1) || any(x2); }, false, v);
 				}
 
 				// true iff all components of v are true; empty => true
 				template <typename VecT, enable_if_array_t<VecT> = 0>
-				inline auto all(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto all(const VecT &v) {
 					using cgra::detail::scalars::all;
 					return fold([](const auto &x1, const auto &x2) { return all(x1) && all(x2); }, true, v);
 				}
 
 				// cast array-like to basic_vec<T, N> where T and N are deduced
 				template <typename VecT, enable_if_array_t<VecT> = 0>
-				inline auto vec_cast(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto vec_cast(const VecT &v) {
 					using result_t = typename type_to_vec::template apply<VecT>::type;
 					return result_t{v};
 				}
 
 				// cast array-like to basic_vec<T, N> where N is deduced
 				template <typename T, typename VecT, enable_if_array_t<VecT> = 0>
-				inline auto vec_cast(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto vec_cast(const VecT &v) {
 					using result_t = basic_vec<T, array_size<VecT>::value>;
 					return result_t{v};
 				}
 
 				// cast array-like to basic_vec<T, N> where T is deduced
 				template <size_t N, typename VecT, enable_if_array_t<VecT> = 0>
-				inline auto vec_cast(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto vec_cast(const VecT &v) {
 					using result_t = basic_vec<copy_type_t<array_value_t<VecT>>, N>;
 					return result_t{v};
 				}
@@ -2915,21 +2960,21 @@ namespace cgra {
 
 				// cast array-like to basic_mat<T, Cols, Rows> where T, Cols and Rows are deduced
 				template <typename MatT, enable_if_array_t<MatT> = 0>
-				inline auto mat_cast(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION auto mat_cast(const MatT &m) {
 					using result_t = typename type_to_mat::template apply<MatT>::type;
 					return result_t{m};
 				}
 
 				// cast array-like to basic_mat<T, Cols, Rows> where Cols and Rows are deduced
 				template <typename T, typename MatT, enable_if_array_t<MatT> = 0>
-				inline auto mat_cast(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION auto mat_cast(const MatT &m) {
 					using result_t = basic_mat<T, mat_cols<MatT>::value, mat_rows<MatT>::value>;
 					return result_t{m};
 				}
 
 				// cast array-like to basic_mat<T, Cols, Rows> where T is deduced
 				template <size_t Cols, size_t Rows, typename MatT, enable_if_array_t<MatT> = 0>
-				inline auto mat_cast(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION auto mat_cast(const MatT &m) {
 					using result_t = basic_mat<copy_type_t<matrix_value_t<MatT>>, Cols, Rows>;
 					return result_t{m};
 				}
@@ -3099,387 +3144,387 @@ namespace cgra {
 
 				// vec add_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator+=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator+=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::add_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec add_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator+=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator+=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::add_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec sub_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator-=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator-=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::sub_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec sub_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator-=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator-=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::sub_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec mul_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator*=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator*=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::mul_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec mul_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator*=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator*=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::mul_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec div_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator/=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator/=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::div_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec div_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator/=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator/=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::div_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec remainder (mod) assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator%=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator%=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::mod_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec remainder (mod) assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator%=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator%=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::mod_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec lshift_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator<<=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator<<=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::lshift_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec lshift_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator<<=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator<<=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::lshift_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec rshift_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator>>=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator>>=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::rshift_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec rshift_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator>>=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator>>=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::rshift_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec bitwise_or_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator|=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator|=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::bitwise_or_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec bitwise_or_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator|=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator|=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::bitwise_or_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec bitwise_xor_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator^=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator^=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::bitwise_xor_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec bitwise_xor_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator^=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator^=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::bitwise_xor_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec bitwise_and_assign
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline VecT1 & operator&=(VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT1 & operator&=(VecT1 &lhs, const VecT2 &rhs) {
 					zip_with(detail::op::bitwise_and_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// vec bitwise_and_assign scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline VecT & operator&=(VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION VecT & operator&=(VecT &lhs, const T &rhs) {
 					zip_with(detail::op::bitwise_and_assign(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 					return lhs;
 				}
 
 				// vec negate
 				template <typename VecT, enable_if_vector_t<VecT> = 0>
-				inline auto operator-(const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const VecT &rhs) {
 					return zip_with(detail::op::neg(), rhs);
 				}
 
 				// vec logical_not
 				template <typename VecT, enable_if_vector_t<VecT> = 0>
-				inline auto operator!(const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator!(const VecT &rhs) {
 					return zip_with(detail::op::logical_not(), rhs);
 				}
 
 				// vec bitwise_not
 				template <typename VecT, enable_if_vector_t<VecT> = 0>
-				inline auto operator~(const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator~(const VecT &rhs) {
 					return zip_with(detail::op::bitwise_not(), rhs);
 				}
 
 				// vec add
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator+(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::add(), lhs, rhs);
 				}
 
 				// vec add right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator+(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::add(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec add left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator+(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::add(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec sub
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator-(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::sub(), lhs, rhs);
 				}
 
 				// vec sub right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator-(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::sub(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec sub left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator-(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::sub(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec mul
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator*(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::mul(), lhs, rhs);
 				}
 
 				// vec mul right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator*(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::mul(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec mul left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator*(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::mul(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec div
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator/(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator/(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::div(), lhs, rhs);
 				}
 
 				// vec div right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator/(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator/(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::div(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec div left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator/(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator/(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::div(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec remainder (mod)
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator%(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator%(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::mod(), lhs, rhs);
 				}
 
 				// vec remainder (mod) right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator%(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator%(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::mod(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec remainder (mod) left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator%(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator%(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::mod(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec lshift
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator<<(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator<<(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::lshift(), lhs, rhs);
 				}
 
 				// vec lshift right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator<<(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator<<(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::lshift(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec lshift left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator<<(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator<<(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::lshift(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec rshift
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator >> (const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator >> (const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::rshift(), lhs, rhs);
 				}
 
 				// vec rshift right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator >> (const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator >> (const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::rshift(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec rshift left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator >> (const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator >> (const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::rshift(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec logical_or
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator||(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator||(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::logical_or(), lhs, rhs);
 				}
 
 				// vec logical_or right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator||(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator||(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::logical_or(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec logical_or left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator||(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator||(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::logical_or(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec logical_and
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator&&(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&&(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::logical_and(), lhs, rhs);
 				}
 
 				// vec logical_and right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator&&(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&&(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::logical_and(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec logical_and left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator&&(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&&(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::logical_and(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec bitwise_or
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator|(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator|(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::bitwise_or(), lhs, rhs);
 				}
 
 				// vec bitwise_or right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator|(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator|(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::bitwise_or(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec bitwise_or left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator|(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator|(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::bitwise_or(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec bitwise_xor
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator^(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator^(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::bitwise_xor(), lhs, rhs);
 				}
 
 				// vec bitwise_xor right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator^(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator^(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::bitwise_xor(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec bitwise_xor left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator^(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator^(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::bitwise_xor(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec bitwise_and
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator&(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&(const VecT1 &lhs, const VecT2 &rhs) {
 					return zip_with(detail::op::bitwise_and(), lhs, rhs);
 				}
 
 				// vec bitwise_and right scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator&(const VecT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&(const VecT &lhs, const T &rhs) {
 					return zip_with(detail::op::bitwise_and(), lhs, repeat_vec<T, array_size<VecT>::value>(rhs));
 				}
 
 				// vec bitwise_and left scalar
 				template <typename VecT, typename T, enable_if_vector_scalar_compatible_t<VecT, T> = 0>
-				inline auto operator&(const T &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator&(const T &lhs, const VecT &rhs) {
 					return zip_with(detail::op::bitwise_and(), repeat_vec<T, array_size<VecT>::value>(lhs), rhs);
 				}
 
 				// vec equal
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator==(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator==(const VecT1 &lhs, const VecT2 &rhs) {
 					return fold(detail::op::logical_and(), true, zip_with(detail::op::equal(), lhs, rhs));
 				}
 
 				// vec not-equal
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto operator!=(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator!=(const VecT1 &lhs, const VecT2 &rhs) {
 					return fold(detail::op::logical_or(), false, zip_with(detail::op::not_equal(), lhs, rhs));
 				}
 
@@ -3499,145 +3544,145 @@ namespace cgra {
 
 				// mat add_assign
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline MatT1 & operator+=(MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT1 & operator+=(MatT1 &lhs, const MatT2 &rhs) {
 					zip_with(detail::op::add_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// mat add_assign scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline MatT & operator+=(MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT & operator+=(MatT &lhs, const T &rhs) {
 					zip_with(detail::op::add_assign(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 					return lhs;
 				}
 
 				// mat sub_assign
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline MatT1 & operator-=(MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT1 & operator-=(MatT1 &lhs, const MatT2 &rhs) {
 					zip_with(detail::op::sub_assign(), lhs, rhs);
 					return lhs;
 				}
 
 				// mat sub_assign scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline MatT & operator-=(MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT & operator-=(MatT &lhs, const T &rhs) {
 					zip_with(detail::op::sub_assign(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 					return lhs;
 				}
 
 				// mat mul_assign
 				template <typename MatT1, typename MatT2, enable_if_matrix_mul_compatible_t<MatT1, MatT2> = 0>
-				inline MatT1 & operator*=(MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT1 & operator*=(MatT1 &lhs, const MatT2 &rhs) {
 					return lhs = lhs * rhs;
 				}
 
 				// mat mul_assign scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline MatT & operator*=(MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT & operator*=(MatT &lhs, const T &rhs) {
 					zip_with(detail::op::mul_assign(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 					return lhs;
 				}
 
 				// mat div_assign scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline MatT & operator/=(MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION MatT & operator/=(MatT &lhs, const T &rhs) {
 					zip_with(detail::op::div_assign(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 					return lhs;
 				}
 
 				// mat negate
 				template <typename MatT, enable_if_matrix_t<MatT> = 0>
-				inline auto operator-(const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const MatT &rhs) {
 					return zip_with<type_to_mat>(detail::op::neg(), rhs);
 				}
 
 				// mat add
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline auto operator+(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const MatT1 &lhs, const MatT2 &rhs) {
 					return zip_with<type_to_mat>(detail::op::add(), lhs, rhs);
 				}
 
 				// mat add right scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator+(const MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const MatT &lhs, const T &rhs) {
 					return zip_with<type_to_mat>(detail::op::add(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 				}
 
 				// mat add left scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator+(const T &lhs, const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator+(const T &lhs, const MatT &rhs) {
 					return zip_with<type_to_mat>(detail::op::add(), repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(lhs), rhs);
 				}
 
 				// mat sub
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline auto operator-(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const MatT1 &lhs, const MatT2 &rhs) {
 					return zip_with<type_to_mat>(detail::op::sub(), lhs, rhs);
 				}
 
 				// mat sub right scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator-(const MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const MatT &lhs, const T &rhs) {
 					return zip_with<type_to_mat>(detail::op::sub(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 				}
 
 				// mat sub left scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator-(const T &lhs, const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator-(const T &lhs, const MatT &rhs) {
 					return zip_with<type_to_mat>(detail::op::sub(), repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(lhs), rhs);
 				}
 
 				// mat mul
 				template <typename MatT1, typename MatT2, enable_if_matrix_mul_compatible_t<MatT1, MatT2> = 0>
-				inline auto operator*(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const MatT1 &lhs, const MatT2 &rhs) {
 					return zip_with<type_to_mat>([&](auto &rcol) { return dot(lhs, rcol); }, rhs);
 				}
 
 				// mat mul right scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator*(const MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const MatT &lhs, const T &rhs) {
 					return zip_with<type_to_mat>(detail::op::mul(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 				}
 
 				// mat mul left scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator*(const T &lhs, const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const T &lhs, const MatT &rhs) {
 					return zip_with<type_to_mat>(detail::op::mul(), repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(lhs), rhs);
 				}
 
 				// mat div right scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator/(const MatT &lhs, const T &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator/(const MatT &lhs, const T &rhs) {
 					return zip_with<type_to_mat>(detail::op::div(), lhs, repeat_vec_vec<T, mat_cols<MatT>::value, mat_rows<MatT>::value>(rhs));
 				}
 
 				// mat div left scalar
 				template <typename MatT, typename T, enable_if_matrix_scalar_compatible_t<MatT, T> = 0>
-				inline auto operator/(const T &lhs, const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator/(const T &lhs, const MatT &rhs) {
 					return lhs * inverse(rhs);
 				}
 
 				// mat mul right vec
 				template <typename MatT, typename VecT, enable_if_matrix_mul_col_compatible_t<MatT, VecT> = 0>
-				inline auto operator*(const MatT &lhs, const VecT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const MatT &lhs, const VecT &rhs) {
 					return dot(lhs, rhs);
 				}
 
 				// mat mul left vec
 				template <typename MatT, typename VecT, enable_if_matrix_mul_row_compatible_t<MatT, VecT> = 0>
-				inline auto operator*(const VecT &lhs, const MatT &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator*(const VecT &lhs, const MatT &rhs) {
 					return zip_with([&](auto &rcol) { return dot(lhs, rcol); }, rhs);
 				}
 				
 				// mat equal
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline auto operator==(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator==(const MatT1 &lhs, const MatT2 &rhs) {
 					return fold(detail::op::logical_and(), true, zip_with(detail::op::equal(), lhs, rhs));
 				}
 
 				// mat not-equal
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline auto operator!=(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto operator!=(const MatT1 &lhs, const MatT2 &rhs) {
 					return fold(detail::op::logical_or(), false, zip_with(detail::op::not_equal(), lhs, rhs));
 				}
 
@@ -3653,6 +3698,249 @@ namespace cgra {
 
 
 
+	// 
+	// SIMD operator overloads
+	// 
+	// Non-template overloads for float vec4 and mat4 which are picked over the
+	// generic templates. Every lane does the same operations in the same order
+	// as the generic code (including the fold from zero), so results are identical.
+	// 
+	//=================
+
+#ifdef CGRA_SIMD_SSE2
+
+// the overloads are constexpr when we can tell that they are being evaluated at
+// compile time, they then use the generic templates (named with explicit arguments,
+// which excludes these non-templates)
+#if defined(CGRA_HAVE_IS_CONSTANT_EVALUATED) && !defined(CGRA_NO_CONSTEXPR_FUNCTIONS)
+#define CGRA_SIMD_CONSTEXPR constexpr
+#else
+#define CGRA_SIMD_CONSTEXPR inline
+#endif
+
+	namespace detail {
+		namespace simd {
+
+			// vec4 storage is 16-byte aligned (see vec_data_align)
+			inline __m128 load(const basic_vec<float, 4> &v) {
+				return _mm_load_ps(v.data());
+			}
+
+			inline basic_vec<float, 4> store(__m128 x) {
+				basic_vec<float, 4> r;
+				_mm_store_ps(r.data(), x);
+				return r;
+			}
+
+			template <int I>
+			inline __m128 splat(__m128 x) {
+				return _mm_shuffle_ps(x, x, _MM_SHUFFLE(I, I, I, I));
+			}
+
+			// sum of m[i] * v[i] over the columns of m, same order as dot(m, v)
+			inline __m128 mul_mat_vec(const basic_mat<float, 4, 4> &m, __m128 v) {
+				__m128 r = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(load(m[0]), splat<0>(v)));
+				r = _mm_add_ps(r, _mm_mul_ps(load(m[1]), splat<1>(v)));
+				r = _mm_add_ps(r, _mm_mul_ps(load(m[2]), splat<2>(v)));
+				return _mm_add_ps(r, _mm_mul_ps(load(m[3]), splat<3>(v)));
+			}
+
+			template <typename F>
+			inline basic_mat<float, 4, 4> map_mat(const basic_mat<float, 4, 4> &m, F f) {
+				basic_mat<float, 4, 4> r;
+				for (size_t i = 0; i < 4; i++) _mm_store_ps(r[i].data(), f(load(m[i]), i));
+				return r;
+			}
+
+		}
+
+		namespace vectors {
+			namespace functions {
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator+(const basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator+<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					return simd::store(_mm_add_ps(simd::load(lhs), simd::load(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator-(const basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator-<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					return simd::store(_mm_sub_ps(simd::load(lhs), simd::load(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator*(const basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					return simd::store(_mm_mul_ps(simd::load(lhs), simd::load(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator*(const basic_vec<float, 4> &lhs, float rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_vec<float, 4>, float>(lhs, rhs);
+					return simd::store(_mm_mul_ps(simd::load(lhs), _mm_set1_ps(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator*(float lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_vec<float, 4>, float>(lhs, rhs);
+					return simd::store(_mm_mul_ps(_mm_set1_ps(lhs), simd::load(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator/(const basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator/<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					return simd::store(_mm_div_ps(simd::load(lhs), simd::load(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator/(const basic_vec<float, 4> &lhs, float rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator/<basic_vec<float, 4>, float>(lhs, rhs);
+					return simd::store(_mm_div_ps(simd::load(lhs), _mm_set1_ps(rhs)));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> & operator+=(basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator+=<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					_mm_store_ps(lhs.data(), _mm_add_ps(simd::load(lhs), simd::load(rhs)));
+					return lhs;
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> & operator-=(basic_vec<float, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator-=<basic_vec<float, 4>, basic_vec<float, 4>>(lhs, rhs);
+					_mm_store_ps(lhs.data(), _mm_sub_ps(simd::load(lhs), simd::load(rhs)));
+					return lhs;
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> & operator*=(basic_vec<float, 4> &lhs, float rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*=<basic_vec<float, 4>, float>(lhs, rhs);
+					_mm_store_ps(lhs.data(), _mm_mul_ps(simd::load(lhs), _mm_set1_ps(rhs)));
+					return lhs;
+				}
+
+#ifdef CGRA_SIMD_SSE41
+				inline basic_vec<float, 4> floor(const basic_vec<float, 4> &v) {
+					return simd::store(_mm_floor_ps(simd::load(v)));
+				}
+
+				inline basic_vec<float, 4> ceil(const basic_vec<float, 4> &v) {
+					return simd::store(_mm_ceil_ps(simd::load(v)));
+				}
+#endif
+
+			}
+		}
+
+		namespace matrices {
+			namespace functions {
+
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator*(const basic_mat<float, 4, 4> &lhs, const basic_vec<float, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_mat<float, 4, 4>, basic_vec<float, 4>>(lhs, rhs);
+					return simd::store(simd::mul_mat_vec(lhs, simd::load(rhs)));
+				}
+
+				// row vector, the transposed rows are summed instead of the columns
+				CGRA_SIMD_CONSTEXPR basic_vec<float, 4> operator*(const basic_vec<float, 4> &lhs, const basic_mat<float, 4, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_mat<float, 4, 4>, basic_vec<float, 4>>(lhs, rhs);
+					__m128 c0 = simd::load(rhs[0]), c1 = simd::load(rhs[1]), c2 = simd::load(rhs[2]), c3 = simd::load(rhs[3]);
+					_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+					const __m128 v = simd::load(lhs);
+					__m128 r = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(c0, simd::splat<0>(v)));
+					r = _mm_add_ps(r, _mm_mul_ps(c1, simd::splat<1>(v)));
+					r = _mm_add_ps(r, _mm_mul_ps(c2, simd::splat<2>(v)));
+					return simd::store(_mm_add_ps(r, _mm_mul_ps(c3, simd::splat<3>(v))));
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> operator*(const basic_mat<float, 4, 4> &lhs, const basic_mat<float, 4, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_mat<float, 4, 4>, basic_mat<float, 4, 4>>(lhs, rhs);
+					basic_mat<float, 4, 4> r;
+#ifdef CGRA_SIMD_AVX
+					// two result columns per iteration, lhs columns are repeated in both halves
+					const __m256 l0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(lhs[0].data()));
+					const __m256 l1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(lhs[1].data()));
+					const __m256 l2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(lhs[2].data()));
+					const __m256 l3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(lhs[3].data()));
+					for (size_t i = 0; i < 4; i += 2) {
+						const __m256 v = _mm256_loadu_ps(rhs[i].data());
+						__m256 c = _mm256_add_ps(_mm256_setzero_ps(), _mm256_mul_ps(l0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0))));
+						c = _mm256_add_ps(c, _mm256_mul_ps(l1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+						c = _mm256_add_ps(c, _mm256_mul_ps(l2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+						c = _mm256_add_ps(c, _mm256_mul_ps(l3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+						_mm256_storeu_ps(r[i].data(), c);
+					}
+#else
+					for (size_t i = 0; i < 4; i++) {
+						_mm_store_ps(r[i].data(), simd::mul_mat_vec(lhs, simd::load(rhs[i])));
+					}
+#endif
+					return r;
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> & operator*=(basic_mat<float, 4, 4> &lhs, const basic_mat<float, 4, 4> &rhs) {
+					return lhs = lhs * rhs;
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> operator+(const basic_mat<float, 4, 4> &lhs, const basic_mat<float, 4, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator+<basic_mat<float, 4, 4>, basic_mat<float, 4, 4>>(lhs, rhs);
+					return simd::map_mat(lhs, [&](__m128 c, size_t i) { return _mm_add_ps(c, simd::load(rhs[i])); });
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> operator-(const basic_mat<float, 4, 4> &lhs, const basic_mat<float, 4, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator-<basic_mat<float, 4, 4>, basic_mat<float, 4, 4>>(lhs, rhs);
+					return simd::map_mat(lhs, [&](__m128 c, size_t i) { return _mm_sub_ps(c, simd::load(rhs[i])); });
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> operator*(const basic_mat<float, 4, 4> &lhs, float rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_mat<float, 4, 4>, float>(lhs, rhs);
+					const __m128 s = _mm_set1_ps(rhs);
+					return simd::map_mat(lhs, [=](__m128 c, size_t) { return _mm_mul_ps(c, s); });
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> operator*(float lhs, const basic_mat<float, 4, 4> &rhs) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return operator*<basic_mat<float, 4, 4>, float>(lhs, rhs);
+					const __m128 s = _mm_set1_ps(lhs);
+					return simd::map_mat(rhs, [=](__m128 c, size_t) { return _mm_mul_ps(s, c); });
+				}
+
+				// see the generic inverse_rigid
+				inline basic_mat<float, 4, 4> inverse_rigid(const basic_mat<float, 4, 4> &m) {
+					__m128 c0 = simd::load(m[0]), c1 = simd::load(m[1]), c2 = simd::load(m[2]), c3 = simd::load(m[3]);
+					const __m128 t = c3;
+					_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+					// rows now have the translation in w
+					const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+					c0 = _mm_and_ps(c0, xyz);
+					c1 = _mm_and_ps(c1, xyz);
+					c2 = _mm_and_ps(c2, xyz);
+					__m128 rt = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(c0, simd::splat<0>(t)));
+					rt = _mm_add_ps(rt, _mm_mul_ps(c1, simd::splat<1>(t)));
+					rt = _mm_add_ps(rt, _mm_mul_ps(c2, simd::splat<2>(t)));
+					rt = _mm_sub_ps(_mm_set_ps(1, 0, 0, 0), rt);
+					basic_mat<float, 4, 4> r;
+					_mm_store_ps(r[0].data(), c0);
+					_mm_store_ps(r[1].data(), c1);
+					_mm_store_ps(r[2].data(), c2);
+					_mm_store_ps(r[3].data(), rt);
+					return r;
+				}
+
+				CGRA_SIMD_CONSTEXPR basic_mat<float, 4, 4> transpose(const basic_mat<float, 4, 4> &m) {
+					if (CGRA_IS_CONSTANT_EVALUATED()) return basic_mat<float, 4, 4>{
+						basic_vec<float, 4>{m[0][0], m[1][0], m[2][0], m[3][0]},
+						basic_vec<float, 4>{m[0][1], m[1][1], m[2][1], m[3][1]},
+						basic_vec<float, 4>{m[0][2], m[1][2], m[2][2], m[3][2]},
+						basic_vec<float, 4>{m[0][3], m[1][3], m[2][3], m[3][3]}
+					};
+					__m128 c0 = simd::load(m[0]), c1 = simd::load(m[1]), c2 = simd::load(m[2]), c3 = simd::load(m[3]);
+					_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+					basic_mat<float, 4, 4> r;
+					_mm_store_ps(r[0].data(), c0);
+					_mm_store_ps(r[1].data(), c1);
+					_mm_store_ps(r[2].data(), c2);
+					_mm_store_ps(r[3].data(), c3);
+					return r;
+				}
+
+			}
+		}
+	}
+#undef CGRA_SIMD_CONSTEXPR
+#endif // CGRA_SIMD_SSE2
+
+
+
 
 	// .___________..______       __    _______     _______  __    __  .__   __.   ______ .___________. __    ______   .__   __.      _______.  //
 	// |           ||   _  \     |  |  /  _____|   |   ____||  |  |  | |  \ |  |  /      ||           ||  |  /  __  \  |  \ |  |     /       |  //
@@ -3754,13 +4042,13 @@ namespace cgra {
 
 				// Converts degrees to radians, i.e., x * pi/180
 				template <typename T, enable_if_want_real_fns_t<T> = 0>
-				inline auto radians(const T &x) {
+				CGRA_CONSTEXPR_FUNCTION auto radians(const T &x) {
 					return x * fpromote_t<T>(pi / 180.0);
 				}
 
 				// Converts radians to degrees, i.e., x * 180/pi
 				template <typename T, enable_if_want_real_fns_t<T> = 0>
-				inline auto degrees(const T &x) {
+				CGRA_CONSTEXPR_FUNCTION auto degrees(const T &x) {
 					return x * fpromote_t<T>(180.0 / pi);
 				}
 
@@ -3986,14 +4274,14 @@ namespace cgra {
 
 				// vec degrees to radians
 				template <typename VecT, enable_if_vector_t<VecT> = 0>
-				inline auto radians(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto radians(const VecT &v) {
 					using cgra::detail::scalars::radians;
 					return zip_with([](const auto &x) { return radians(x); }, v);
 				}
 
 				// vec radians to degrees
 				template <typename VecT, enable_if_vector_t<VecT> = 0>
-				inline auto degrees(const VecT &v) {
+				CGRA_CONSTEXPR_FUNCTION auto degrees(const VecT &v) {
 					using cgra::detail::scalars::degrees;
 					return zip_with([](const auto &x) { return degrees(x); }, v);
 				}
@@ -4723,7 +5011,7 @@ namespace cgra {
 			template <>
 			struct cross_impl<3> {
 				template <typename VecT1, typename VecT2>
-				static auto go(const VecT1 &v1, const VecT2 &v2) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const VecT1 &v1, const VecT2 &v2) {
 					return basic_vec<decltype(v1[0] * v2[0]), 3>(
 						v1[1] * v2[2] - v1[2] * v2[1],
 						v1[2] * v2[0] - v1[0] * v2[2],
@@ -4809,7 +5097,7 @@ namespace cgra {
 
 				// vec cross product
 				template <typename VecT1, typename VecT2, enable_if_vector_compatible_t<VecT1, VecT2> = 0>
-				inline auto cross(const VecT1 &v1, const VecT2 &v2) {
+				CGRA_CONSTEXPR_FUNCTION auto cross(const VecT1 &v1, const VecT2 &v2) {
 					return cross_impl<array_size<VecT1>::value>::go(v1, v2);
 				}
 
@@ -4929,7 +5217,7 @@ namespace cgra {
 		namespace matrices {
 
 			template <typename T>
-			inline T det2x2(
+			CGRA_CONSTEXPR_FUNCTION T det2x2(
 				const T &e00, const T &e01,
 				const T &e10, const T &e11
 			) {
@@ -4938,7 +5226,7 @@ namespace cgra {
 
 			// this would actually be fine on integers, but we force the type if fpromoting for consistency
 			template <typename T>
-			inline T det3x3(
+			CGRA_CONSTEXPR_FUNCTION T det3x3(
 				const T &e00, const T &e01, const T &e02,
 				const T &e10, const T &e11, const T &e12,
 				const T &e20, const T &e21, const T &e22
@@ -5078,38 +5366,63 @@ namespace cgra {
 				}
 			};
 
+			// 2x2 sub-determinants of the top and bottom half (rows 0-1 and 2-3 of
+			// the column pairs) of a 4x4 matrix. by Laplace expansion about the top
+			// half, these give the determinant and every cofactor with 12 products
+			// instead of the 16 3x3 determinants of a direct cofactor expansion
+			template <typename T>
+			struct minors4x4 {
+				T s0, s1, s2, s3, s4, s5;
+				T c0, c1, c2, c3, c4, c5;
+
+				template <typename MatT>
+				CGRA_CONSTEXPR_FUNCTION explicit minors4x4(const MatT &m) :
+					s0(det2x2<T>(m[0][0], m[0][1], m[1][0], m[1][1])),
+					s1(det2x2<T>(m[0][0], m[0][2], m[1][0], m[1][2])),
+					s2(det2x2<T>(m[0][0], m[0][3], m[1][0], m[1][3])),
+					s3(det2x2<T>(m[0][1], m[0][2], m[1][1], m[1][2])),
+					s4(det2x2<T>(m[0][1], m[0][3], m[1][1], m[1][3])),
+					s5(det2x2<T>(m[0][2], m[0][3], m[1][2], m[1][3])),
+					c0(det2x2<T>(m[2][0], m[2][1], m[3][0], m[3][1])),
+					c1(det2x2<T>(m[2][0], m[2][2], m[3][0], m[3][2])),
+					c2(det2x2<T>(m[2][0], m[2][3], m[3][0], m[3][3])),
+					c3(det2x2<T>(m[2][1], m[2][2], m[3][1], m[3][2])),
+					c4(det2x2<T>(m[2][1], m[2][3], m[3][1], m[3][3])),
+					c5(det2x2<T>(m[2][2], m[2][3], m[3][2], m[3][3]))
+				{}
+
+				CGRA_CONSTEXPR_FUNCTION T determinant() const {
+					return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+				}
+			};
+
 			template <>
 			struct inverse_impl<4, 4> {
 				template <typename MatT>
 				static auto go(const MatT &m) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					auto r = decltype(mat_cast<value_t>(m)){};
-					// first column of cofactors, can use for determinant
-					const auto c0 = det3x3<value_t>(m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]);
-					const auto c1 = -det3x3<value_t>(m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]);
-					const auto c2 = det3x3<value_t>(m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]);
-					const auto c3 = -det3x3<value_t>(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]);
-					// get determinant by expanding about first column
-					const auto det = m[0][0] * c0 + m[0][1] * c1 + m[0][2] * c2 + m[0][3] * c3;
+					const minors4x4<value_t> k(m);
+					const auto det = k.determinant();
 					const auto invdet = value_t(1) / det;
 					if (any(isinf(invdet) || isnan(invdet) || isinf(det))) throw singular_matrix_error();
-					// transpose of cofactor matrix * (1 / det)
-					r[0][0] = c0 * invdet;
-					r[1][0] = c1 * invdet;
-					r[2][0] = c2 * invdet;
-					r[3][0] = c3 * invdet;
-					r[0][1] = -det3x3<value_t>(m[0][1], m[0][2], m[0][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]) * invdet;
-					r[1][1] = det3x3<value_t>(m[0][0], m[0][2], m[0][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]) * invdet;
-					r[2][1] = -det3x3<value_t>(m[0][0], m[0][1], m[0][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]) * invdet;
-					r[3][1] = det3x3<value_t>(m[0][0], m[0][1], m[0][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]) * invdet;
-					r[0][2] = det3x3<value_t>(m[0][1], m[0][2], m[0][3], m[1][1], m[1][2], m[1][3], m[3][1], m[3][2], m[3][3]) * invdet;
-					r[1][2] = -det3x3<value_t>(m[0][0], m[0][2], m[0][3], m[1][0], m[1][2], m[1][3], m[3][0], m[3][2], m[3][3]) * invdet;
-					r[2][2] = det3x3<value_t>(m[0][0], m[0][1], m[0][3], m[1][0], m[1][1], m[1][3], m[3][0], m[3][1], m[3][3]) * invdet;
-					r[3][2] = -det3x3<value_t>(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[3][0], m[3][1], m[3][2]) * invdet;
-					r[0][3] = -det3x3<value_t>(m[0][1], m[0][2], m[0][3], m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3]) * invdet;
-					r[1][3] = det3x3<value_t>(m[0][0], m[0][2], m[0][3], m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3]) * invdet;
-					r[2][3] = -det3x3<value_t>(m[0][0], m[0][1], m[0][3], m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3]) * invdet;
-					r[3][3] = det3x3<value_t>(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2]) * invdet;
+					// transpose of cofactor matrix * (1 / det), each column is independent
+					r[0][0] = (m[1][1] * k.c5 - m[1][2] * k.c4 + m[1][3] * k.c3) * invdet;
+					r[0][1] = (-m[0][1] * k.c5 + m[0][2] * k.c4 - m[0][3] * k.c3) * invdet;
+					r[0][2] = (m[3][1] * k.s5 - m[3][2] * k.s4 + m[3][3] * k.s3) * invdet;
+					r[0][3] = (-m[2][1] * k.s5 + m[2][2] * k.s4 - m[2][3] * k.s3) * invdet;
+					r[1][0] = (-m[1][0] * k.c5 + m[1][2] * k.c2 - m[1][3] * k.c1) * invdet;
+					r[1][1] = (m[0][0] * k.c5 - m[0][2] * k.c2 + m[0][3] * k.c1) * invdet;
+					r[1][2] = (-m[3][0] * k.s5 + m[3][2] * k.s2 - m[3][3] * k.s1) * invdet;
+					r[1][3] = (m[2][0] * k.s5 - m[2][2] * k.s2 + m[2][3] * k.s1) * invdet;
+					r[2][0] = (m[1][0] * k.c4 - m[1][1] * k.c2 + m[1][3] * k.c0) * invdet;
+					r[2][1] = (-m[0][0] * k.c4 + m[0][1] * k.c2 - m[0][3] * k.c0) * invdet;
+					r[2][2] = (m[3][0] * k.s4 - m[3][1] * k.s2 + m[3][3] * k.s0) * invdet;
+					r[2][3] = (-m[2][0] * k.s4 + m[2][1] * k.s2 - m[2][3] * k.s0) * invdet;
+					r[3][0] = (-m[1][0] * k.c3 + m[1][1] * k.c1 - m[1][2] * k.c0) * invdet;
+					r[3][1] = (m[0][0] * k.c3 - m[0][1] * k.c1 + m[0][2] * k.c0) * invdet;
+					r[3][2] = (-m[3][0] * k.s3 + m[3][1] * k.s1 - m[3][2] * k.s0) * invdet;
+					r[3][3] = (m[2][0] * k.s3 - m[2][1] * k.s1 + m[2][2] * k.s0) * invdet;
 					return r;
 				}
 			};
@@ -5125,7 +5438,7 @@ namespace cgra {
 			template <size_t Cols, size_t Rows>
 			struct determinant_impl<Cols, Rows, std::enable_if_t<(Cols != Rows)>> {
 				template <typename MatT>
-				static auto go(const MatT &) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					// determinant of non-square matrix is always 0
 					return value_t(0);
@@ -5135,7 +5448,7 @@ namespace cgra {
 			template <>
 			struct determinant_impl<0, 0> {
 				template <typename MatT>
-				static auto go(const MatT &) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					// i'm just gonna say this is 1
 					return value_t(1);
@@ -5145,7 +5458,7 @@ namespace cgra {
 			template <>
 			struct determinant_impl<1, 1> {
 				template <typename MatT>
-				static auto go(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &m) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					return value_t(m[0][0]);
 				}
@@ -5154,7 +5467,7 @@ namespace cgra {
 			template <>
 			struct determinant_impl<2, 2> {
 				template <typename MatT>
-				static auto go(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &m) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					return det2x2<value_t>(m[0][0], m[0][1], m[1][0], m[1][1]);
 				}
@@ -5163,7 +5476,7 @@ namespace cgra {
 			template <>
 			struct determinant_impl<3, 3> {
 				template <typename MatT>
-				static auto go(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &m) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
 					return det3x3<value_t>(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2]);
 				}
@@ -5172,15 +5485,9 @@ namespace cgra {
 			template <>
 			struct determinant_impl<4, 4> {
 				template <typename MatT>
-				static auto go(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION static auto go(const MatT &m) {
 					using value_t = fpromote_t<matrix_value_t<MatT>>;
-					auto d = value_t(0);
-					// expand about first column
-					d += m[0][0] * det3x3<value_t>(m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]);
-					d -= m[0][1] * det3x3<value_t>(m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]);
-					d += m[0][2] * det3x3<value_t>(m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]);
-					d -= m[0][3] * det3x3<value_t>(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]);
-					return d;
+					return minors4x4<value_t>(m).determinant();
 				}
 			};
 
@@ -5194,13 +5501,69 @@ namespace cgra {
 
 				// matrix determinant
 				template <typename MatT, enable_if_matrix_t<MatT> = 0>
-				inline auto determinant(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION auto determinant(const MatT &m) {
 					return determinant_impl<mat_cols<MatT>::value, mat_rows<MatT>::value>::go(m);
 				}
 
+				// inverse of an affine transform (bottom row must be 0, 0, 0, 1)
+				// inverts the upper 3x3 and applies that to the negated translation
+				// error if the upper 3x3 is not invertible
+				template <typename T>
+				inline auto inverse_affine(const basic_mat<T, 4, 4> &m) {
+					using value_t = fpromote_t<T>;
+					const basic_vec<value_t, 3> a{m[0][0], m[0][1], m[0][2]};
+					const basic_vec<value_t, 3> b{m[1][0], m[1][1], m[1][2]};
+					const basic_vec<value_t, 3> c{m[2][0], m[2][1], m[2][2]};
+					const basic_vec<value_t, 3> t{m[3][0], m[3][1], m[3][2]};
+					// rows of the inverse are the cross products of the other two columns
+					const auto bc = cross(b, c), ca = cross(c, a), ab = cross(a, b);
+					const auto det = dot(a, bc);
+					const auto invdet = value_t(1) / det;
+					if (isinf(invdet) || isnan(invdet) || isinf(det)) throw singular_matrix_error();
+					return basic_mat<value_t, 4, 4>{
+						basic_vec<value_t, 4>{bc.x * invdet, ca.x * invdet, ab.x * invdet, value_t(0)},
+						basic_vec<value_t, 4>{bc.y * invdet, ca.y * invdet, ab.y * invdet, value_t(0)},
+						basic_vec<value_t, 4>{bc.z * invdet, ca.z * invdet, ab.z * invdet, value_t(0)},
+						basic_vec<value_t, 4>{-dot(bc, t) * invdet, -dot(ca, t) * invdet, -dot(ab, t) * invdet, value_t(1)}
+					};
+				}
+
+				// inverse of a rigid transform (rotation and translation only)
+				// the upper 3x3 must be orthonormal, so its inverse is its transpose
+				template <typename T>
+				inline auto inverse_rigid(const basic_mat<T, 4, 4> &m) {
+					using value_t = fpromote_t<T>;
+					const basic_vec<value_t, 3> a{m[0][0], m[0][1], m[0][2]};
+					const basic_vec<value_t, 3> b{m[1][0], m[1][1], m[1][2]};
+					const basic_vec<value_t, 3> c{m[2][0], m[2][1], m[2][2]};
+					const basic_vec<value_t, 3> t{m[3][0], m[3][1], m[3][2]};
+					return basic_mat<value_t, 4, 4>{
+						basic_vec<value_t, 4>{a.x, b.x, c.x, value_t(0)},
+						basic_vec<value_t, 4>{a.y, b.y, c.y, value_t(0)},
+						basic_vec<value_t, 4>{a.z, b.z, c.z, value_t(0)},
+						basic_vec<value_t, 4>{-dot(a, t), -dot(b, t), -dot(c, t), value_t(1)}
+					};
+				}
+
+				// transpose of the inverse of the upper 3x3, i.e. the normal matrix
+				// this is the cofactor matrix divided by the determinant, so no transpose is needed
+				// error if the upper 3x3 is not invertible
+				template <typename T, size_t N, std::enable_if_t<(N == 3 || N == 4), int> = 0>
+				inline auto inverse_transpose3x3(const basic_mat<T, N, N> &m) {
+					using value_t = fpromote_t<T>;
+					const basic_vec<value_t, 3> a{m[0][0], m[0][1], m[0][2]};
+					const basic_vec<value_t, 3> b{m[1][0], m[1][1], m[1][2]};
+					const basic_vec<value_t, 3> c{m[2][0], m[2][1], m[2][2]};
+					const auto bc = cross(b, c);
+					const auto det = dot(a, bc);
+					const auto invdet = value_t(1) / det;
+					if (isinf(invdet) || isnan(invdet) || isinf(det)) throw singular_matrix_error();
+					return basic_mat<value_t, 3, 3>{bc * invdet, cross(c, a) * invdet, cross(a, b) * invdet};
+				}
+
 				// matrix transpose
 				template <typename MatT, enable_if_matrix_t<MatT> = 0>
-				inline auto transpose(const MatT &m) {
+				CGRA_CONSTEXPR_FUNCTION auto transpose(const MatT &m) {
 					auto r = copy_type_t<MatT>{};
 					for (size_t j = 0; j < mat_cols<MatT>::value; ++j) {
 						for (size_t i = 0; i < mat_rows<MatT>::value; ++i) {
@@ -5213,7 +5576,7 @@ namespace cgra {
 				// matrix component-wise multiplication 
 				// see (*) operator overload for matrix product
 				template <typename MatT1, typename MatT2, enable_if_matrix_compatible_t<MatT1, MatT2> = 0>
-				inline auto matrix_comp_mult(const MatT1 &lhs, const MatT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto matrix_comp_mult(const MatT1 &lhs, const MatT2 &rhs) {
 					return zip_with<type_to_mat>(op::mul(), lhs, rhs);
 				}
 
@@ -5226,7 +5589,7 @@ namespace cgra {
 				// vector outer product
 				// matrix multiplication where lhs is column, rhs is row
 				template <typename VecT1, typename VecT2, std::enable_if_t<is_element_compatible<VecT1, VecT2>::value, int> = 0>
-				inline auto outer_product(const VecT1 &lhs, const VecT2 &rhs) {
+				CGRA_CONSTEXPR_FUNCTION auto outer_product(const VecT1 &lhs, const VecT2 &rhs) {
 					// TODO this could be constrained better
 					return zip_with<type_to_mat>(op::mul(), repeat_vec<const VecT1 &, array_size<VecT2>::value>(lhs), rhs);
 				}
@@ -5395,7 +5758,7 @@ namespace cgra {
 	//
 
 	template <typename MatT>
-	inline auto shear(int t_dim, int s_dim, typename MatT::value_t f) {
+	CGRA_CONSTEXPR_FUNCTION auto shear(int t_dim, int s_dim, typename MatT::value_t f) {
 		// FIXME shear transform specification
 		MatT m{ 1 };
 		m[t_dim][s_dim] = f;
@@ -5417,7 +5780,7 @@ namespace cgra {
 	}
 
 	template <typename Tx, typename Ty>
-	inline auto scale2(const Tx &x, const Ty &y) {
+	CGRA_CONSTEXPR_FUNCTION auto scale2(const Tx &x, const Ty &y) {
 		basic_mat<detail::fpromote_arith_t<Tx, Ty>, 3, 3> r{1};
 		r[0][0] = x;
 		r[1][1] = y;
@@ -5425,32 +5788,32 @@ namespace cgra {
 	}
 
 	template <typename T>
-	inline auto scale2(const T &x) {
+	CGRA_CONSTEXPR_FUNCTION auto scale2(const T &x) {
 		return scale2(x, x);
 	}
 
 	template <typename T>
-	inline auto scale2(const basic_vec<T, 2> &v) {
-		return scale2(v.x, v.y);
+	CGRA_CONSTEXPR_FUNCTION auto scale2(const basic_vec<T, 2> &v) {
+		return scale2(v[0], v[1]);
 	}
 
 	template <typename Tx, typename Ty>
-	inline auto translate2(const Tx &x, const Ty &y) {
+	CGRA_CONSTEXPR_FUNCTION auto translate2(const Tx &x, const Ty &y) {
 		basic_mat<detail::fpromote_arith_t<Tx, Ty>, 3, 3> r{1};
-		r[3][0] = x;
-		r[3][1] = y;
+		r[2][0] = x;
+		r[2][1] = y;
 		return r;
 	}
 
 	template <typename T>
-	inline auto translate2(const T &x) {
+	CGRA_CONSTEXPR_FUNCTION auto translate2(const T &x) {
 		// TODO is this overload useful?
 		return translate2(x, x);
 	}
 
 	template <typename T>
-	inline auto translate2(const basic_vec<T, 2> &v) {
-		return translate2(v.x, v.y);
+	CGRA_CONSTEXPR_FUNCTION auto translate2(const basic_vec<T, 2> &v) {
+		return translate2(v[0], v[1]);
 	}
 
 
@@ -5466,7 +5829,7 @@ namespace cgra {
 		const auto vy = normalize(cross(vz, vx));
 		basic_mat<value_t, 4, 4> r{vx, vy, vz, eye};
 		r[3][3] = value_t(1);
-		return inverse(r);
+		return inverse_rigid(r);
 	}
 
 	// fovy: vertical field of view in radians; aspect is w/h
@@ -5489,7 +5852,7 @@ namespace cgra {
 	}
 
 	template <typename Tl, typename Tr, typename Tb, typename Tt, typename Tn, typename Tf>
-	inline auto orthographic(const Tl &left, const Tr &right, const Tb &bottom, const Tt &top, const Tn &znear, const Tf &zfar) {
+	CGRA_CONSTEXPR_FUNCTION auto orthographic(const Tl &left, const Tr &right, const Tb &bottom, const Tt &top, const Tn &znear, const Tf &zfar) {
 		// TODO Nan check
 		using value_t = detail::fpromote_arith_t<Tl, Tr, Tb, Tt, Tn, Tf>;
 		basic_mat<value_t, 4, 4> r{0};
@@ -5543,7 +5906,7 @@ namespace cgra {
 	}
 
 	template <typename Tx, typename Ty, typename Tz>
-	inline auto scale3(const Tx &x, const Ty &y, const Tz &z) {
+	CGRA_CONSTEXPR_FUNCTION auto scale3(const Tx &x, const Ty &y, const Tz &z) {
 		using value_t = detail::fpromote_arith_t<Tx, Ty, Tz>;
 		basic_mat<value_t, 4, 4> r{1};
 		r[0][0] = x;
@@ -5553,17 +5916,17 @@ namespace cgra {
 	}
 
 	template <typename T>
-	inline auto scale3(const T &x) {
+	CGRA_CONSTEXPR_FUNCTION auto scale3(const T &x) {
 		return scale3(x, x, x);
 	}
 
 	template <typename T>
-	inline auto scale3(const basic_vec<T, 3> &v) {
-		return scale3(v.x, v.y, v.z);
+	CGRA_CONSTEXPR_FUNCTION auto scale3(const basic_vec<T, 3> &v) {
+		return scale3(v[0], v[1], v[2]);
 	}
 
 	template <typename Tx, typename Ty, typename Tz>
-	inline auto translate3(const Tx &x, const Ty &y, const Tz &z) {
+	CGRA_CONSTEXPR_FUNCTION auto translate3(const Tx &x, const Ty &y, const Tz &z) {
 		using value_t = detail::fpromote_arith_t<Tx, Ty, Tz>;
 		basic_mat<value_t, 4, 4> r{1};
 		r[3][0] = x;
@@ -5573,14 +5936,14 @@ namespace cgra {
 	}
 
 	template <typename T>
-	inline auto translate3(const T &x) {
+	CGRA_CONSTEXPR_FUNCTION auto translate3(const T &x) {
 		// TODO is this overload useful?
 		return translate3(x, x, x);
 	}
 
 	template <typename T>
-	inline auto translate3(const basic_vec<T, 3> &v) {
-		return translate3(v.x, v.y, v.z);
+	CGRA_CONSTEXPR_FUNCTION auto translate3(const basic_vec<T, 3> &v) {
+		return translate3(v[0], v[1], v[2]);
 	}
 
 	// Euler angle constuctor
@@ -5635,6 +5998,351 @@ namespace cgra {
 	//                                                                      //
 	//======================================================================//
 
+	// Random engines
+	// These satisfy UniformRandomBitGenerator, so they can be used with the std
+	// and cgra distributions, and give the same sequence on every platform
+
+	namespace detail {
+
+		// used to expand 64-bit seeds into larger states
+		CGRA_CONSTEXPR_FUNCTION uint64_t splitmix64(uint64_t &x) {
+			uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return z ^ (z >> 31);
+		}
+
+	}
+
+	// PCG32 (XSH-RR), 64-bit state and 32-bit output
+	// generators with the same seed and different streams are independent
+	class pcg32 {
+	private:
+		static constexpr uint64_t multiplier = 6364136223846793005ull;
+		uint64_t m_state = 0;
+		uint64_t m_inc = 1;
+
+	public:
+		using result_type = uint32_t;
+
+		CGRA_CONSTEXPR_FUNCTION pcg32() : pcg32(0x853c49e6748fea9bull) { }
+		CGRA_CONSTEXPR_FUNCTION explicit pcg32(uint64_t seed, uint64_t stream = 0) { this->seed(seed, stream); }
+
+		CGRA_CONSTEXPR_FUNCTION void seed(uint64_t seed, uint64_t stream = 0) {
+			m_state = 0;
+			m_inc = (stream << 1) | 1;
+			(*this)();
+			m_state += seed;
+			(*this)();
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT32_MAX; }
+
+		CGRA_CONSTEXPR_FUNCTION result_type operator()() {
+			const uint64_t old = m_state;
+			m_state = old * multiplier + m_inc;
+			const uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+			const uint32_t rot = uint32_t(old >> 59);
+			return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+		}
+
+		// advances the state by n steps in O(log n)
+		CGRA_CONSTEXPR_FUNCTION void discard(uint64_t n) {
+			uint64_t acc_mult = 1, acc_plus = 0;
+			uint64_t cur_mult = multiplier, cur_plus = m_inc;
+			for (; n > 0; n >>= 1) {
+				if (n & 1) {
+					acc_mult *= cur_mult;
+					acc_plus = acc_plus * cur_mult + cur_plus;
+				}
+				cur_plus = (cur_mult + 1) * cur_plus;
+				cur_mult *= cur_mult;
+			}
+			m_state = acc_mult * m_state + acc_plus;
+		}
+
+		friend bool operator==(const pcg32 &a, const pcg32 &b) {
+			return a.m_state == b.m_state && a.m_inc == b.m_inc;
+		}
+
+		friend bool operator!=(const pcg32 &a, const pcg32 &b) {
+			return !(a == b);
+		}
+	};
+
+	// xoshiro256** (Blackman and Vigna), 256-bit state and 64-bit output
+	// the state is filled from the seed with splitmix64
+	class xoshiro256ss {
+	private:
+		uint64_t m_s[4] = {};
+
+		static CGRA_CONSTEXPR_FUNCTION uint64_t rotl(uint64_t x, int k) {
+			return (x << k) | (x >> (64 - k));
+		}
+
+	public:
+		using result_type = uint64_t;
+
+		CGRA_CONSTEXPR_FUNCTION xoshiro256ss() : xoshiro256ss(0) { }
+		CGRA_CONSTEXPR_FUNCTION explicit xoshiro256ss(uint64_t seed) { this->seed(seed); }
+
+		CGRA_CONSTEXPR_FUNCTION void seed(uint64_t seed) {
+			for (auto &x : m_s) x = detail::splitmix64(seed);
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT64_MAX; }
+
+		CGRA_CONSTEXPR_FUNCTION result_type operator()() {
+			const uint64_t r = rotl(m_s[1] * 5, 7) * 9;
+			const uint64_t t = m_s[1] << 17;
+			m_s[2] ^= m_s[0];
+			m_s[3] ^= m_s[1];
+			m_s[1] ^= m_s[2];
+			m_s[0] ^= m_s[3];
+			m_s[2] ^= t;
+			m_s[3] = rotl(m_s[3], 45);
+			return r;
+		}
+
+		// equivalent to 2^128 calls, for giving each of several
+		// generators (with the same seed) a non-overlapping sequence
+		CGRA_CONSTEXPR_FUNCTION void jump() {
+			constexpr uint64_t j[] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+			uint64_t s[4] = {};
+			for (uint64_t w : j) {
+				for (int b = 0; b < 64; b++) {
+					if (w & (uint64_t(1) << b)) {
+						for (int i = 0; i < 4; i++) s[i] ^= m_s[i];
+					}
+					(*this)();
+				}
+			}
+			for (int i = 0; i < 4; i++) m_s[i] = s[i];
+		}
+
+		friend bool operator==(const xoshiro256ss &a, const xoshiro256ss &b) {
+			return std::equal(a.m_s, a.m_s + 4, b.m_s);
+		}
+
+		friend bool operator!=(const xoshiro256ss &a, const xoshiro256ss &b) {
+			return !(a == b);
+		}
+	};
+
+	// Counter-based generator (Philox4x32-10, Salmon et al. 2011)
+	// block() encrypts a 128-bit counter with a 64-bit key, so any part of the
+	// sequence can be computed directly, e.g. from the element index in a parallel
+	// loop, and the result doesn't depend on how the work is split between threads.
+	// As an engine, it returns the words of block 0, 1, 2... of the stream in turn.
+	class philox4x32 {
+	public:
+		using result_type = uint32_t;
+		using counter_type = std::array<uint32_t, 4>;
+		using key_type = std::array<uint32_t, 2>;
+
+		static CGRA_CONSTEXPR_FUNCTION counter_type block(counter_type c, key_type k) {
+			for (int i = 0; i < 10; i++) {
+				if (i > 0) {
+					k[0] += 0x9e3779b9u;
+					k[1] += 0xbb67ae85u;
+				}
+				const uint64_t p0 = uint64_t(0xd2511f53u) * c[0];
+				const uint64_t p1 = uint64_t(0xcd9e8d57u) * c[2];
+				c = counter_type{{ uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0) }};
+			}
+			return c;
+		}
+
+		// block n of the given stream for the key made from seed
+		static CGRA_CONSTEXPR_FUNCTION counter_type block(uint64_t seed, uint64_t n, uint64_t stream = 0) {
+			return block(
+				counter_type{{ uint32_t(n), uint32_t(n >> 32), uint32_t(stream), uint32_t(stream >> 32) }},
+				key_type{{ uint32_t(seed), uint32_t(seed >> 32) }}
+			);
+		}
+
+	private:
+		uint64_t m_seed = 0;
+		uint64_t m_stream = 0;
+		uint64_t m_next = 0;
+		counter_type m_block{};
+		int m_index = 4;
+
+	public:
+		CGRA_CONSTEXPR_FUNCTION philox4x32() { }
+		CGRA_CONSTEXPR_FUNCTION explicit philox4x32(uint64_t seed, uint64_t stream = 0) { this->seed(seed, stream); }
+
+		CGRA_CONSTEXPR_FUNCTION void seed(uint64_t seed, uint64_t stream = 0) {
+			m_seed = seed;
+			m_stream = stream;
+			seek(0);
+		}
+
+		// the next output will be the first word of block n
+		CGRA_CONSTEXPR_FUNCTION void seek(uint64_t n) {
+			m_next = n;
+			m_index = 4;
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT32_MAX; }
+
+		CGRA_CONSTEXPR_FUNCTION result_type operator()() {
+			if (m_index == 4) {
+				m_block = block(m_seed, m_next++, m_stream);
+				m_index = 0;
+			}
+			return m_block[m_index++];
+		}
+
+		CGRA_CONSTEXPR_FUNCTION void discard(uint64_t n) {
+			for (; n > 0 && m_index < 4; n--) m_index++;
+			if (n >= 4) {
+				seek(m_next + n / 4);
+				n %= 4;
+			}
+			for (; n > 0; n--) (*this)();
+		}
+
+		friend bool operator==(const philox4x32 &a, const philox4x32 &b) {
+			return a.m_seed == b.m_seed && a.m_stream == b.m_stream && a.m_next == b.m_next && a.m_index == b.m_index;
+		}
+
+		friend bool operator!=(const philox4x32 &a, const philox4x32 &b) {
+			return !(a == b);
+		}
+	};
+
+	namespace detail {
+
+		// random bits from generators with a full 32 or 64-bit range, others go through std
+		template <typename UIntT, typename Generator>
+		inline UIntT random_bits(Generator &g, std::integral_constant<int, 32>) {
+			if (sizeof(UIntT) <= 4) return UIntT(g());
+			const uint64_t hi = uint32_t(g());
+			return UIntT((hi << 32) | uint32_t(g()));
+		}
+
+		template <typename UIntT, typename Generator>
+		inline UIntT random_bits(Generator &g, std::integral_constant<int, 64>) {
+			return UIntT(uint64_t(g()) >> (64 - 8 * sizeof(UIntT)));
+		}
+
+		template <typename UIntT, typename Generator>
+		inline UIntT random_bits(Generator &g, std::integral_constant<int, 0>) {
+			return std::uniform_int_distribution<UIntT>()(g);
+		}
+
+		template <typename UIntT, typename Generator>
+		inline UIntT random_bits(Generator &g) {
+			constexpr uint64_t gmax = uint64_t(Generator::max());
+			constexpr int bits = Generator::min() != 0 ? 0 : gmax == UINT64_MAX ? 64 : gmax == UINT32_MAX ? 32 : 0;
+			return random_bits<UIntT>(g, std::integral_constant<int, bits>());
+		}
+
+		// [0, 1) from the high bits
+		inline float random_unit(uint32_t x) { return float(x >> 8) * (1.f / 16777216.f); }
+		inline double random_unit(uint64_t x) { return double(x >> 11) * (1.0 / 9007199254740992.0); }
+
+		// uniform in [a, b)
+		template <typename T, typename Generator>
+		inline T uniform_scalar(Generator &g, T a, T b, std::false_type) {
+			using bits_t = std::conditional_t<(sizeof(T) <= 4), uint32_t, uint64_t>;
+			const auto u = random_unit(random_bits<bits_t>(g));
+			return T(a + (b - a) * u);
+		}
+
+		// uniform in [a, b], Lemire's nearly divisionless method for 32-bit ranges
+		template <typename T, typename Generator>
+		inline T uniform_scalar(Generator &g, T a, T b, std::true_type) {
+			using uint_t = std::conditional_t<(sizeof(T) <= 4), uint32_t, uint64_t>;
+			const uint_t range = uint_t(uint_t(b) - uint_t(a));
+			uint_t x = random_bits<uint_t>(g);
+			if (range == uint_t(-1)) return T(uint_t(a) + x);
+			const uint_t s = range + 1;
+			if (sizeof(uint_t) == 4) {
+				uint64_t m = uint64_t(x) * s;
+				if (uint32_t(m) < s) {
+					const uint32_t t = (0u - uint32_t(s)) % uint32_t(s);
+					while (uint32_t(m) < t) m = uint64_t(random_bits<uint32_t>(g)) * s;
+				}
+				return T(uint_t(a) + uint_t(m >> 32));
+			}
+			const uint_t limit = uint_t(-1) - uint_t(-1) % s;
+			while (x >= limit) x = random_bits<uint_t>(g);
+			return T(uint_t(a) + x % s);
+		}
+
+	}
+
+	// uniform distribution of arithmetic types; a closed range [a, b] for
+	// integers and half open [a, b) for floating point, like the std equivalents,
+	// but with the same results for every standard library
+	template <typename T>
+	class uniform_scalar_distribution {
+	public:
+		using result_type = T;
+
+		class param_type {
+		private:
+			T m_a;
+			T m_b;
+
+		public:
+			using distribution_type = uniform_scalar_distribution;
+
+			param_type(const T &a = T(0), const T &b = std::is_integral<T>::value ? std::numeric_limits<T>::max() : T(1)) : m_a(a), m_b(b) { }
+
+			T a() const { return m_a; }
+			T b() const { return m_b; }
+
+			friend bool operator==(const param_type &p1, const param_type &p2) {
+				return p1.m_a == p2.m_a && p1.m_b == p2.m_b;
+			}
+		};
+
+	private:
+		param_type m_param;
+
+	public:
+		uniform_scalar_distribution() { }
+		explicit uniform_scalar_distribution(const T &a, const T &b) : m_param(a, b) { }
+		explicit uniform_scalar_distribution(const param_type &param) : m_param(param) { }
+
+		T a() const { return m_param.a(); }
+		T b() const { return m_param.b(); }
+
+		void reset() { }
+
+		param_type param() const { return m_param; }
+
+		void param(const param_type &param) { m_param = param; }
+
+		result_type min() const { return a(); }
+		result_type max() const { return b(); }
+
+		template <typename Generator>
+		result_type operator()(Generator &g) const {
+			return (*this)(g, m_param);
+		}
+
+		template <typename Generator>
+		result_type operator()(Generator &g, const param_type &param) const {
+			return detail::uniform_scalar<T>(g, param.a(), param.b(), std::is_integral<T>());
+		}
+
+		friend bool operator==(const uniform_scalar_distribution &d1, const uniform_scalar_distribution &d2) {
+			return d1.param() == d2.param();
+		}
+
+		friend bool operator!=(const uniform_scalar_distribution &d1, const uniform_scalar_distribution &d2) {
+			return !(d1 == d2);
+		}
+	};
+
+
 	namespace detail {
 
 		template <typename T, typename = void>
@@ -5699,7 +6407,7 @@ namespace cgra {
 		template <typename Generator>
 		result_type operator()(Generator& g, param_type param) {
 			result_type r;
-			for (int i = 0; i < r.size; ++i)
+			for (size_t i = 0; i < r.size; ++i)
 				r[i] = m_elem_dist(g, typename elem_dist_type::param_type(param.a()[i], param.b()[i]));
 			return r;
 		}
@@ -5770,8 +6478,8 @@ namespace cgra {
 		template <typename Generator>
 		result_type operator()(Generator& g, param_type param) {
 			result_type r;
-			for (int j = 0; j < r.cols; ++j)
-				for (int i = 0; i < r.rows; ++i)
+			for (size_t j = 0; j < r.cols; ++j)
+				for (size_t i = 0; i < r.rows; ++i)
 					r[j][i] = m_elem_dist(g, typename elem_dist_type::param_type(param.a()[j][i], param.b()[j][i]));
 			return r;
 		}
@@ -5868,23 +6576,8 @@ namespace cgra {
 	namespace detail {
 
 		template <typename T>
-		struct distribution<T, std::enable_if_t<std::is_integral<T>::value>> {
-			using type = std::uniform_int_distribution<
-				std::conditional_t<
-					sizeof(T) < sizeof(short),
-					std::conditional_t<
-						std::is_signed<T>::value,
-						short,
-						unsigned short
-					>,
-					T
-				>
-			>;
-		};
-
-		template <typename T>
-		struct distribution<T, std::enable_if_t<std::is_floating_point<T>::value>> {
-			using type = std::uniform_real_distribution<T>;
+		struct distribution<T, std::enable_if_t<std::is_arithmetic<T>::value>> {
+			using type = uniform_scalar_distribution<T>;
 		};
 
 		template <typename T, size_t N>
@@ -5902,13 +6595,18 @@ namespace cgra {
 			using type = uniform_quat_distribution<T>;
 		};
 
-		// singleton for random engine
+		// per-thread engine for random()
 		inline auto & random_engine() {
-			static thread_local std::default_random_engine re { std::random_device()() };
+			static thread_local pcg32 re { (uint64_t(std::random_device()()) << 32) | std::random_device()() };
 			return re;
 		}
 	}
 
+	// seeds the engine used by random() on the calling thread, for repeatable results
+	inline void random_seed(uint64_t seed, uint64_t stream = 0) {
+		detail::random_engine().seed(seed, stream);
+	}
+
 	// return a random value of T in range [lower, upper)
 	template <typename T, typename P>
 	inline T random(P lower, P upper) {
@@ -5951,6 +6649,115 @@ namespace cgra {
 		std::hash<T> h;
 		return seed ^ (h(x) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
 	}
+
+	namespace detail {
+
+		// wyhash constants
+		constexpr uint64_t hash_p0 = 0xa0761d6478bd642full;
+		constexpr uint64_t hash_p1 = 0xe7037ed1a0b428dbull;
+		constexpr uint64_t hash_p2 = 0x8ebc6af09c88c6e3ull;
+
+		// 64x64 -> 128-bit multiply, folded to 64 bits
+		inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+			__extension__ typedef unsigned __int128 uint128;
+			const uint128 r = uint128(a) * b;
+			return uint64_t(r) ^ uint64_t(r >> 64);
+#else
+			const uint64_t al = uint32_t(a), ah = a >> 32, bl = uint32_t(b), bh = b >> 32;
+			const uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+			const uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+			const uint64_t lo = (mid << 32) | uint32_t(ll);
+			const uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+			return lo ^ hi;
+#endif
+		}
+
+		// raw bits of the value, with -0 hashed as 0 and every nan the same
+		// (adding 0 turns -0 into 0 without a branch)
+		inline uint32_t hash_bits(float x) {
+			if (x != x) return 0x7fc00000u;
+			x += 0.f;
+			uint32_t b;
+			std::memcpy(&b, &x, sizeof(b));
+			return b;
+		}
+
+		inline uint64_t hash_bits(double x) {
+			if (x != x) return 0x7ff8000000000000ull;
+			x += 0.0;
+			uint64_t b;
+			std::memcpy(&b, &x, sizeof(b));
+			return b;
+		}
+
+		template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+		inline std::conditional_t<(sizeof(T) <= 4), uint32_t, uint64_t> hash_bits(T x) {
+			return std::conditional_t<(sizeof(T) <= 4), uint32_t, uint64_t>(x);
+		}
+
+		// anything else (long double, not_nan etc) goes through std::hash
+		template <typename T, std::enable_if_t<!std::is_integral<T>::value, int> = 0>
+		inline uint64_t hash_bits(const T &x) {
+			return std::hash<T>()(x);
+		}
+
+		// hashes the elements of an array-like value, 32-bit elements are packed two per word
+		template <typename T, size_t N, typename F>
+		inline uint64_t hash_elements(uint64_t seed, F get) {
+			constexpr size_t per_word = sizeof(decltype(hash_bits(std::declval<T>()))) <= 4 ? 2 : 1;
+			constexpr size_t words = (N + per_word - 1) / per_word;
+			uint64_t w[words + 2] = {};
+			for (size_t i = 0; i < N; i++) w[i / per_word] |= uint64_t(hash_bits(get(i))) << (32 * (i % per_word));
+			uint64_t h = seed ^ hash_p0;
+			for (size_t i = 0; i < words; i += 2) h = hash_mum(w[i] ^ hash_p1, w[i + 1] ^ h);
+			return hash_mum(h ^ hash_p1, uint64_t(N) ^ hash_p2);
+		}
+
+	}
+
+	// Fast 64-bit hashes (wyhash-style mixing of the raw bits); equal values
+	// (including 0 and -0) have equal hashes. The std::hash specializations use these
+	template <typename T, std::enable_if_t<std::is_arithmetic<T>::value, int> = 0>
+	inline uint64_t hash64(const T &x, uint64_t seed = 0) {
+		return detail::hash_elements<T, 1>(seed, [&](size_t) { return x; });
+	}
+
+	template <typename T, size_t N>
+	inline uint64_t hash64(const basic_vec<T, N> &v, uint64_t seed = 0) {
+		return detail::hash_elements<T, N>(seed, [&](size_t i) { return v[i]; });
+	}
+
+	template <typename T, size_t Cols, size_t Rows>
+	inline uint64_t hash64(const basic_mat<T, Cols, Rows> &m, uint64_t seed = 0) {
+		return detail::hash_elements<T, Cols * Rows>(seed, [&](size_t i) { return m[i / Rows][i % Rows]; });
+	}
+
+	template <typename T>
+	inline uint64_t hash64(const basic_quat<T> &q, uint64_t seed = 0) {
+		return detail::hash_elements<T, 4>(seed, [&](size_t i) { return i == 0 ? q.w : i == 1 ? q.x : i == 2 ? q.y : q.z; });
+	}
+
+	// hash64 as a function object, the default hash for flat_hash_map/set
+	// other types use std::hash, mixed so identity hashes (e.g. for ints) are usable
+	struct hasher {
+	private:
+		template <typename T>
+		static auto go(const T &x, int) -> decltype(hash64(x)) {
+			return hash64(x);
+		}
+
+		template <typename T>
+		static uint64_t go(const T &x, long) {
+			return hash64(uint64_t(std::hash<T>()(x)));
+		}
+
+	public:
+		template <typename T>
+		uint64_t operator()(const T &x) const {
+			return go(x, 0);
+		}
+	};
 }
 
 namespace std {
@@ -5959,9 +6766,7 @@ namespace std {
 	template <typename T, size_t N>
 	struct hash<cgra::basic_vec<T, N>> {
 		inline size_t operator()(const cgra::basic_vec<T, N> &v) const {
-			// 73: Sheldon Cooper's favorite number
-			// TODO where did ^ come from?
-			return cgra::fold(cgra::hash_combine<T>, 73, v);
+			return size_t(cgra::hash64(v));
 		}
 	};
 
@@ -5969,7 +6774,7 @@ namespace std {
 	template <typename T, size_t Cols, size_t Rows>
 	struct hash<cgra::basic_mat<T, Cols, Rows>> {
 		inline size_t operator()(const cgra::basic_mat<T, Cols, Rows> &m) const {
-			return cgra::fold(cgra::hash_combine<cgra::basic_vec<T, Rows>>, 73, m);
+			return size_t(cgra::hash64(m));
 		}
 	};
 
@@ -5977,7 +6782,7 @@ namespace std {
 	template <typename T>
 	struct hash<cgra::basic_quat<T>> {
 		inline size_t operator()(const cgra::basic_quat<T> &q) const {
-			return cgra::fold(cgra::hash_combine<T>, 73, cgra::basic_vec<T, 4>{q});
+			return size_t(cgra::hash64(q));
 		}
 	};
 }
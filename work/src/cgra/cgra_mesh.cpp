@@ -3,25 +3,34 @@
 #include <stdexcept>
 
 // project
+#include "cgra_cpu_profiler.hpp"
+#include "cgra_gpu_memory.hpp"
 #include "cgra_mesh.hpp"
 
 
 namespace cgra {
 
 	void mesh::draw(bool wireframe) {
+		gl_state &state = gl_state::current();
 		// set wireframe or fill polygon mode
-		glPolygonMode(GL_FRONT_AND_BACK, (wireframe) ? GL_LINE : GL_FILL);
+		state.polygon_mode((wireframe) ? GL_LINE : GL_FILL);
 		// bind our VAO which sets up all our buffers and data for us
-		glBindVertexArray(m_vao);
+		state.bind_vertex_array(m_vao);
 		// tell opengl to draw our VAO using the draw mode and how many verticies to render
 		glDrawElements(m_mode, m_index_count, GL_UNSIGNED_INT, 0); // with indices
 	}
 
 	void mesh::destroy() {
+		// forget the names so the state cache doesn't skip binding reused ones
+		gl_state &state = gl_state::current();
+		state.forget_vertex_array(m_vao);
+		state.forget_buffer(m_vbo);
+		state.forget_buffer(m_ibo);
+
 		// delete the data buffers
 		glDeleteVertexArrays(1, &m_vao);
-		glDeleteBuffers(1, &m_vbo);
-		glDeleteBuffers(1, &m_ibo);
+		gpu_memory::delete_buffers(1, &m_vbo);
+		gpu_memory::delete_buffers(1, &m_ibo);
 	}
 
 
@@ -36,7 +45,8 @@ namespace cgra {
 	{ }
 
 
-	mesh mesh_builder::build(mesh m) {
+	mesh mesh_builder::build(mesh m, const char *owner) {
+		CGRA_ZONE("mesh upload");
 
 		// Create the buffers if they don't exist
 		// VAO stores information about how the VBOs are set up
@@ -66,14 +76,16 @@ namespace cgra {
 
 		// VAO
 		//
-		glBindVertexArray(m.m_vao);
+		gl_state &state = gl_state::current();
+		state.bind_vertex_array(m.m_vao);
 
 		
 		// VBO (single buffer, interleaved)
 		//
-		glBindBuffer(GL_ARRAY_BUFFER, m.m_vbo);
+		state.bind_buffer(GL_ARRAY_BUFFER, m.m_vbo);
 		// Upload ALL the data giving it the size (in bytes) and a pointer to the data
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+		gpu_memory &memory = gpu_memory::current();
+		memory.buffer_data(GL_ARRAY_BUFFER, m.m_vbo, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW, owner);
 
 		// This buffer will use location=0 when we use our VAO
 		glEnableVertexAttribArray(0);
@@ -93,8 +105,8 @@ namespace cgra {
 
 		// IBO
 		//
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.m_ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW);
+		state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m.m_ibo);
+		memory.buffer_data(GL_ELEMENT_ARRAY_BUFFER, m.m_ibo, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW, owner);
 
 
 		// Set the index count and draw modes
@@ -103,8 +115,8 @@ namespace cgra {
 
 		// Clean up by binding 0, good practice
 		// the GL_ELEMENT_ARRAY_BUFFER binding sticks to the VAO so we shouldn't unbind it
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		state.bind_vertex_array(0);
+		state.bind_buffer(GL_ARRAY_BUFFER, 0);
 
 		return m;
 	}
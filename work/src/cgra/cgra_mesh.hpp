@@ -71,7 +71,8 @@ namespace cgra {
 		GLenum & mode() { return m_mode; }
 		const GLenum & mode() const { return m_mode; }
 
-		mesh build(mesh m = {});
+		// owner tags the buffers in gpu_memory
+		mesh build(mesh m = {}, const char *owner = "mesh");
 	};
 
 }
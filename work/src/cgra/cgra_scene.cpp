@@ -0,0 +1,133 @@
+
+// std
+#include <cmath>
+#include <vector>
+
+// project
+#include "cgra_frame_arena.hpp"
+#include "cgra_gl_state.hpp"
+#include "cgra_scene.hpp"
+#include "cgra_transform.hpp"
+
+
+namespace {
+
+	using namespace cgra;
+
+	// planes (xyz = normal pointing inwards, w = distance) of the view
+	// frustum for view_proj, from the rows of the matrix
+	void frustum_planes(const mat4 &view_proj, vec4 planes[6]) {
+		vec4 rows[4];
+		for (int i = 0; i < 4; i++) rows[i] = vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+		for (int i = 0; i < 3; i++) {
+			planes[2 * i] = rows[3] + rows[i];
+			planes[2 * i + 1] = rows[3] - rows[i];
+		}
+	}
+}
+
+
+namespace cgra {
+
+	entity create_renderable(
+		entity_registry &registry,
+		const transform_component &transform,
+		const bounds_component &bounds,
+		mesh *geometry,
+		const material_component &material
+	) {
+		world_component world;
+		world.matrix = trs(transform.translation, transform.rotation, transform.scale);
+		mesh_component m;
+		m.geometry = geometry;
+		return registry.create(transform, world, bounds, m, material, draw_component());
+	}
+
+
+	void update_world_transforms(entity_registry &registry) {
+		registry.each_chunk<const transform_component, world_component>(
+			[](size_t, size_t n, const transform_component *t, world_component *w) {
+				for (size_t i = 0; i < n; i++) w[i].matrix = trs(t[i].translation, t[i].rotation, t[i].scale);
+			}
+		);
+	}
+
+
+	size_t cull_entities(entity_registry &registry, const mat4 &view, const mat4 &proj) {
+		vec4 planes[6];
+		frustum_planes(proj * view, planes);
+
+		frame_vector<size_t> visible(registry.chunk_count<const world_component, const bounds_component, draw_component>());
+		registry.each_chunk<const world_component, const bounds_component, draw_component>(
+			[&](size_t c, size_t n, const world_component *w, const bounds_component *b, draw_component *d) {
+				size_t count = 0;
+				for (size_t i = 0; i < n; i++) {
+					// world space box around the transformed box
+					const mat4 &m = w[i].matrix;
+					const vec3 centre = (b[i].min + b[i].max) * 0.5f;
+					const vec3 half = (b[i].max - b[i].min) * 0.5f;
+					const vec4 wc = m * vec4(centre, 1);
+					const vec3 wh = abs(vec3(m[0])) * half.x + abs(vec3(m[1])) * half.y + abs(vec3(m[2])) * half.z;
+
+					bool inside = true;
+					for (int p = 0; p < 6 && inside; p++) {
+						const vec3 normal(planes[p]);
+						inside = dot(normal, vec3(wc)) + planes[p].w >= -dot(abs(normal), wh);
+					}
+					d[i].visible = inside;
+					if (!inside) continue;
+
+					d[i].modelview = view * m;
+					d[i].depth = -dot(vec4(view[0][2], view[1][2], view[2][2], view[3][2]), wc);
+					count++;
+				}
+				visible[c] = count;
+			}
+		);
+
+		size_t total = 0;
+		for (size_t c : visible) total += c;
+		return total;
+	}
+
+
+	size_t submit_draws(entity_registry &registry, const mat4 &proj, draw_queue &queue) {
+		// packets are made per chunk in parallel (in each worker's frame
+		// arena), then submitted in order
+		frame_vector<frame_vector<draw_packet>> packets(registry.chunk_count<const mesh_component, const material_component, draw_component>());
+		registry.each_chunk<const mesh_component, const material_component, draw_component>(
+			[&](size_t c, size_t n, const mesh_component *m, const material_component *mat, draw_component *d) {
+				frame_vector<draw_packet> &out = packets[c];
+				out.reserve(n);
+				for (size_t i = 0; i < n; i++) {
+					if (!d[i].visible || !m[i].geometry) continue;
+					d[i].geometry = m[i].geometry;
+					d[i].wireframe = mat[i].wireframe;
+
+					draw_packet p;
+					p.program = mat[i].program;
+					p.texture = mat[i].texture;
+					p.polygon_mode = mat[i].wireframe ? GL_LINE : GL_FILL;
+					p.transparent = mat[i].transparent;
+					p.key = draw_queue::make_key(0, p.transparent, p.program, p.texture, d[i].depth);
+					const draw_component *dc = &d[i];
+					const mat4 *pr = &proj;
+					p.draw = [dc, pr](GLuint shader) {
+						glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, pr->data());
+						glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, false, dc->modelview.data());
+						gl_state::current().uniform(glGetUniformLocation(shader, "uTexture0"), 0);
+						dc->geometry->draw(dc->wireframe);
+					};
+					out.push_back(std::move(p));
+				}
+			}
+		);
+
+		size_t total = 0;
+		for (auto &chunk : packets) {
+			total += chunk.size();
+			for (auto &p : chunk) queue.submit(std::move(p));
+		}
+		return total;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+// project
+#include "cgra_draw_queue.hpp"
+#include "cgra_entity.hpp"
+#include "cgra_math.hpp"
+#include "cgra_mesh.hpp"
+
+
+namespace cgra {
+
+	// Components for drawing many objects stored in an entity_registry.
+	// Entities with all six of them (see create_renderable) are drawn by
+	//
+	//     update_world_transforms(registry);
+	//     cull_entities(registry, view, proj);
+	//     submit_draws(registry, proj, queue);
+	//
+	// Each of these streams through the component arrays chunk by chunk,
+	// in parallel.
+
+	// local translation, rotation and scale
+	struct transform_component {
+		vec3 translation{ 0 };
+		quat rotation{ 1 };
+		vec3 scale{ 1 };
+	};
+
+	// written by update_world_transforms
+	struct world_component {
+		mat4 matrix{ 1 };
+	};
+
+	// object space bounding box
+	struct bounds_component {
+		vec3 min{ 0 };
+		vec3 max{ 0 };
+	};
+
+	// the mesh is not owned and must outlive the entity
+	struct mesh_component {
+		mesh *geometry = nullptr;
+	};
+
+	struct material_component {
+		GLuint program = 0;
+		GLuint texture = 0; // bound to unit 0 and uTexture0 if not zero
+		bool wireframe = false;
+		bool transparent = false;
+	};
+
+	// per-frame results, written by cull_entities and submit_draws
+	struct draw_component {
+		mat4 modelview{ 1 };
+		mesh *geometry = nullptr;
+		float depth = 0;
+		bool visible = false;
+		bool wireframe = false;
+	};
+
+
+	entity create_renderable(
+		entity_registry &registry,
+		const transform_component &transform,
+		const bounds_component &bounds,
+		mesh *geometry,
+		const material_component &material
+	);
+
+	// world matrix from each transform_component
+	void update_world_transforms(entity_registry &registry);
+
+	// frustum culls the world space bounding boxes and computes the model/view
+	// matrices and depths of the visible entities, returns how many are visible
+	size_t cull_entities(entity_registry &registry, const mat4 &view, const mat4 &proj);
+
+	// submits a packet for every visible entity, returns how many. The packets
+	// refer to proj and the draw components, so proj must stay alive and the
+	// registry must not be changed until the queue is flushed
+	size_t submit_draws(entity_registry &registry, const mat4 &proj, draw_queue &queue);
+}
@@ -1,16 +1,29 @@
 
 // std
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <stdexcept>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
 // project
+#include "cgra_cpu_profiler.hpp"
 #include "cgra_shader.hpp"
+#include "cgra_startup_profiler.hpp"
 #include <opengl.hpp>
 
 
+// GL_KHR_parallel_shader_compile (GL_ARB_parallel_shader_compile uses the same values)
+// defined here because our version of GLEW predates the extension
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+
 // forward declaration
 class shader_error : public std::runtime_error {
 public:
@@ -60,9 +73,28 @@ void printProgramInfoLog(GLuint obj) {
 }
 
 
+namespace {
+
+	using max_shader_compiler_threads_t = void (APIENTRY *)(GLuint);
+
+	// mask with a bit set for each of n features (n <= 64)
+	uint64_t feature_bits(size_t n) {
+		return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+	}
+
+	bool has_parallel_compile() {
+		static const bool has = glfwExtensionSupported("GL_KHR_parallel_shader_compile")
+			|| glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+		return has;
+	}
+
+}
+
+
 namespace cgra {
 
 	void shader_builder::set_shader(GLenum type, const std::string &filename) {
+		CGRA_ZONE("shader load");
 		std::ifstream fileStream(filename);
 
 		if (!fileStream) {
@@ -72,6 +104,7 @@ namespace cgra {
 
 		std::stringstream buffer;
 		buffer << fileStream.rdbuf();
+		m_bytes_read += buffer.str().size();
 
 		try {
 			set_shader_source(type, buffer.str());
@@ -118,6 +151,8 @@ namespace cgra {
 				break;
 		}
 		oss << "#define " << get_define(type) << std::endl;
+		for (auto &key : m_defines)
+			oss << "#define " << key << std::endl;
 		oss << iss.rdbuf();
 		std::string final_source = oss.str();
 		//
@@ -128,6 +163,13 @@ namespace cgra {
 		glShaderSource(shader, 1, &text_c, nullptr);
 		glCompileShader(shader);
 
+		// deferred builders leave status checks to shader_batch
+		// so we don't block on the driver's compile threads
+		if (m_deferred) {
+			m_shaders[type] = std::make_shared<gl_object>(std::move(shader));
+			return;
+		}
+
 		// check compilation status
 		GLint compile_status;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
@@ -142,6 +184,9 @@ namespace cgra {
 
 		// if the program exists get attached shaders and detach them
 		if (program) {
+			// relinking resets uniforms
+			gl_state::current().forget_program(program);
+
 			int shader_count = 0;
 			glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count);
 
@@ -166,6 +211,9 @@ namespace cgra {
 		// link the program
 		glLinkProgram(program);
 
+		// deferred builders leave status checks to shader_batch
+		if (m_deferred) return program;
+
 		// check link status
 		GLint link_status;
 		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
@@ -175,4 +223,256 @@ namespace cgra {
 		return program;
 	}
 
-}
\ No newline at end of file
+
+
+	bool shader_batch::enable_parallel_compile(GLuint max_threads) {
+		if (!has_parallel_compile()) return false;
+
+		// the KHR and ARB entry points are identical apart from the name
+		auto max_threads_fn = reinterpret_cast<max_shader_compiler_threads_t>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+		if (!max_threads_fn) max_threads_fn = reinterpret_cast<max_shader_compiler_threads_t>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+		if (max_threads_fn) max_threads_fn(max_threads);
+		return true;
+	}
+
+
+	GLuint shader_batch::add(const std::string &filename, std::initializer_list<GLenum> types) {
+		shader_builder prog(true);
+		for (GLenum type : types) {
+			prog.set_shader(type, filename);
+		}
+		return add(filename, prog);
+	}
+
+
+	GLuint shader_batch::add(const std::string &name, shader_builder &prog, GLuint program) {
+		if (!prog.deferred()) throw std::invalid_argument("shader_batch requires a deferred shader_builder");
+
+		entry e;
+		e.name = name;
+		startup_profiler &startup = startup_profiler::current();
+		const double submit_start = startup.now();
+		e.program = program = prog.build(program);
+		startup.record("shader submit " + name, submit_start, startup.now(), prog.bytes_read());
+		for (auto &shader_pair : prog.shaders()) {
+			e.shaders.push_back(shader_pair.second);
+		}
+
+		// rebuilding an existing program replaces its entry
+		auto it = m_index.find(e.program);
+		if (it != m_index.end()) {
+			if (m_entries[it->second].state == status::pending) m_pending--;
+			m_entries[it->second] = std::move(e);
+		}
+		else {
+			m_index[e.program] = m_entries.size();
+			m_entries.push_back(std::move(e));
+		}
+		m_pending++;
+
+		return program;
+	}
+
+
+	void shader_batch::remove(GLuint program) {
+		auto it = m_index.find(program);
+		if (it == m_index.end()) return;
+		const size_t i = it->second;
+		if (m_entries[i].state == status::pending) m_pending--;
+		m_index.erase(it);
+
+		// move the last entry into the gap
+		if (i + 1 != m_entries.size()) {
+			m_entries[i] = std::move(m_entries.back());
+			m_index[m_entries[i].program] = i;
+		}
+		m_entries.pop_back();
+	}
+
+
+	void shader_batch::resolve_entry(entry &e) {
+		startup_profiler &startup = startup_profiler::current();
+		const double status_start = startup.now();
+
+		// these queries block until the driver has finished with the program
+		bool compiled = true;
+		for (auto &shader : e.shaders) {
+			GLint compile_status;
+			glGetShaderiv(*shader, GL_COMPILE_STATUS, &compile_status);
+			printShaderInfoLog(*shader); // print warnings and errors
+			compiled = compiled && compile_status;
+		}
+
+		GLint link_status;
+		glGetProgramiv(e.program, GL_LINK_STATUS, &link_status);
+		printProgramInfoLog(e.program); // print warnings and errors
+
+		if (!compiled || !link_status) {
+			std::cerr << "Error: Could not " << (compiled ? "link " : "compile ") << e.name << std::endl;
+			e.state = status::failed;
+		}
+		else {
+			e.state = status::ready;
+		}
+
+		// the program keeps the compiled shaders alive while attached
+		e.shaders.clear();
+		m_pending--;
+
+		// only the time blocked on the driver, not the frames spent waiting to be
+		// polled (with parallel compile the build finished in the background)
+		startup.record("shader status " + e.name, status_start, startup.now());
+	}
+
+
+	size_t shader_batch::poll(double budget_ms) {
+		CGRA_ZONE("shader poll");
+		if (!m_pending) return 0;
+		const bool parallel = has_parallel_compile();
+		const auto start = std::chrono::steady_clock::now();
+
+		for (auto &e : m_entries) {
+			if (e.state != status::pending) continue;
+
+			if (parallel) {
+				// non-blocking completion query
+				GLint complete = GL_FALSE;
+				glGetProgramiv(e.program, GL_COMPLETION_STATUS_KHR, &complete);
+				if (complete) resolve_entry(e);
+			}
+			else {
+				// no way to query without blocking, so spread the stalls over frames,
+				// resolving at least one program per call
+				resolve_entry(e);
+				if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budget_ms) break;
+			}
+		}
+
+		return m_pending;
+	}
+
+
+	void shader_batch::finish() {
+		for (auto &e : m_entries) {
+			if (e.state == status::pending) resolve_entry(e);
+		}
+	}
+
+
+	shader_batch::status shader_batch::state(GLuint program) const {
+		auto it = m_index.find(program);
+		if (it == m_index.end()) return status::failed;
+		return m_entries[it->second].state;
+	}
+
+
+	shader_variants::shader_variants(
+		const std::string &filename,
+		std::initializer_list<GLenum> types,
+		std::initializer_list<std::string> features,
+		shader_batch *batch
+	) :
+		m_filename(filename),
+		m_types(types),
+		m_features(features),
+		m_batch(batch)
+	{
+		if (m_features.size() > 64) throw std::invalid_argument("shader_variants supports at most 64 features");
+	}
+
+
+	shader_variants::~shader_variants() {
+		for (auto &variant : m_programs) {
+			// the batch would otherwise keep polling the deleted name
+			if (m_batch) m_batch->remove(variant.second);
+			gl_state::current().forget_program(variant.second);
+			glDeleteProgram(variant.second);
+		}
+	}
+
+
+	uint64_t shader_variants::mask(std::initializer_list<std::string> features) const {
+		uint64_t m = 0;
+		for (auto &key : features) {
+			auto it = std::find(m_features.begin(), m_features.end(), key);
+			if (it == m_features.end()) throw std::invalid_argument("Unknown shader feature " + key + " for " + m_filename);
+			m |= uint64_t(1) << (it - m_features.begin());
+		}
+		return m;
+	}
+
+
+	GLuint shader_variants::compile(uint64_t mask) {
+		shader_builder prog(m_batch != nullptr);
+		for (size_t i = 0; i < m_features.size(); i++) {
+			if (mask & (uint64_t(1) << i)) prog.define(m_features[i]);
+		}
+		for (GLenum type : m_types) {
+			prog.set_shader(type, m_filename);
+		}
+
+		GLuint program = 0;
+		if (m_batch) {
+			std::ostringstream name;
+			name << m_filename << " [0x" << std::hex << mask << ']';
+			program = m_batch->add(name.str(), prog);
+		}
+		else {
+			program = prog.build();
+		}
+
+		m_programs[mask] = program;
+		return program;
+	}
+
+
+	GLuint shader_variants::get(uint64_t mask) {
+		// bits past the last feature don't change the program
+		mask &= feature_bits(m_features.size());
+		auto it = m_programs.find(mask);
+		GLuint program = (it == m_programs.end()) ? compile(mask) : it->second;
+		return m_batch ? m_batch->resolve(program) : program;
+	}
+
+
+	void shader_variants::precompile(const std::vector<uint64_t> &masks) {
+		for (uint64_t mask : masks) {
+			mask &= feature_bits(m_features.size());
+			if (!m_programs.count(mask)) compile(mask);
+		}
+	}
+
+
+	std::vector<uint64_t> shader_variants::used() const {
+		std::vector<uint64_t> masks;
+		for (auto &variant : m_programs) {
+			masks.push_back(variant.first);
+		}
+		std::sort(masks.begin(), masks.end());
+		return masks;
+	}
+
+
+	void shader_variants::save_used(const std::string &filename) const {
+		std::ofstream fileStream(filename);
+		if (!fileStream) {
+			std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+			return;
+		}
+		for (uint64_t mask : used()) {
+			fileStream << mask << std::endl;
+		}
+	}
+
+
+	void shader_variants::precompile_used(const std::string &filename) {
+		// a missing file just means nothing has been recorded yet
+		std::ifstream fileStream(filename);
+		std::vector<uint64_t> masks;
+		uint64_t mask;
+		while (fileStream >> mask) {
+			masks.push_back(mask);
+		}
+		precompile(masks);
+	}
+}
@@ -1,10 +1,13 @@
-
 #pragma once
 
 // std
+#include <initializer_list>
 #include <map>
 #include <memory>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 // project
 #include <opengl.hpp>
@@ -15,13 +18,143 @@ namespace cgra {
 	class shader_builder {
 	private:
 		std::map<GLenum, std::shared_ptr<gl_object>> m_shaders;
+		std::vector<std::string> m_defines;
+		bool m_deferred = false;
+		size_t m_bytes_read = 0;
 
 	public:
 		shader_builder() { }
+
+		// a deferred builder submits compile and link work to the driver
+		// without querying the status, status is checked by shader_batch
+		explicit shader_builder(bool deferred) : m_deferred(deferred) { }
+
+		// adds a "#define <key>" to every shader set after this call
+		void define(const std::string &key) { m_defines.push_back(key); }
+
 		void set_shader(GLenum type, const std::string &filename);
 		void set_shader_source(GLenum type, const std::string &shadersource);
 
 		GLuint build(GLuint program = 0);
+
+		const std::map<GLenum, std::shared_ptr<gl_object>> & shaders() const { return m_shaders; }
+		bool deferred() const { return m_deferred; }
+
+		// total size of the files read by set_shader
+		size_t bytes_read() const { return m_bytes_read; }
 	};
 
-}
\ No newline at end of file
+
+	// Builds many shader programs without serializing on the driver.
+	// Every shader and program is submitted before any status is queried
+	// and completion is polled (without blocking when the driver supports
+	// GL_KHR_parallel_shader_compile) over the following frames. Programs
+	// that are not ready yet resolve to a fallback program.
+	class shader_batch {
+	public:
+		enum class status { pending, ready, failed };
+
+	private:
+		struct entry {
+			std::string name;
+			GLuint program = 0;
+			std::vector<std::shared_ptr<gl_object>> shaders;
+			status state = status::pending;
+		};
+
+		std::vector<entry> m_entries;
+		std::map<GLuint, size_t> m_index;
+		GLuint m_fallback = 0;
+		size_t m_pending = 0;
+
+		void resolve_entry(entry &e);
+
+	public:
+		shader_batch() { }
+
+		// enables driver side parallel compilation (if available) for the current context
+		// returns true if GL_KHR_parallel_shader_compile (or the ARB variant) is supported
+		static bool enable_parallel_compile(GLuint max_threads = 0xFFFFFFFF);
+
+		// program to use for anything that is not ready (or failed)
+		GLuint fallback() const { return m_fallback; }
+		void fallback(GLuint program) { m_fallback = program; }
+
+		// helper for the common case of a single multi-stage source file
+		// the builder is created deferred and the program is submitted
+		GLuint add(const std::string &filename, std::initializer_list<GLenum> types);
+
+		// submits a deferred builder and returns the (not yet usable) program name
+		GLuint add(const std::string &name, shader_builder &prog, GLuint program = 0);
+
+		// forgets a program (before it is deleted), it then resolves to the fallback
+		void remove(GLuint program);
+
+		// checks completion of pending programs, call once per frame
+		// without parallel compile support, programs are resolved (blocking)
+		// until budget_ms has been spent, but always at least one per call
+		// returns the number of programs still pending
+		size_t poll(double budget_ms = 2);
+
+		// blocks until every program has been resolved
+		void finish();
+
+		status state(GLuint program) const;
+		bool ready(GLuint program) const { return state(program) == status::ready; }
+		size_t pending() const { return m_pending; }
+		size_t size() const { return m_entries.size(); }
+
+		// returns the program if it is ready, otherwise the fallback program
+		GLuint resolve(GLuint program) const { return ready(program) ? program : m_fallback; }
+	};
+
+
+
+	// A single shader file compiled under many combinations of feature
+	// defines (textured, instanced, skinned etc.). Each feature is a bit in
+	// a 64-bit mask and each variant is compiled on first use. If a batch is
+	// given, variants are compiled through it and resolve to its fallback
+	// program until ready.
+	class shader_variants {
+	private:
+		std::string m_filename;
+		std::vector<GLenum> m_types;
+		std::vector<std::string> m_features;
+		std::unordered_map<uint64_t, GLuint> m_programs;
+		shader_batch *m_batch = nullptr;
+
+		GLuint compile(uint64_t mask);
+
+	public:
+		shader_variants(
+			const std::string &filename,
+			std::initializer_list<GLenum> types,
+			std::initializer_list<std::string> features,
+			shader_batch *batch = nullptr
+		);
+
+		// disable copy constructors (programs are owned by this object)
+		shader_variants(const shader_variants &) = delete;
+		shader_variants & operator=(const shader_variants &) = delete;
+
+		~shader_variants();
+
+		// returns the mask for the given feature keys
+		// throws std::invalid_argument for unknown keys
+		uint64_t mask(std::initializer_list<std::string> features) const;
+
+		// returns the program for the variant, compiling it if needed
+		GLuint get(uint64_t mask);
+		GLuint get(std::initializer_list<std::string> features) { return get(mask(features)); }
+
+		// warm-up: compiles every given variant that hasn't been compiled yet
+		void precompile(const std::vector<uint64_t> &masks);
+
+		// masks of every variant used so far, for saving and precompiling in later runs
+		std::vector<uint64_t> used() const;
+		void save_used(const std::string &filename) const;
+		void precompile_used(const std::string &filename);
+
+		const std::vector<std::string> & features() const { return m_features; }
+	};
+}
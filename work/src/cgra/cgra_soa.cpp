@@ -0,0 +1,291 @@
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// project
+#include "cgra_jobs.hpp"
+#include "cgra_soa.hpp"
+
+
+namespace cgra {
+
+	namespace soa {
+
+		namespace {
+
+			// elements per chunk, also the grain for splitting across threads
+			constexpr size_t chunk_size = 4096;
+
+			// the kernels are written once against these lane helpers and run
+			// with float4 (4 elements at a time) and float (the remainder)
+#ifdef CGRA_SIMD_SSE2
+			struct float4 { __m128 v; };
+
+			inline float4 operator+(float4 a, float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+			inline float4 operator-(float4 a, float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+			inline float4 operator*(float4 a, float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+			inline float4 operator/(float4 a, float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+			inline float4 lane_sqrt(float4 a) { return { _mm_sqrt_ps(a.v) }; }
+			inline float4 load(float4, const float *p) { return { _mm_loadu_ps(p) }; }
+			inline float4 splat(float4, float x) { return { _mm_set1_ps(x) }; }
+			inline void store(float *p, float4 a) { _mm_storeu_ps(p, a.v); }
+#endif
+
+			inline float lane_sqrt(float a) { return std::sqrt(a); }
+			inline float load(float, const float *p) { return *p; }
+			inline float splat(float, float x) { return x; }
+			inline void store(float *p, float a) { *p = a; }
+
+			// integer lanes for the random number kernels, uint4 goes with float4
+#ifdef CGRA_SIMD_SSE2
+			struct uint4 { __m128i v; };
+
+			inline uint4 operator^(uint4 a, uint4 b) { return { _mm_xor_si128(a.v, b.v) }; }
+			inline uint4 splat(uint4, uint32_t x) { return { _mm_set1_epi32(int(x)) }; }
+			inline uint4 lane_index(float4, size_t i) { return { _mm_add_epi32(_mm_set1_epi32(int(uint32_t(i))), _mm_set_epi32(3, 2, 1, 0)) }; }
+
+			// high and low words of the 64-bit products m * a
+			inline void mul_hi_lo(uint32_t m, uint4 a, uint4 &hi, uint4 &lo) {
+				const __m128i mm = _mm_set1_epi32(int(m));
+				const __m128i even = _mm_mul_epu32(a.v, mm);
+				const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), mm);
+				lo.v = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+				hi.v = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+			}
+
+			// same as detail::random_unit, the top 24 bits fit in a signed int
+			inline float4 lane_unit(uint4 a) {
+				return { _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(a.v, 8)), _mm_set1_ps(1.f / 16777216.f)) };
+			}
+
+			// stores lane k at p[k * stride]
+			inline void store_strided(float *p, size_t stride, float4 a) {
+				alignas(16) float t[4];
+				_mm_store_ps(t, a.v);
+				for (size_t k = 0; k < 4; k++) p[k * stride] = t[k];
+			}
+#endif
+
+			inline uint32_t splat(uint32_t, uint32_t x) { return x; }
+			inline uint32_t lane_index(float, size_t i) { return uint32_t(i); }
+
+			inline void mul_hi_lo(uint32_t m, uint32_t a, uint32_t &hi, uint32_t &lo) {
+				const uint64_t p = uint64_t(m) * a;
+				hi = uint32_t(p >> 32);
+				lo = uint32_t(p);
+			}
+
+			inline float lane_unit(uint32_t a) { return detail::random_unit(a); }
+			inline void store_strided(float *p, size_t, float a) { *p = a; }
+
+			// calls f(lane, i) for every i in [begin, end), 4 at a time where possible
+			template <typename F>
+			void simd_range(size_t begin, size_t end, F &f) {
+				size_t i = begin;
+#ifdef CGRA_SIMD_SSE2
+				for (; i + 4 <= end; i += 4) f(float4{}, i);
+#endif
+				for (; i < end; i++) f(0.f, i);
+			}
+
+			// calls f(chunk, begin, end) for each chunk of [0, n), in parallel for large n
+			template <typename F>
+			void parallel_chunks(size_t n, F f) {
+				const size_t chunks = (n + chunk_size - 1) / chunk_size;
+				auto range = [&](size_t begin, size_t end) {
+					for (size_t c = begin; c < end; c++) f(c, c * chunk_size, std::min(n, (c + 1) * chunk_size));
+				};
+				if (n >= soa_parallel_threshold) parallel_for(0, chunks, 1, range);
+				else range(0, chunks);
+			}
+
+			// runs a per-element kernel over [0, n)
+			template <typename F>
+			void parallel_simd(size_t n, F f) {
+				parallel_chunks(n, [&](size_t, size_t begin, size_t end) { simd_range(begin, end, f); });
+			}
+
+			// philox4x32::block(seed, i) for the elements i, i + 1... in the lanes of t
+			// (i is a multiple of 4 for float4, so the high word is the same for every lane)
+			template <typename T>
+			auto philox_lanes(T t, size_t i, uint64_t seed) {
+				using U = decltype(lane_index(t, i));
+				U c[4] = { lane_index(t, i), splat(U(), uint32_t(uint64_t(i) >> 32)), splat(U(), 0), splat(U(), 0) };
+				uint32_t k0 = uint32_t(seed), k1 = uint32_t(seed >> 32);
+				for (int r = 0; r < 10; r++) {
+					if (r > 0) {
+						k0 += 0x9e3779b9u;
+						k1 += 0xbb67ae85u;
+					}
+					U hi0, lo0, hi1, lo1;
+					mul_hi_lo(0xd2511f53u, c[0], hi0, lo0);
+					mul_hi_lo(0xcd9e8d57u, c[2], hi1, lo1);
+					c[0] = hi1 ^ c[1] ^ splat(U(), k0);
+					c[1] = lo1;
+					c[2] = hi0 ^ c[3] ^ splat(U(), k1);
+					c[3] = lo0;
+				}
+				return std::array<U, 4>{{ c[0], c[1], c[2], c[3] }};
+			}
+
+			// calls store(k, i, t, value) for the first dims components of each element
+			template <typename F>
+			void random_kernel(size_t n, int dims, const float *lower, const float *upper, uint64_t seed, F store) {
+				parallel_simd(n, [&](auto t, size_t i) {
+					const auto words = philox_lanes(t, i, seed);
+					for (int k = 0; k < dims; k++) {
+						const auto a = splat(t, lower[k]);
+						store(k, i, t, a + (splat(t, upper[k]) - a) * lane_unit(words[k]));
+					}
+				});
+			}
+
+			// m * (x, y, z, w) for w = 0 or 1, the w row is not computed
+			template <bool Point>
+			void transform3(const mat4 &m, const vec3_soa &in, vec3_soa &out) {
+				out.resize(in.size());
+				const float *ix = in.x(), *iy = in.y(), *iz = in.z();
+				float *ox = out.x(), *oy = out.y(), *oz = out.z();
+				parallel_simd(in.size(), [&](auto t, size_t i) {
+					const auto x = load(t, ix + i), y = load(t, iy + i), z = load(t, iz + i);
+					auto rx = splat(t, m[0][0]) * x + splat(t, m[1][0]) * y + splat(t, m[2][0]) * z;
+					auto ry = splat(t, m[0][1]) * x + splat(t, m[1][1]) * y + splat(t, m[2][1]) * z;
+					auto rz = splat(t, m[0][2]) * x + splat(t, m[1][2]) * y + splat(t, m[2][2]) * z;
+					if (Point) {
+						rx = rx + splat(t, m[3][0]);
+						ry = ry + splat(t, m[3][1]);
+						rz = rz + splat(t, m[3][2]);
+					}
+					store(ox + i, rx);
+					store(oy + i, ry);
+					store(oz + i, rz);
+				});
+			}
+		}
+
+
+		void transform_points(const mat4 &m, const vec3_soa &in, vec3_soa &out) {
+			transform3<true>(m, in, out);
+		}
+
+
+		void transform_directions(const mat4 &m, const vec3_soa &in, vec3_soa &out) {
+			transform3<false>(m, in, out);
+		}
+
+
+		void transform(const mat4 &m, const vec4_soa &in, vec4_soa &out) {
+			out.resize(in.size());
+			const float *ix = in.x(), *iy = in.y(), *iz = in.z(), *iw = in.w();
+			float *o[4] = { out.x(), out.y(), out.z(), out.w() };
+			parallel_simd(in.size(), [&](auto t, size_t i) {
+				const auto x = load(t, ix + i), y = load(t, iy + i), z = load(t, iz + i), w = load(t, iw + i);
+				for (int r = 0; r < 4; r++) {
+					store(o[r] + i, splat(t, m[0][r]) * x + splat(t, m[1][r]) * y + splat(t, m[2][r]) * z + splat(t, m[3][r]) * w);
+				}
+			});
+		}
+
+
+		void normalize(const vec3_soa &in, vec3_soa &out) {
+			out.resize(in.size());
+			const float *ix = in.x(), *iy = in.y(), *iz = in.z();
+			float *ox = out.x(), *oy = out.y(), *oz = out.z();
+			parallel_simd(in.size(), [&](auto t, size_t i) {
+				const auto x = load(t, ix + i), y = load(t, iy + i), z = load(t, iz + i);
+				const auto l = lane_sqrt(x * x + y * y + z * z);
+				store(ox + i, x / l);
+				store(oy + i, y / l);
+				store(oz + i, z / l);
+			});
+		}
+
+
+		void dot(const vec3_soa &a, const vec3_soa &b, std::vector<float> &out) {
+			out.resize(a.size());
+			float *o = out.data();
+			parallel_simd(a.size(), [&](auto t, size_t i) {
+				store(o + i, load(t, a.x() + i) * load(t, b.x() + i) + load(t, a.y() + i) * load(t, b.y() + i) + load(t, a.z() + i) * load(t, b.z() + i));
+			});
+		}
+
+
+		void cross(const vec3_soa &a, const vec3_soa &b, vec3_soa &out) {
+			out.resize(a.size());
+			float *ox = out.x(), *oy = out.y(), *oz = out.z();
+			parallel_simd(a.size(), [&](auto t, size_t i) {
+				const auto ax = load(t, a.x() + i), ay = load(t, a.y() + i), az = load(t, a.z() + i);
+				const auto bx = load(t, b.x() + i), by = load(t, b.y() + i), bz = load(t, b.z() + i);
+				store(ox + i, ay * bz - az * by);
+				store(oy + i, az * bx - ax * bz);
+				store(oz + i, ax * by - ay * bx);
+			});
+		}
+
+
+		void random_fill(vec3_soa &v, const vec3 &lower, const vec3 &upper, uint64_t seed) {
+			float *o[3] = { v.x(), v.y(), v.z() };
+			random_kernel(v.size(), 3, lower.data(), upper.data(), seed, [&](int k, size_t i, auto, auto x) { store(o[k] + i, x); });
+		}
+
+
+		void random_fill(vec4_soa &v, const vec4 &lower, const vec4 &upper, uint64_t seed) {
+			float *o[4] = { v.x(), v.y(), v.z(), v.w() };
+			random_kernel(v.size(), 4, lower.data(), upper.data(), seed, [&](int k, size_t i, auto, auto x) { store(o[k] + i, x); });
+		}
+
+
+		void random_fill(vec3 *data, size_t n, const vec3 &lower, const vec3 &upper, uint64_t seed) {
+			float *o = data->data();
+			random_kernel(n, 3, lower.data(), upper.data(), seed, [&](int k, size_t i, auto, auto x) { store_strided(o + 3 * i + k, 3, x); });
+		}
+
+
+		bool min_max(const vec3_soa &v, vec3 &lo, vec3 &hi) {
+			if (v.empty()) return false;
+			const size_t chunks = (v.size() + chunk_size - 1) / chunk_size;
+			std::vector<vec3> chunk_lo(chunks), chunk_hi(chunks);
+			const float *p[3] = { v.x(), v.y(), v.z() };
+
+			// reduce each chunk, then the (few) chunk results
+			parallel_chunks(v.size(), [&](size_t c, size_t begin, size_t end) {
+				for (int k = 0; k < 3; k++) {
+					float l = p[k][begin], h = p[k][begin];
+					size_t i = begin;
+#ifdef CGRA_SIMD_SSE2
+					__m128 l4 = _mm_set1_ps(l), h4 = l4;
+					for (; i + 4 <= end; i += 4) {
+						const __m128 x = _mm_loadu_ps(p[k] + i);
+						l4 = _mm_min_ps(l4, x);
+						h4 = _mm_max_ps(h4, x);
+					}
+					alignas(16) float ls[4], hs[4];
+					_mm_store_ps(ls, l4);
+					_mm_store_ps(hs, h4);
+					l = std::min(std::min(ls[0], ls[1]), std::min(ls[2], ls[3]));
+					h = std::max(std::max(hs[0], hs[1]), std::max(hs[2], hs[3]));
+#endif
+					for (; i < end; i++) {
+						l = std::min(l, p[k][i]);
+						h = std::max(h, p[k][i]);
+					}
+					chunk_lo[c][k] = l;
+					chunk_hi[c][k] = h;
+				}
+			});
+
+			lo = chunk_lo[0];
+			hi = chunk_hi[0];
+			for (size_t c = 1; c < chunks; c++) {
+				lo = min(lo, chunk_lo[c]);
+				hi = max(hi, chunk_hi[c]);
+			}
+			return true;
+		}
+
+	}
+}
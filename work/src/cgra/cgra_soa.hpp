@@ -0,0 +1,199 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <vector>
+
+// project
+#include "cgra_math.hpp"
+
+
+namespace cgra {
+
+	// the types and kernels live in their own namespace (found by ADL) so the
+	// kernel overloads don't hide cgra::normalize etc. from qualified lookup
+	namespace soa {
+
+		// Structure-of-arrays storage for many vec3s (positions, normals, particle
+		// and instance data) so the bulk kernels below can process 4 elements per
+		// SIMD instruction. Converts losslessly to and from std::vector<vec3> and
+		// any vertex type with a vec3 member, e.g.
+		//
+		//    vec3_soa positions(builder.vertices());               // vertex::pos
+		//    vec3_soa normals(builder.vertices(), &vertex::norm);
+		//    transform_points(model, positions, positions);
+		//    positions.store(builder.vertices());
+		class vec3_soa {
+		private:
+			std::vector<float> m_x, m_y, m_z;
+
+		public:
+			vec3_soa() { }
+			explicit vec3_soa(size_t n) : m_x(n), m_y(n), m_z(n) { }
+
+			explicit vec3_soa(const std::vector<vec3> &v) : vec3_soa(v.size()) {
+				for (size_t i = 0; i < v.size(); i++) set(i, v[i]);
+			}
+
+			template <typename VertexT>
+			explicit vec3_soa(const std::vector<VertexT> &v, vec3 VertexT::*member = &VertexT::pos) : vec3_soa(v.size()) {
+				for (size_t i = 0; i < v.size(); i++) set(i, v[i].*member);
+			}
+
+			size_t size() const { return m_x.size(); }
+			bool empty() const { return m_x.empty(); }
+
+			void resize(size_t n) {
+				m_x.resize(n);
+				m_y.resize(n);
+				m_z.resize(n);
+			}
+
+			void push_back(const vec3 &v) {
+				m_x.push_back(v.x);
+				m_y.push_back(v.y);
+				m_z.push_back(v.z);
+			}
+
+			vec3 get(size_t i) const { return vec3(m_x[i], m_y[i], m_z[i]); }
+
+			void set(size_t i, const vec3 &v) {
+				m_x[i] = v.x;
+				m_y[i] = v.y;
+				m_z[i] = v.z;
+			}
+
+			float * x() { return m_x.data(); }
+			float * y() { return m_y.data(); }
+			float * z() { return m_z.data(); }
+			const float * x() const { return m_x.data(); }
+			const float * y() const { return m_y.data(); }
+			const float * z() const { return m_z.data(); }
+
+			std::vector<vec3> to_vector() const {
+				std::vector<vec3> v(size());
+				for (size_t i = 0; i < v.size(); i++) v[i] = get(i);
+				return v;
+			}
+
+			// writes into the given member of each vertex, resizing the vector if needed
+			template <typename VertexT>
+			void store(std::vector<VertexT> &v, vec3 VertexT::*member = &VertexT::pos) const {
+				v.resize(size());
+				for (size_t i = 0; i < v.size(); i++) v[i].*member = get(i);
+			}
+		};
+
+
+		// Structure-of-arrays storage for many vec4s, see vec3_soa
+		class vec4_soa {
+		private:
+			std::vector<float> m_x, m_y, m_z, m_w;
+
+		public:
+			vec4_soa() { }
+			explicit vec4_soa(size_t n) : m_x(n), m_y(n), m_z(n), m_w(n) { }
+
+			explicit vec4_soa(const std::vector<vec4> &v) : vec4_soa(v.size()) {
+				for (size_t i = 0; i < v.size(); i++) set(i, v[i]);
+			}
+
+			// points (w = 1) or directions (w = 0) from a vec3_soa
+			vec4_soa(const vec3_soa &v, float w) : vec4_soa(v.size()) {
+				std::copy(v.x(), v.x() + v.size(), m_x.begin());
+				std::copy(v.y(), v.y() + v.size(), m_y.begin());
+				std::copy(v.z(), v.z() + v.size(), m_z.begin());
+				std::fill(m_w.begin(), m_w.end(), w);
+			}
+
+			size_t size() const { return m_x.size(); }
+			bool empty() const { return m_x.empty(); }
+
+			void resize(size_t n) {
+				m_x.resize(n);
+				m_y.resize(n);
+				m_z.resize(n);
+				m_w.resize(n);
+			}
+
+			void push_back(const vec4 &v) {
+				m_x.push_back(v.x);
+				m_y.push_back(v.y);
+				m_z.push_back(v.z);
+				m_w.push_back(v.w);
+			}
+
+			vec4 get(size_t i) const { return vec4(m_x[i], m_y[i], m_z[i], m_w[i]); }
+
+			void set(size_t i, const vec4 &v) {
+				m_x[i] = v.x;
+				m_y[i] = v.y;
+				m_z[i] = v.z;
+				m_w[i] = v.w;
+			}
+
+			float * x() { return m_x.data(); }
+			float * y() { return m_y.data(); }
+			float * z() { return m_z.data(); }
+			float * w() { return m_w.data(); }
+			const float * x() const { return m_x.data(); }
+			const float * y() const { return m_y.data(); }
+			const float * z() const { return m_z.data(); }
+			const float * w() const { return m_w.data(); }
+
+			std::vector<vec4> to_vector() const {
+				std::vector<vec4> v(size());
+				for (size_t i = 0; i < v.size(); i++) v[i] = get(i);
+				return v;
+			}
+		};
+
+
+		// Bulk kernels. Outputs are resized to match the input and may be the
+		// same object as an input. Arrays larger than soa_parallel_threshold are
+		// split across threads with parallel_for (see cgra_jobs.hpp).
+		constexpr size_t soa_parallel_threshold = 1 << 15;
+
+		// out = m * (p, 1), the w result is dropped (no perspective divide)
+		void transform_points(const mat4 &m, const vec3_soa &in, vec3_soa &out);
+
+		// out = m * (d, 0), i.e. the upper 3x3 only
+		void transform_directions(const mat4 &m, const vec3_soa &in, vec3_soa &out);
+
+		// out = m * v
+		void transform(const mat4 &m, const vec4_soa &in, vec4_soa &out);
+
+		void normalize(const vec3_soa &in, vec3_soa &out);
+
+		void dot(const vec3_soa &a, const vec3_soa &b, std::vector<float> &out);
+
+		void cross(const vec3_soa &a, const vec3_soa &b, vec3_soa &out);
+
+		// Fills v (at its current size) with uniform random values in [lower, upper).
+		// Element i is made from block i of philox4x32(seed), so the values only
+		// depend on the seed (not the number of threads) and element i is the same as
+		//
+		//    philox4x32 g(seed);
+		//    g.seek(i);
+		//    uniform_vec_distribution<float, 3>({lower, upper})(g);
+		void random_fill(vec3_soa &v, const vec3 &lower, const vec3 &upper, uint64_t seed);
+		void random_fill(vec4_soa &v, const vec4 &lower, const vec4 &upper, uint64_t seed);
+
+		// the same values for an array of vec3 (e.g. particle positions)
+		void random_fill(vec3 *data, size_t n, const vec3 &lower, const vec3 &upper, uint64_t seed);
+
+		inline void random_fill(std::vector<vec3> &v, const vec3 &lower, const vec3 &upper, uint64_t seed) {
+			random_fill(v.data(), v.size(), lower, upper, seed);
+		}
+
+		// component-wise min and max of every element (for an AABB)
+		// returns false (and leaves lo and hi unchanged) if v is empty
+		bool min_max(const vec3_soa &v, vec3 &lo, vec3 &hi);
+
+	}
+
+	using soa::vec3_soa;
+	using soa::vec4_soa;
+	using soa::soa_parallel_threshold;
+	using soa::random_fill;
+}
@@ -0,0 +1,127 @@
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// project
+#include "cgra_startup_profiler.hpp"
+
+
+namespace {
+
+	std::string escape_json(std::string s) {
+		for (size_t p = 0; (p = s.find_first_of("\"\\", p)) != std::string::npos; p += 2) s.insert(p, 1, '\\');
+		return s;
+	}
+}
+
+
+namespace cgra {
+
+	startup_profiler & startup_profiler::current() {
+		static startup_profiler profiler;
+		return profiler;
+	}
+
+
+	void startup_profiler::record(std::string name, double begin, double end, uint64_t bytes) {
+		const bool main = std::this_thread::get_id() == m_main_thread;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ((m_first_frame >= 0 && begin > m_first_frame + settle_ms) || m_phases.size() >= max_phases) {
+			m_dropped++;
+			return;
+		}
+		m_phases.push_back({ std::move(name), begin, end, bytes, main });
+	}
+
+
+	void startup_profiler::first_frame() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_first_frame < 0) m_first_frame = now();
+	}
+
+
+	double startup_profiler::first_frame_time() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_first_frame;
+	}
+
+
+	size_t startup_profiler::dropped() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_dropped;
+	}
+
+
+	std::vector<startup_profiler::phase> startup_profiler::phases() const {
+		std::vector<phase> phases;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			phases = m_phases;
+		}
+		std::stable_sort(phases.begin(), phases.end(), [](const phase &a, const phase &b) { return a.begin < b.begin; });
+		return phases;
+	}
+
+
+	void startup_profiler::print(std::ostream &out) const {
+		const std::vector<phase> phases = this->phases();
+		const double first_frame = first_frame_time();
+
+		size_t width = 5;
+		for (auto &p : phases) width = std::max(width, p.name.size());
+
+		char buf[512];
+		std::snprintf(buf, sizeof(buf), "%-*s %10s %10s %12s  %s\n", int(width), "phase", "start ms", "wall ms", "bytes read", "thread");
+		out << "Startup phases" << std::endl << buf;
+
+		uint64_t bytes = 0;
+		for (auto &p : phases) {
+			std::snprintf(buf, sizeof(buf), "%-*s %10.2f %10.2f %12llu  %s\n",
+				int(width), p.name.c_str(), p.begin, p.end - p.begin, (unsigned long long) p.bytes, p.main_thread ? "main" : "worker");
+			out << buf;
+			bytes += p.bytes;
+		}
+
+		// phases overlap (and nest), so the wall times do not add up
+		std::snprintf(buf, sizeof(buf), "%zu phases, %llu bytes read", phases.size(), (unsigned long long) bytes);
+		out << buf;
+		if (first_frame >= 0) {
+			std::snprintf(buf, sizeof(buf), ", first frame at %.2f ms", first_frame);
+			out << buf;
+		}
+		if (const size_t n = dropped()) out << ", " << n << " phases not recorded";
+		out << std::endl;
+	}
+
+
+	bool startup_profiler::write_json(const std::string &filename) const {
+		std::ofstream out(filename);
+		if (!out) {
+			std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+			return false;
+		}
+
+		const std::vector<phase> phases = this->phases();
+		uint64_t bytes = 0;
+		for (auto &p : phases) bytes += p.bytes;
+
+		char buf[512];
+		std::snprintf(buf, sizeof(buf), "{\n\t\"first_frame_ms\": %.3f,\n\t\"bytes_read\": %llu,\n\t\"dropped_phases\": %zu,\n\t\"phases\": [",
+			first_frame_time(), (unsigned long long) bytes, dropped());
+		out << buf;
+		for (size_t i = 0; i < phases.size(); i++) {
+			const phase &p = phases[i];
+			std::snprintf(buf, sizeof(buf),
+				"%s\n\t\t{ \"name\": \"%s\", \"start_ms\": %.3f, \"wall_ms\": %.3f, \"bytes_read\": %llu, \"thread\": \"%s\" }",
+				i ? "," : "", escape_json(p.name).c_str(), p.begin, p.end - p.begin, (unsigned long long) p.bytes, p.main_thread ? "main" : "worker");
+			out << buf;
+		}
+		out << "\n\t]\n}" << std::endl;
+
+		std::cout << "Wrote startup report: " << filename << std::endl;
+		return bool(out);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace cgra {
+
+	// Wall time and bytes read for each phase of startup: window and context
+	// creation, shader builds, asset decodes and uploads, and the first frame.
+	// Phases can be recorded from any thread. Times are milliseconds since the
+	// profiler was created, so create it (with current) first thing in main.
+	//
+	// Loads that finish shortly after the first frame are still part of
+	// startup, but later ones (hot reloads, streaming) are not, so phases that
+	// start more than settle_ms after the first frame are dropped, as are any
+	// beyond max_phases.
+	class startup_profiler {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static constexpr double settle_ms = 10000;
+		static constexpr size_t max_phases = 4096;
+
+		struct phase {
+			std::string name;
+			double begin;
+			double end;
+			uint64_t bytes;
+			bool main_thread;
+		};
+
+	private:
+		clock::time_point m_epoch = clock::now();
+		std::thread::id m_main_thread = std::this_thread::get_id();
+
+		mutable std::mutex m_mutex;
+		std::vector<phase> m_phases;
+		double m_first_frame = -1;
+		size_t m_dropped = 0;
+
+		startup_profiler() { }
+
+	public:
+		startup_profiler(const startup_profiler &) = delete;
+		startup_profiler & operator=(const startup_profiler &) = delete;
+
+		static startup_profiler & current();
+
+		double now() const {
+			return std::chrono::duration<double, std::milli>(clock::now() - m_epoch).count();
+		}
+
+		void record(std::string name, double begin, double end, uint64_t bytes = 0);
+
+		// marks the first frame as presented, phases that end later (such as
+		// uploads and shader builds that finish after it) are still recorded
+		// until the settle time has passed
+		void first_frame();
+
+		// time to the first frame, or negative until it is presented
+		double first_frame_time() const;
+
+		// sorted by start time
+		std::vector<phase> phases() const;
+
+		// phases that were not recorded because they came too late or too many
+		size_t dropped() const;
+
+		// table of every phase with totals
+		void print(std::ostream &out) const;
+
+		// returns false if the file could not be written
+		bool write_json(const std::string &filename) const;
+	};
+
+
+	// RAII phase, recorded when it goes out of scope
+	class startup_phase {
+	private:
+		std::string m_name;
+		double m_begin;
+		uint64_t m_bytes = 0;
+
+	public:
+		explicit startup_phase(std::string name) : m_name(std::move(name)), m_begin(startup_profiler::current().now()) { }
+
+		startup_phase(const startup_phase &) = delete;
+		startup_phase & operator=(const startup_phase &) = delete;
+
+		~startup_phase() {
+			startup_profiler &p = startup_profiler::current();
+			p.record(std::move(m_name), m_begin, p.now(), m_bytes);
+		}
+
+		void add_bytes(uint64_t bytes) { m_bytes += bytes; }
+	};
+}
@@ -0,0 +1,209 @@
+
+// std
+#include <algorithm>
+#include <atomic>
+
+// project
+#include "cgra_jobs.hpp"
+#include "cgra_transform.hpp"
+
+
+namespace {
+
+	// v[i] = old v[order[i]]
+	template <typename T>
+	void permute(std::vector<T> &v, const std::vector<uint32_t> &order) {
+		std::vector<T> r;
+		r.reserve(order.size());
+		for (uint32_t i : order) r.push_back(v[i]);
+		v = std::move(r);
+	}
+}
+
+
+namespace cgra {
+
+	void transform_hierarchy::reserve(size_t n) {
+		m_node.reserve(n);
+		m_parent.reserve(n);
+		m_translation.reserve(n);
+		m_rotation.reserve(n);
+		m_scale.reserve(n);
+		m_world.reserve(n);
+		m_dirty.reserve(n);
+		m_changed.reserve(n);
+		m_destroyed.reserve(n);
+		m_slot_of.reserve(n);
+		m_generation.reserve(n);
+	}
+
+
+	void transform_hierarchy::clear() {
+		*this = transform_hierarchy();
+	}
+
+
+	transform_hierarchy::node transform_hierarchy::create(node parent, const vec3 &t, const quat &r, const vec3 &s) {
+		const uint32_t p = parent == npos ? no_slot : slot_checked(parent);
+		uint32_t index;
+		if (m_free_nodes.empty()) {
+			index = uint32_t(m_slot_of.size());
+			m_slot_of.push_back(0);
+			m_generation.push_back(0);
+		} else {
+			index = m_free_nodes.back();
+			m_free_nodes.pop_back();
+		}
+		const node n = (node(m_generation[index]) << 32) | index;
+		// appended after its parent, so slot order stays parents first
+		// even before the next rebuild sorts by depth
+		m_slot_of[index] = uint32_t(m_node.size());
+		m_node.push_back(n);
+		m_parent.push_back(p);
+		m_translation.push_back(t);
+		m_rotation.push_back(r);
+		m_scale.push_back(s);
+		m_world.push_back(mat4(1));
+		m_dirty.push_back(1);
+		m_changed.push_back(0);
+		m_destroyed.push_back(0);
+		m_any_dirty = true;
+		m_structure_dirty = true;
+		return n;
+	}
+
+
+	void transform_hierarchy::destroy(node n) {
+		// descendants are found and removed by the next rebuild
+		m_destroyed[slot_checked(n)] = 1;
+		m_structure_dirty = true;
+	}
+
+
+	void transform_hierarchy::set_local(node n, const vec3 &t, const quat &r, const vec3 &s) {
+		const uint32_t i = slot_checked(n);
+		m_translation[i] = t;
+		m_rotation[i] = r;
+		m_scale[i] = s;
+		mark_dirty(i);
+	}
+
+
+	mat4 transform_hierarchy::local(node n) const {
+		const uint32_t i = slot_checked(n);
+		return trs(m_translation[i], m_rotation[i], m_scale[i]);
+	}
+
+
+	void transform_hierarchy::rebuild() {
+		const size_t n = m_node.size();
+
+		// parents come before their children, so one pass propagates
+		// destruction and depth down the tree
+		std::vector<uint32_t> depth(n, 0);
+		uint32_t max_depth = 0;
+		for (size_t i = 0; i < n; i++) {
+			const uint32_t p = m_parent[i];
+			if (p == no_slot) continue;
+			m_destroyed[i] |= m_destroyed[p];
+			depth[i] = depth[p] + 1;
+			max_depth = std::max(max_depth, depth[i]);
+		}
+
+		// stable counting sort of the remaining slots by depth
+		m_level_begin.assign(max_depth + 2, 0);
+		for (size_t i = 0; i < n; i++) {
+			if (!m_destroyed[i]) m_level_begin[depth[i] + 1]++;
+		}
+		for (size_t d = 1; d < m_level_begin.size(); d++) m_level_begin[d] += m_level_begin[d - 1];
+		std::vector<uint32_t> next(m_level_begin.begin(), m_level_begin.end() - 1);
+		std::vector<uint32_t> order(m_level_begin.back());
+		std::vector<uint32_t> new_slot(n, no_slot);
+		for (size_t i = 0; i < n; i++) {
+			if (m_destroyed[i]) {
+				const uint32_t index = index_of(m_node[i]);
+				m_slot_of[index] = no_slot;
+				m_generation[index]++;
+				m_free_nodes.push_back(index);
+				continue;
+			}
+			const uint32_t j = next[depth[i]]++;
+			order[j] = uint32_t(i);
+			new_slot[i] = j;
+		}
+		while (m_level_begin.size() > 1 && m_level_begin[m_level_begin.size() - 2] == m_level_begin.back()) {
+			m_level_begin.pop_back();
+		}
+
+		permute(m_node, order);
+		permute(m_parent, order);
+		permute(m_translation, order);
+		permute(m_rotation, order);
+		permute(m_scale, order);
+		permute(m_world, order);
+		for (uint32_t &p : m_parent) {
+			if (p != no_slot) p = new_slot[p];
+		}
+		for (size_t i = 0; i < m_node.size(); i++) m_slot_of[index_of(m_node[i])] = uint32_t(i);
+
+		// every slot may have moved, so everything is written out again
+		m_dirty.assign(m_node.size(), 1);
+		m_changed.assign(m_node.size(), 0);
+		m_destroyed.assign(m_node.size(), 0);
+		m_any_dirty = true;
+		m_structure_dirty = false;
+	}
+
+
+	void transform_hierarchy::update_slot(size_t i, mat4 *out) {
+		const uint32_t p = m_parent[i];
+		const bool changed = m_dirty[i] || (p != no_slot && m_changed[p]);
+		m_changed[i] = changed;
+		m_dirty[i] = 0;
+		if (!changed) return;
+		const mat4 l = trs(m_translation[i], m_rotation[i], m_scale[i]);
+		m_world[i] = p == no_slot ? l : m_world[p] * l;
+		if (out) out[i] = m_world[i];
+	}
+
+
+	size_t transform_hierarchy::update(mat4 *out) {
+		if (m_structure_dirty) rebuild();
+		if (!m_any_dirty) {
+			// nothing was recomputed, but the changed flags are from the last update
+			if (m_changed_begin != m_changed_end) std::fill(m_changed.begin(), m_changed.end(), 0);
+			m_changed_begin = m_changed_end = 0;
+			return 0;
+		}
+
+		// nodes in a level only depend on the level above, so each level
+		// is split across threads
+		size_t count = 0;
+		for (size_t d = 0; d + 1 < m_level_begin.size(); d++) {
+			std::atomic<size_t> level_count{ 0 };
+			auto range = [&](size_t begin, size_t end) {
+				size_t n = 0;
+				for (size_t i = begin; i < end; i++) {
+					update_slot(i, out);
+					n += m_changed[i];
+				}
+				level_count.fetch_add(n, std::memory_order_relaxed);
+			};
+			const size_t begin = m_level_begin[d];
+			const size_t end = m_level_begin[d + 1];
+			if (end - begin >= parallel_threshold) parallel_for(begin, end, parallel_threshold / 4, range);
+			else range(begin, end);
+			count += level_count;
+		}
+
+		m_changed_begin = m_changed_end = 0;
+		if (count) {
+			const auto first = std::find(m_changed.begin(), m_changed.end(), 1);
+			const auto last = std::find(m_changed.rbegin(), m_changed.rend(), 1);
+			m_changed_begin = size_t(first - m_changed.begin());
+			m_changed_end = size_t(m_changed.rend() - last);
+		}
+		m_any_dirty = false;
+		return count;
+	}
+}
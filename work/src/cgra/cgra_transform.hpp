@@ -0,0 +1,148 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// project
+#include "cgra_math.hpp"
+
+
+namespace cgra {
+
+	// translate * rotate * scale, with r a unit quaternion
+	inline mat4 trs(const vec3 &t, const quat &r, const vec3 &s) {
+		mat4 m{r};
+		m[0] *= s.x;
+		m[1] *= s.y;
+		m[2] *= s.z;
+		m[3] = vec4(t, 1);
+		return m;
+	}
+
+
+	// Scene graph of local translation/rotation/scale transforms with lazily
+	// updated world matrices. Nodes are stored in flat arrays sorted by depth
+	// (parents always before their children), so update() walks memory linearly
+	// one level at a time and each level is updated in parallel. Only nodes that
+	// were changed since the last update, and their descendants, are recomputed.
+	//
+	// The world matrices are indexed by slot, which is the index a node's
+	// matrix should have in a per-instance buffer, e.g.
+	//
+	//     hierarchy.update(mapped_instance_buffer);
+	//     auto [begin, end] = hierarchy.changed_range();
+	//
+	// writes only the changed matrices. Slots change when nodes are created or
+	// destroyed, in which case the following update() rewrites every matrix.
+	//
+	// A node is an index in the low 32 bits and a generation in the high 32
+	// bits. Indices are reused once a destroyed node is removed, but with the
+	// next generation, so old handles stop being valid instead of referring
+	// to the new node.
+	class transform_hierarchy {
+	public:
+		using node = uint64_t;
+		static constexpr node npos = node(-1);
+
+		// levels with at least this many nodes are updated in parallel
+		static constexpr size_t parallel_threshold = 4096;
+
+	private:
+		// parent of a root, and slot of a removed node
+		static constexpr uint32_t no_slot = uint32_t(-1);
+
+		// per slot
+		std::vector<node> m_node;
+		std::vector<uint32_t> m_parent;
+		std::vector<vec3> m_translation;
+		std::vector<quat> m_rotation;
+		std::vector<vec3> m_scale;
+		std::vector<mat4> m_world;
+		std::vector<uint8_t> m_dirty;
+		std::vector<uint8_t> m_changed;
+		std::vector<uint8_t> m_destroyed;
+
+		// [m_level_begin[d], m_level_begin[d + 1]) are the slots at depth d
+		std::vector<uint32_t> m_level_begin;
+
+		// per node index
+		std::vector<uint32_t> m_slot_of;
+		std::vector<uint32_t> m_generation;
+		std::vector<uint32_t> m_free_nodes;
+
+		bool m_any_dirty = false;
+		bool m_structure_dirty = false;
+		size_t m_changed_begin = 0;
+		size_t m_changed_end = 0;
+
+		void rebuild();
+		void update_slot(size_t i, mat4 *out);
+
+		static uint32_t index_of(node n) { return uint32_t(n); }
+		static uint32_t generation_of(node n) { return uint32_t(n >> 32); }
+
+		bool alive(node n) const {
+			const uint32_t i = index_of(n);
+			return i < m_slot_of.size() && m_slot_of[i] != no_slot && m_generation[i] == generation_of(n);
+		}
+
+		uint32_t slot_checked(node n) const {
+			assert(alive(n));
+			return m_slot_of[index_of(n)];
+		}
+
+		void mark_dirty(uint32_t i) {
+			m_dirty[i] = 1;
+			m_any_dirty = true;
+		}
+
+	public:
+		transform_hierarchy() { }
+
+		// number of slots, including destroyed nodes until the next update()
+		size_t size() const { return m_node.size(); }
+		bool empty() const { return m_node.empty(); }
+		void reserve(size_t n);
+		void clear();
+
+		// parent may be npos for a root
+		node create(node parent = npos, const vec3 &t = vec3(0), const quat &r = quat(1), const vec3 &s = vec3(1));
+
+		// destroys n and all of its descendants
+		void destroy(node n);
+
+		// false for npos and for destroyed nodes, even once their index is reused
+		bool valid(node n) const { return alive(n) && !m_destroyed[m_slot_of[index_of(n)]]; }
+		node parent(node n) const { const uint32_t p = m_parent[slot_checked(n)]; return p == no_slot ? npos : m_node[p]; }
+		size_t slot(node n) const { return slot_checked(n); }
+
+		const vec3 & translation(node n) const { return m_translation[slot_checked(n)]; }
+		const quat & rotation(node n) const { return m_rotation[slot_checked(n)]; }
+		const vec3 & scale(node n) const { return m_scale[slot_checked(n)]; }
+
+		void set_translation(node n, const vec3 &t) { const uint32_t i = slot_checked(n); m_translation[i] = t; mark_dirty(i); }
+		void set_rotation(node n, const quat &r) { const uint32_t i = slot_checked(n); m_rotation[i] = r; mark_dirty(i); }
+		void set_scale(node n, const vec3 &s) { const uint32_t i = slot_checked(n); m_scale[i] = s; mark_dirty(i); }
+		void set_local(node n, const vec3 &t, const quat &r, const vec3 &s);
+
+		// local transform as a matrix (translate * rotate * scale)
+		mat4 local(node n) const;
+
+		// valid after update()
+		const mat4 & world(node n) const { return m_world[slot_checked(n)]; }
+		const mat4 * world_matrices() const { return m_world.data(); }
+
+		// recomputes the world matrices of changed nodes and their descendants,
+		// also writing them to out[slot] if out is not null (out must hold size()
+		// matrices), and returns how many were recomputed
+		size_t update(mat4 *out = nullptr);
+
+		// slots recomputed by the last update(), as [begin, end)
+		std::pair<size_t, size_t> changed_range() const { return { m_changed_begin, m_changed_end }; }
+		bool changed(node n) const { return m_changed[slot_checked(n)]; }
+	};
+}
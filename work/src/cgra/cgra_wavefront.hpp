@@ -8,12 +8,15 @@
 #include <vector>
 
 // project
+#include "cgra_cpu_profiler.hpp"
+#include "cgra_flat_hash.hpp"
 #include "cgra_mesh.hpp"
 
 
 namespace cgra {
 
 	inline mesh_builder load_wavefront_data(const std::string &filename) {
+		CGRA_ZONE("load_wavefront_data");
 
 		// struct for storing wavefront index data
 		struct wavefront_vertex {
@@ -151,17 +154,21 @@ namespace cgra {
 			}
 		}
 
-		// create mesh data
+		// create mesh data, corners with the same indices share a vertex
 		std::vector<vertex> vertices;
 		std::vector<unsigned int> indices;
-
-		for (unsigned int i = 0; i < wv_vertices.size(); ++i) {
-			indices.push_back(i);
-			vertices.emplace_back(
-				positions[wv_vertices[i].p],
-				normals[wv_vertices[i].n],
-				uvs[wv_vertices[i].t]
-			);
+		flat_hash_map<uvec3, unsigned int> vertex_ids(positions.size());
+
+		for (const wavefront_vertex &wv : wv_vertices) {
+			auto r = vertex_ids.try_emplace(uvec3(wv.p, wv.n, wv.t), unsigned(vertices.size()));
+			if (r.second) {
+				vertices.emplace_back(
+					positions[wv.p],
+					normals[wv.n],
+					uvs[wv.t]
+				);
+			}
+			indices.push_back(r.first->second);
 		}
 
 		return mesh_builder(vertices, indices, GL_TRIANGLES);
@@ -1,13 +1,26 @@
 
 // std
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <stdexcept>
 
 // project
 #include "application.hpp"
+#include "benchmark.hpp"
 #include "opengl.hpp"
+#include "cgra/cgra_cpu_profiler.hpp"
+#include "cgra/cgra_frame_arena.hpp"
+#include "cgra/cgra_gpu_memory.hpp"
+#include "cgra/cgra_gpu_profiler.hpp"
 #include "cgra/cgra_gui.hpp"
+#include "cgra/cgra_image.hpp"
+#include "cgra/cgra_jobs.hpp"
+#include "cgra/cgra_shader.hpp"
+#include "cgra/cgra_startup_profiler.hpp"
 
 
 using namespace std;
@@ -16,6 +29,24 @@ using namespace cgra;
 
 // forward decleration for cleanliness
 namespace {
+	// command line options
+	struct options {
+		bool headless = false; // render offscreen without input or GUI
+		int width = 800;
+		int height = 600;
+		int frames = 100; // frames to render in headless mode
+		string dump; // file prefix for writing headless frames as png
+		string scene = "teapot";
+		bool benchmark = false; // headless, scripted camera, timed frames
+		int warmup = 30; // benchmark frames before measuring
+		string json; // file for benchmark results
+		string startup_json; // file for the startup phase report
+	};
+
+	options parseOptions(int argc, char **argv);
+	void reportFirstFrame(const char *phase, double begin);
+	void renderHeadless(Application &application, const options &opts, chrono::steady_clock::time_point load_start);
+
 	void cursorPosCallback(GLFWwindow *, double xpos, double ypos);
 	void mouseButtonCallback(GLFWwindow *win, int button, int action, int mods);
 	void scrollCallback(GLFWwindow *win, double xoffset, double yoffset);
@@ -31,13 +62,30 @@ namespace {
 
 // main program
 // 
-int main() {
+int main(int argc, char **argv) {
+	// startup phases are timed from here
+	startup_profiler &startup = startup_profiler::current();
+
+	// read command line options
+	options opts = parseOptions(argc, argv);
+
+	// start the worker threads, this becomes the job system's main thread
+	job_system::current();
+
+	// startup runs as a dependency graph:
+	//   texture decode, mesh parse (workers)      -> uploads (main thread jobs)
+	//   window, context, GLEW, ImGui (main thread) -> fallback shader -> first frame
+	// the uploads run in the first frames (or finishLoading) once both are done,
+	// and the other shaders compile on the driver's threads meanwhile
+	Application::preload();
 
 	// initialize the GLFW library
+	double phase_start = startup.now();
 	if (!glfwInit()) {
 		cerr << "Error: Could not initialize GLFW" << endl;
 		abort(); // unrecoverable error
 	}
+	startup.record("glfwInit", phase_start, startup.now());
 
 	// force OpenGL to create a 3.3 core context
 	const char* glsl_version = "#version 330 core";
@@ -56,8 +104,13 @@ int main() {
 	// remove this for possible GL performance increases
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 
+	// headless mode uses a hidden window just for the context
+	// (use Xvfb and LIBGL_ALWAYS_SOFTWARE=1 on machines without a display or GPU)
+	glfwWindowHint(GLFW_VISIBLE, !opts.headless);
+
 	// create a windowed mode window and its OpenGL context
-	GLFWwindow *window = glfwCreateWindow(800, 600, "Hello World!", nullptr, nullptr);
+	phase_start = startup.now();
+	GLFWwindow *window = glfwCreateWindow(opts.width, opts.height, "Hello World!", nullptr, nullptr);
 	if (!window) {
 		cerr << "Error: Could not create GLFW window" << endl;
 		abort(); // unrecoverable error
@@ -66,15 +119,18 @@ int main() {
 	// make the window's context current.
 	// if we have multiple windows we will need to switch contexts
 	glfwMakeContextCurrent(window);
+	startup.record("context creation", phase_start, startup.now());
 
 	// initialize GLEW
 	// must be done after making a GL context current (glfwMakeContextCurrent in this case)
 	glewExperimental = GL_TRUE; // required for full GLEW functionality for OpenGL 3.0+
+	phase_start = startup.now();
 	GLenum err = glewInit();
 	if (GLEW_OK != err) { // problem: glewInit failed, something is seriously wrong.
 		cerr << "Error: " << glewGetErrorString(err) << endl;
 		abort(); // unrecoverable error
 	}
+	startup.record("glewInit", phase_start, startup.now());
 
 	// print out our OpenGL versions
 	cout << "Using OpenGL " << glGetString(GL_VERSION) << endl;
@@ -94,7 +150,16 @@ int main() {
 		cout << "GL_ARB_debug_output not available. No worries." << endl;
 	}
 
+	// let the driver compile shaders on its own threads if it can
+	if (shader_batch::enable_parallel_compile()) {
+		cout << "GL_KHR_parallel_shader_compile enabled" << endl;
+	}
+	else {
+		cout << "GL_KHR_parallel_shader_compile not available. No worries." << endl;
+	}
+
 	// initialize ImGui
+	phase_start = startup.now();
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -105,45 +170,98 @@ int main() {
 	ImGui::StyleColorsDark();
 	//ImGui::StyleColorsClassic();
 
-	// Setup Platform/Renderer bindings
-	if (!ImGui_ImplGlfw_InitForOpenGL(window, true) || !ImGui_ImplOpenGL3_Init(glsl_version)) {
+	// Setup Platform/Renderer bindings (no input in headless mode)
+	if (!ImGui_ImplGlfw_InitForOpenGL(window, !opts.headless) || !ImGui_ImplOpenGL3_Init(glsl_version)) {
 		cerr << "Error: Could not initialize ImGui" << endl;
 		abort(); // unrecoverable error
 	}
+	startup.record("ImGui init", phase_start, startup.now());
 
 	// attach input callbacks to window
-	glfwSetCursorPosCallback(window, cursorPosCallback);
-	glfwSetMouseButtonCallback(window, mouseButtonCallback);
-	glfwSetScrollCallback(window, scrollCallback);
-	glfwSetKeyCallback(window, keyCallback);
-	glfwSetCharCallback(window, charCallback);
+	if (!opts.headless) {
+		glfwSetCursorPosCallback(window, cursorPosCallback);
+		glfwSetMouseButtonCallback(window, mouseButtonCallback);
+		glfwSetScrollCallback(window, scrollCallback);
+		glfwSetKeyCallback(window, keyCallback);
+		glfwSetCharCallback(window, charCallback);
+	}
 
 	
 	// create the application object (and a global pointer to it)
+	auto load_start = chrono::steady_clock::now();
+	phase_start = startup.now();
 	Application application(window);
 	application_ptr = &application;
+	if (!application.setScene(opts.scene)) {
+		cerr << "Error: Unknown scene " << opts.scene << endl;
+		abort(); // unrecoverable error
+	}
+	startup.record("Application constructor", phase_start, startup.now());
+
+	// render a fixed number of frames offscreen
+	if (opts.headless) {
+		renderHeadless(application, opts, load_start);
+	}
 
 	// loop until the user closes the window
-	while (!glfwWindowShouldClose(window)) {
+	while (!opts.headless && !glfwWindowShouldClose(window)) {
+
+		// GPU timing for everything in the frame
+		gpu_profiler::current().begin_frame();
 
 		// main Render
-		application.render();
+		{
+			CGRA_ZONE("render");
+			application.render();
+		}
 
 		// GUI Render on top
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-		application.renderGUI();
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		{
+			CGRA_ZONE("gui build");
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
+			application.renderGUI();
+		}
+		{
+			CGRA_ZONE("ImGui::Render");
+			CGRA_GPU_SCOPE("imgui");
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
+		gpu_profiler::current().end_frame();
 
 		// swap front and back buffers
-		glfwSwapBuffers(window);
+		{
+			CGRA_ZONE("glfwSwapBuffers");
+			double swap_start = startup.now();
+			glfwSwapBuffers(window);
+			reportFirstFrame("first glfwSwapBuffers", swap_start);
+		}
+
+		// frame boundary for the redundant state counters
+		gl_state::current().end_frame();
+
+		// frees the transient allocations of the frame before this one
+		frame_arena::current().end_frame();
 
 		// poll for and process events
-		glfwPollEvents();
+		{
+			CGRA_ZONE("glfwPollEvents");
+			glfwPollEvents();
+		}
+
+		// frame boundary for the CPU profiler
+		cpu_profiler::current().end_frame();
 	}
 
+	// where the startup time went (including loads that finished after the first frame)
+	startup.print(cout);
+	if (!opts.startup_json.empty()) startup.write_json(opts.startup_json);
+
+	// clean up profiler queries while the context exists
+	gpu_profiler::current().shutdown();
+
 	// clean up ImGui
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -157,6 +275,183 @@ int main() {
 
 namespace {
 
+	void printUsage(const char *exe) {
+		cout << "Usage: " << exe << " [options]" << endl;
+		cout << "  --headless       render offscreen without a visible window, input or GUI" << endl;
+		cout << "  --size WxH       framebuffer size (default 800x600)" << endl;
+		cout << "  --frames N       frames to render in headless mode (default 100)" << endl;
+		cout << "  --dump PREFIX    write each headless frame to PREFIX_NNNN.png" << endl;
+		cout << "  --scene NAME     teapot, textured, wireframe or debug (default teapot)" << endl;
+		cout << "  --benchmark      headless run along a scripted camera path with timed frames" << endl;
+		cout << "  --warmup N       benchmark frames before measuring (default 30)" << endl;
+		cout << "  --json FILE      write benchmark results and samples to FILE" << endl;
+		cout << "  --startup FILE   write the startup phase report (JSON) to FILE" << endl;
+	}
+
+
+	options parseOptions(int argc, char **argv) {
+		options opts;
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+			char x;
+			if (arg == "--headless") {
+				opts.headless = true;
+			}
+			else if (arg == "--size" && has_value) {
+				istringstream iss(argv[++i]);
+				if (!(iss >> opts.width >> x >> opts.height) || x != 'x' || opts.width <= 0 || opts.height <= 0) {
+					cerr << "Error: Invalid size " << argv[i] << endl;
+					exit(EXIT_FAILURE);
+				}
+			}
+			else if (arg == "--frames" && has_value) {
+				istringstream iss(argv[++i]);
+				if (!(iss >> opts.frames) || iss >> x || opts.frames < 1) {
+					cerr << "Error: Invalid frame count " << argv[i] << endl;
+					exit(EXIT_FAILURE);
+				}
+			}
+			else if (arg == "--dump" && has_value) {
+				opts.dump = argv[++i];
+			}
+			else if (arg == "--scene" && has_value) {
+				opts.scene = argv[++i];
+			}
+			else if (arg == "--benchmark") {
+				opts.benchmark = true;
+				opts.headless = true;
+			}
+			else if (arg == "--warmup" && has_value) {
+				istringstream iss(argv[++i]);
+				if (!(iss >> opts.warmup) || iss >> x || opts.warmup < 0) {
+					cerr << "Error: Invalid warmup frame count " << argv[i] << endl;
+					exit(EXIT_FAILURE);
+				}
+			}
+			else if (arg == "--json" && has_value) {
+				opts.json = argv[++i];
+			}
+			else if (arg == "--startup" && has_value) {
+				opts.startup_json = argv[++i];
+			}
+			else {
+				if (arg != "--help") cerr << "Error: Unknown option " << arg << endl;
+				printUsage(argv[0]);
+				exit(arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE);
+			}
+		}
+		return opts;
+	}
+
+
+	// records the phase that presented the first frame and prints the time to it,
+	// does nothing after the first call
+	void reportFirstFrame(const char *phase, double begin) {
+		startup_profiler &startup = startup_profiler::current();
+		if (startup.first_frame_time() >= 0) return;
+		startup.record(phase, begin, startup.now());
+		startup.first_frame();
+		cout << "Time to first frame: " << fixed << setprecision(1) << startup.first_frame_time() << " ms" << defaultfloat << endl;
+	}
+
+
+	void renderHeadless(Application &application, const options &opts, chrono::steady_clock::time_point load_start) {
+		const int w = opts.width, h = opts.height;
+
+		// offscreen framebuffer with colour and depth renderbuffers
+		gl_object fbo = gl_object::gen_framebuffer();
+		gl_object color = gl_object::gen_renderbuffer();
+		gl_object depth = gl_object::gen_renderbuffer();
+		gpu_memory &memory = gpu_memory::current();
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		memory.renderbuffer_storage(color, GL_RGBA8, w, h, "headless framebuffer");
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		memory.renderbuffer_storage(depth, GL_DEPTH_COMPONENT24, w, h, "headless framebuffer");
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			cerr << "Error: Could not create offscreen framebuffer" << endl;
+			abort(); // unrecoverable error
+		}
+
+		// every frame should be the same regardless of compile speed
+		application.setFramebufferSize(w, h);
+		application.finishLoading();
+		glFinish();
+
+		// benchmarks run warm-up frames first, then time every frame
+		Benchmark bench(opts.scene, w, h, opts.benchmark ? opts.warmup : 0, opts.frames);
+		bench.setLoadTime(chrono::duration<double, milli>(chrono::steady_clock::now() - load_start).count());
+		gl_object gpu_timer;
+		if (opts.benchmark) {
+			GLuint q;
+			glGenQueries(1, &q);
+			gpu_timer = gl_object(q, glDeleteQueries);
+		}
+
+		for (int frame = -bench.warmupFrames(); frame < opts.frames; frame++) {
+			if (opts.benchmark) {
+				float pitch, yaw, distance;
+				bench.cameraPath(std::max(frame, 0), pitch, yaw, distance);
+				application.setCamera(pitch, yaw, distance);
+			}
+
+			auto frame_start = chrono::steady_clock::now();
+			double render_start = startup_profiler::current().now();
+			if (opts.benchmark) glBeginQuery(GL_TIME_ELAPSED, gpu_timer);
+			gpu_profiler::current().begin_frame();
+			{
+				CGRA_ZONE("render");
+				application.render();
+			}
+			gpu_profiler::current().end_frame();
+			reportFirstFrame("first headless frame", render_start);
+			if (opts.benchmark) {
+				glEndQuery(GL_TIME_ELAPSED);
+				auto cpu_end = chrono::steady_clock::now();
+
+				// fence so frames don't overlap, the query is then available without stalling
+				glFinish();
+				auto frame_end = chrono::steady_clock::now();
+				GLuint64 gpu_ns = 0;
+				glGetQueryObjectui64v(gpu_timer, GL_QUERY_RESULT, &gpu_ns);
+
+				if (frame >= 0) {
+					bench.addFrame(
+						chrono::duration<double, milli>(cpu_end - frame_start).count(),
+						gpu_ns * 1e-6,
+						chrono::duration<double, milli>(frame_end - frame_start).count()
+					);
+				}
+			}
+
+			// warm-up frames are negative and not part of the output
+			if (!opts.dump.empty() && frame >= 0) {
+				CGRA_ZONE("dump frame");
+				ostringstream filename;
+				filename << opts.dump << '_' << setw(4) << setfill('0') << frame;
+				image4::read_framebuffer(fbo, w, h).write_png(filename.str());
+			}
+
+			gl_state::current().end_frame();
+			frame_arena::current().end_frame();
+			cpu_profiler::current().end_frame();
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		cout << "Rendered " << opts.frames << " headless frames at " << w << "x" << h << endl;
+
+		if (opts.benchmark) {
+			bench.report(cout);
+			if (!opts.json.empty()) bench.writeJson(opts.json);
+		}
+	}
+
+
 	void cursorPosCallback(GLFWwindow *, double xpos, double ypos) {
 		// if not captured then foward to application
 		ImGuiIO& io = ImGui::GetIO();
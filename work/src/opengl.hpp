@@ -12,6 +12,12 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+// state cache for redundant call elimination
+#include "cgra/cgra_gl_state.hpp"
+
+// GPU memory accounting, gl_object deletes storage through it
+#include "cgra/cgra_gpu_memory.hpp"
+
 
 // helper function that draws an empty OpenGL object
 // can be used for shaders that do all the work
@@ -20,9 +26,9 @@ inline void draw_dummy(unsigned instances = 1) {
 	if (vao == 0) {
 		glGenVertexArrays(1, &vao);
 	}
-	glBindVertexArray(vao);
+	// no need to unbind, the next draw binds its own VAO through the state cache
+	cgra::gl_state::current().bind_vertex_array(vao);
 	glDrawArraysInstanced(GL_POINTS, 0, 1, instances);
-	glBindVertexArray(0);
 }
 
 
@@ -102,7 +108,7 @@ public:
 	static gl_object gen_buffer() {
 		GLuint o;
 		glGenBuffers(1, &o);
-		return { o, glDeleteBuffers };
+		return { o, cgra::gpu_memory::delete_buffers };
 	}
 
 	// returns a gl_object with an OpenGL vertex array identifier
@@ -116,7 +122,7 @@ public:
 	static gl_object gen_texture() {
 		GLuint o;
 		glGenTextures(1, &o);
-		return { o, glDeleteTextures };
+		return { o, cgra::gpu_memory::delete_textures };
 	}
 
 	// returns a gl_object with an OpenGL framebuffer identifier
@@ -126,6 +132,13 @@ public:
 		return { o, glDeleteFramebuffers };
 	}
 
+	// returns a gl_object with an OpenGL renderbuffer identifier
+	static gl_object gen_renderbuffer() {
+		GLuint o;
+		glGenRenderbuffers(1, &o);
+		return { o, cgra::gpu_memory::delete_renderbuffers };
+	}
+
 	// returns a gl_object with an OpenGL shader identifier
 	static gl_object gen_shader(GLenum type) {
 		GLuint o = glCreateShader(type);
@@ -0,0 +1,359 @@
+//----------------------------------------------------------------------------
+//
+// Entity system benchmark
+// Times the scene systems (transform update, culling and draw packet
+// generation) over a large number of entities stored in an entity_registry,
+// against the same work done on individually heap-allocated objects. No GL
+// context is needed since the draw queue is never flushed. The JSON output
+// uses the same layout as base --benchmark, so perf_compare can gate
+// regressions.
+//
+//----------------------------------------------------------------------------
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+// project
+#include <cgra/cgra_draw_queue.hpp>
+#include <cgra/cgra_entity.hpp>
+#include <cgra/cgra_frame_arena.hpp>
+#include <cgra/cgra_jobs.hpp>
+#include <cgra/cgra_math.hpp>
+#include <cgra/cgra_scene.hpp>
+#include <cgra/cgra_transform.hpp>
+
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+
+	// one object the way it would be written without the entity system,
+	// each allocated separately
+	struct scene_object {
+		transform_component transform;
+		world_component world;
+		bounds_component bounds;
+		mesh_component mesh;
+		material_component material;
+		draw_component draw;
+	};
+
+
+	struct bench_result {
+		string name;
+		string reference;
+		vector<double> samples;     // ms per pass
+		vector<double> ref_samples;
+		size_t count = 0;           // entities processed, visible or drawn
+		size_t ref_count = 0;
+	};
+
+
+	struct bench_case {
+		string name;
+		function<size_t()> run;
+		function<size_t()> run_ref;
+	};
+
+
+	double mean(const vector<double> &v) {
+		if (v.empty()) return 0;
+		return accumulate(v.begin(), v.end(), 0.0) / v.size();
+	}
+
+
+	double percentile(vector<double> v, double p) {
+		if (v.empty()) return 0;
+		sort(v.begin(), v.end());
+		double rank = p / 100 * (v.size() - 1);
+		size_t lo = size_t(floor(rank)), hi = std::min(lo + 1, v.size() - 1);
+		return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+	}
+
+
+	double timePass(const function<size_t()> &f, size_t &count) {
+		auto start = chrono::steady_clock::now();
+		count = f();
+		auto end = chrono::steady_clock::now();
+		// each pass is a frame for the transient allocations
+		frame_arena::current().end_frame();
+		return chrono::duration<double, milli>(end - start).count();
+	}
+
+
+	// entities scattered through a cube, with the camera looking at it from
+	// outside so about a quarter are culled
+	struct bench_scene {
+		mesh shared_mesh;
+		entity_registry registry;
+		vector<unique_ptr<scene_object>> objects;
+		mat4 view, proj;
+
+		explicit bench_scene(size_t n) {
+			mt19937 rng(1234);
+			uniform_real_distribution<float> dist(-1, 1);
+			auto rnd = [&]() { return dist(rng); };
+
+			view = translate3(0, 0, -150.f) * rotate3x(0.3f) * rotate3y(0.5f);
+			proj = perspective(1.f, 16.f / 9.f, 0.1f, 1000.f);
+
+			// allocations of other sizes in between the objects, as a long
+			// running program would have them, and then shuffled
+			vector<unique_ptr<char[]>> padding;
+
+			for (size_t i = 0; i < n; i++) {
+				transform_component t;
+				t.translation = vec3(rnd(), rnd(), rnd()) * 100.f;
+				t.rotation = normalize(quat(rnd(), rnd(), rnd(), rnd()));
+				t.scale = vec3(rnd() * 0.5f + 1.f);
+				bounds_component b;
+				b.min = vec3(-1);
+				b.max = vec3(1);
+				material_component m;
+				m.program = 1 + i % 4;
+				m.texture = 1 + i % 16;
+				create_renderable(registry, t, b, &shared_mesh, m);
+
+				auto o = make_unique<scene_object>();
+				o->transform = t;
+				o->bounds = b;
+				o->mesh.geometry = &shared_mesh;
+				o->material = m;
+				objects.push_back(move(o));
+				if (i % 3 == 0) padding.emplace_back(new char[96 + i % 200]);
+			}
+			shuffle(objects.begin(), objects.end(), rng);
+		}
+	};
+
+
+	vector<bench_case> makeCases(bench_scene &s) {
+		vector<bench_case> cases;
+
+		cases.push_back({ "update_transforms",
+			[&s]() {
+				update_world_transforms(s.registry);
+				return s.registry.size();
+			},
+			[&s]() {
+				parallel_for(0, s.objects.size(), 4096, [&s](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						scene_object &o = *s.objects[i];
+						o.world.matrix = trs(o.transform.translation, o.transform.rotation, o.transform.scale);
+					}
+				});
+				return s.objects.size();
+			}
+		});
+
+		cases.push_back({ "cull",
+			[&s]() { return cull_entities(s.registry, s.view, s.proj); },
+			[&s]() {
+				// same test as cull_entities
+				const mat4 view_proj = s.proj * s.view;
+				vec4 planes[6];
+				for (int i = 0; i < 3; i++) {
+					const vec4 r3(view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3]);
+					const vec4 ri(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+					planes[2 * i] = r3 + ri;
+					planes[2 * i + 1] = r3 - ri;
+				}
+				atomic<size_t> visible{ 0 };
+				parallel_for(0, s.objects.size(), 4096, [&](size_t begin, size_t end) {
+					size_t count = 0;
+					for (size_t i = begin; i < end; i++) {
+						scene_object &o = *s.objects[i];
+						const mat4 &m = o.world.matrix;
+						const vec3 centre = (o.bounds.min + o.bounds.max) * 0.5f;
+						const vec3 half = (o.bounds.max - o.bounds.min) * 0.5f;
+						const vec4 wc = m * vec4(centre, 1);
+						const vec3 wh = abs(vec3(m[0])) * half.x + abs(vec3(m[1])) * half.y + abs(vec3(m[2])) * half.z;
+						bool inside = true;
+						for (int p = 0; p < 6 && inside; p++) {
+							const vec3 normal(planes[p]);
+							inside = dot(normal, vec3(wc)) + planes[p].w >= -dot(abs(normal), wh);
+						}
+						o.draw.visible = inside;
+						if (!inside) continue;
+						o.draw.modelview = s.view * m;
+						o.draw.depth = -(o.draw.modelview * vec4(centre, 1)).z;
+						count++;
+					}
+					visible += count;
+				});
+				return size_t(visible);
+			}
+		});
+
+		// includes destroying the packets with the queue
+		cases.push_back({ "submit_draws",
+			[&s]() {
+				draw_queue queue;
+				return submit_draws(s.registry, s.proj, queue);
+			},
+			[&s]() {
+				draw_queue queue;
+				for (auto &po : s.objects) {
+					scene_object &o = *po;
+					if (!o.draw.visible) continue;
+					draw_packet p;
+					p.program = o.material.program;
+					p.texture = o.material.texture;
+					p.key = draw_queue::make_key(0, false, p.program, p.texture, o.draw.depth);
+					const scene_object *op = &o;
+					const mat4 *pr = &s.proj;
+					p.draw = [op, pr](GLuint) { (void) op; (void) pr; };
+					queue.submit(move(p));
+				}
+				return queue.size();
+			}
+		});
+
+		return cases;
+	}
+
+
+	bench_result runCase(const bench_case &c, int reps) {
+		bench_result r;
+		r.name = c.name;
+		r.reference = "heap objects";
+
+		// one untimed pass of each to warm the caches
+		c.run();
+		c.run_ref();
+
+		// interleave the two so that clock and thermal changes affect both
+		for (int i = 0; i < reps; i++) {
+			r.samples.push_back(timePass(c.run, r.count));
+			r.ref_samples.push_back(timePass(c.run_ref, r.ref_count));
+		}
+		return r;
+	}
+
+
+	void report(ostream &out, const vector<bench_result> &results) {
+		out << fixed << setprecision(3);
+		out << left << setw(20) << "benchmark" << right << setw(10) << "ms" << setw(10) << "min";
+		out << setw(10) << "ref" << setw(10) << "ratio" << setw(10) << "count" << endl;
+		for (auto &r : results) {
+			double p50 = percentile(r.samples, 50);
+			double ref = percentile(r.ref_samples, 50);
+			out << left << setw(20) << r.name << right << setw(10) << p50;
+			out << setw(10) << *min_element(r.samples.begin(), r.samples.end());
+			out << setw(10) << ref << setw(9) << p50 / ref << 'x';
+			out << setw(10) << r.count;
+			if (r.count != r.ref_count) out << " (reference " << r.ref_count << ")";
+			out << endl;
+		}
+		out << defaultfloat;
+	}
+
+
+	bool writeJson(const string &filename, const vector<bench_result> &results, size_t n, int reps) {
+		ofstream out(filename);
+		if (!out) {
+			cerr << "Error: Could not open file " << filename << " for writing" << endl;
+			return false;
+		}
+
+		auto array = [&](const vector<double> &v) {
+			out << "[";
+			for (size_t i = 0; i < v.size(); i++) out << (i ? ", " : "") << v[i];
+			out << "]";
+		};
+
+		out << setprecision(9);
+		out << "{" << endl;
+		out << "\t\"scene\": \"entities\"," << endl;
+		out << "\t\"size\": " << n << "," << endl;
+		out << "\t\"reps\": " << reps << "," << endl;
+		out << "\t\"timestamp\": " << chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() << "," << endl;
+		out << "\t\"metrics\": {" << endl;
+		for (size_t i = 0; i < results.size(); i++) {
+			auto &r = results[i];
+			out << "\t\t\"" << r.name << "\": {" << endl;
+			out << "\t\t\t\"mean\": " << mean(r.samples) << "," << endl;
+			out << "\t\t\t\"p50\": " << percentile(r.samples, 50) << "," << endl;
+			out << "\t\t\t\"min\": " << *min_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			out << "\t\t\t\"max\": " << *max_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			out << "\t\t\t\"reference\": \"" << r.reference << "\"," << endl;
+			out << "\t\t\t\"ref_p50\": " << percentile(r.ref_samples, 50) << "," << endl;
+			out << "\t\t\t\"ratio\": " << percentile(r.samples, 50) / percentile(r.ref_samples, 50) << "," << endl;
+			out << "\t\t\t\"count\": " << r.count << "," << endl;
+			out << "\t\t\t\"samples\": ";
+			array(r.samples);
+			out << endl << "\t\t}" << (i + 1 < results.size() ? "," : "") << endl;
+		}
+		out << "\t}" << endl << "}" << endl;
+
+		cout << "Wrote benchmark: " << filename << endl;
+		return bool(out);
+	}
+
+
+	void printUsage(const char *exe) {
+		cout << "Usage: " << exe << " [options]" << endl;
+		cout << "  --size N       entities (default 1000000)" << endl;
+		cout << "  --reps N       timed passes per benchmark (default 20)" << endl;
+		cout << "  --filter TEXT  only run benchmarks whose name contains TEXT" << endl;
+		cout << "  --json FILE    write results (compare runs with perf_compare)" << endl;
+	}
+
+}
+
+
+int main(int argc, char **argv) {
+	size_t n = 1000000;
+	int reps = 20;
+	string filter, json;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc) n = size_t(atol(argv[++i]));
+		else if (arg == "--reps" && i + 1 < argc) reps = atoi(argv[++i]);
+		else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--json" && i + 1 < argc) json = argv[++i];
+		else {
+			printUsage(argv[0]);
+			return arg == "--help" ? EXIT_SUCCESS : 2;
+		}
+	}
+	if (n == 0 || reps <= 0) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	auto start = chrono::steady_clock::now();
+	bench_scene scene(n);
+	double setup = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	vector<bench_result> results;
+	for (auto &c : makeCases(scene)) {
+		if (c.name.find(filter) == string::npos) continue;
+		results.push_back(runCase(c, reps));
+	}
+	if (results.empty()) {
+		cerr << "Error: No benchmarks match '" << filter << "'" << endl;
+		return 2;
+	}
+
+	cout << "entities: " << n << " (" << scene.registry.chunk_count<>() << " chunks), " << reps << " passes, setup " << fixed << setprecision(1) << setup << " ms" << defaultfloat << endl;
+	report(cout, results);
+
+	if (!json.empty() && !writeJson(json, results, n, reps)) return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
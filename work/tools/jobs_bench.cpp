@@ -0,0 +1,283 @@
+//----------------------------------------------------------------------------
+//
+// Job system benchmark
+// Measures the overhead of the job system's scheduler: empty jobs, a chain
+// of dependent jobs, tasks against a thread each (std::async) and
+// parallel_for at several grain sizes against a plain loop. The JSON output
+// uses the same layout as base --benchmark, so perf_compare can gate
+// regressions.
+//
+//----------------------------------------------------------------------------
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// project
+#include <cgra/cgra_jobs.hpp>
+
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+
+	struct bench_result {
+		string name;
+		string reference;
+		vector<double> samples;     // ms per pass
+		vector<double> ref_samples;
+		size_t count = 0;           // jobs or elements per pass
+	};
+
+
+	struct bench_case {
+		string name;
+		string reference;
+		size_t count;
+		function<void()> run;
+		function<void()> run_ref;
+	};
+
+
+	double mean(const vector<double> &v) {
+		if (v.empty()) return 0;
+		return accumulate(v.begin(), v.end(), 0.0) / v.size();
+	}
+
+
+	double percentile(vector<double> v, double p) {
+		if (v.empty()) return 0;
+		sort(v.begin(), v.end());
+		double rank = p / 100 * (v.size() - 1);
+		size_t lo = size_t(floor(rank)), hi = std::min(lo + 1, v.size() - 1);
+		return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+	}
+
+
+	double timePass(const function<void()> &f) {
+		auto start = chrono::steady_clock::now();
+		f();
+		auto end = chrono::steady_clock::now();
+		return chrono::duration<double, milli>(end - start).count();
+	}
+
+
+	// a little work per element, so parallel_for has something to split
+	inline float work(float x) {
+		return sqrt(x * x + 1.f) * 0.5f + sin(x) * 0.25f;
+	}
+
+
+	vector<bench_case> makeCases(job_system &js, size_t jobs, vector<float> &data) {
+		vector<bench_case> cases;
+		static atomic<size_t> sink{ 0 };
+
+		// scheduling cost of a job that does nothing (create, submit, run, finish)
+		cases.push_back({ "empty_jobs", "direct calls", jobs,
+			[&js, jobs]() {
+				job_handle root = js.create([]() { });
+				for (size_t i = 0; i < jobs; i++) js.submit(js.create([]() { sink.fetch_add(1, memory_order_relaxed); }, root));
+				js.submit(root);
+				js.wait(root);
+			},
+			[jobs]() {
+				vector<function<void()>> calls(jobs, []() { sink.fetch_add(1, memory_order_relaxed); });
+				for (auto &f : calls) f();
+			}
+		});
+
+		// latency from a job finishing to its continuation starting
+		cases.push_back({ "dependency_chain", "direct calls", jobs / 10,
+			[&js, jobs]() {
+				job_handle last;
+				for (size_t i = 0; i < jobs / 10; i++) last = js.then(last, []() { sink.fetch_add(1, memory_order_relaxed); });
+				js.wait(last);
+			},
+			[jobs]() {
+				vector<function<void()>> calls(jobs / 10, []() { sink.fetch_add(1, memory_order_relaxed); });
+				for (auto &f : calls) f();
+			}
+		});
+
+		// small tasks against starting a thread for each
+		cases.push_back({ "tasks_64", "std::async", 64,
+			[&js]() {
+				vector<job_handle> tasks;
+				for (int i = 0; i < 64; i++) tasks.push_back(js.run([]() { sink.fetch_add(1, memory_order_relaxed); }));
+				for (auto &t : tasks) js.wait(t);
+			},
+			[]() {
+				vector<future<void>> tasks;
+				for (int i = 0; i < 64; i++) tasks.push_back(async(launch::async, []() { sink.fetch_add(1, memory_order_relaxed); }));
+				for (auto &t : tasks) t.get();
+			}
+		});
+
+		// grain size against a single threaded loop
+		for (size_t grain : { size_t(256), size_t(4096), size_t(65536), size_t(0) }) {
+			cases.push_back({ "parallel_for_" + (grain ? to_string(grain) : string("auto")), "loop", data.size(),
+				[&js, &data, grain]() {
+					float *d = data.data();
+					js.parallel_for(0, data.size(), grain, [d](size_t begin, size_t end) {
+						for (size_t i = begin; i < end; i++) d[i] = work(d[i]);
+					});
+				},
+				[&data]() {
+					for (float &x : data) x = work(x);
+				}
+			});
+		}
+
+		return cases;
+	}
+
+
+	bench_result runCase(const bench_case &c, int reps) {
+		bench_result r;
+		r.name = c.name;
+		r.reference = c.reference;
+		r.count = c.count;
+
+		// one untimed pass of each to warm up
+		c.run();
+		c.run_ref();
+
+		// interleave the two so that clock and thermal changes affect both
+		for (int i = 0; i < reps; i++) {
+			r.samples.push_back(timePass(c.run));
+			r.ref_samples.push_back(timePass(c.run_ref));
+		}
+		return r;
+	}
+
+
+	void report(ostream &out, const vector<bench_result> &results) {
+		out << fixed << setprecision(3);
+		out << left << setw(22) << "benchmark" << right << setw(10) << "ms" << setw(10) << "min";
+		out << setw(10) << "ref" << setw(10) << "ratio" << setw(12) << "ns/item" << setw(12) << "reference" << endl;
+		for (auto &r : results) {
+			double p50 = percentile(r.samples, 50);
+			double ref = percentile(r.ref_samples, 50);
+			out << left << setw(22) << r.name << right << setw(10) << p50;
+			out << setw(10) << *min_element(r.samples.begin(), r.samples.end());
+			out << setw(10) << ref << setw(9) << p50 / ref << 'x';
+			out << setw(12) << setprecision(1) << p50 * 1e6 / r.count << setprecision(3);
+			out << "  " << r.reference << endl;
+		}
+		out << defaultfloat;
+	}
+
+
+	bool writeJson(const string &filename, const vector<bench_result> &results, unsigned workers, int reps) {
+		ofstream out(filename);
+		if (!out) {
+			cerr << "Error: Could not open file " << filename << " for writing" << endl;
+			return false;
+		}
+
+		auto array = [&](const vector<double> &v) {
+			out << "[";
+			for (size_t i = 0; i < v.size(); i++) out << (i ? ", " : "") << v[i];
+			out << "]";
+		};
+
+		out << setprecision(9);
+		out << "{" << endl;
+		out << "\t\"scene\": \"jobs\"," << endl;
+		out << "\t\"workers\": " << workers << "," << endl;
+		out << "\t\"reps\": " << reps << "," << endl;
+		out << "\t\"timestamp\": " << chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() << "," << endl;
+		out << "\t\"metrics\": {" << endl;
+		for (size_t i = 0; i < results.size(); i++) {
+			auto &r = results[i];
+			out << "\t\t\"" << r.name << "\": {" << endl;
+			out << "\t\t\t\"mean\": " << mean(r.samples) << "," << endl;
+			out << "\t\t\t\"p50\": " << percentile(r.samples, 50) << "," << endl;
+			out << "\t\t\t\"min\": " << *min_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			out << "\t\t\t\"max\": " << *max_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			out << "\t\t\t\"reference\": \"" << r.reference << "\"," << endl;
+			out << "\t\t\t\"ref_p50\": " << percentile(r.ref_samples, 50) << "," << endl;
+			out << "\t\t\t\"ratio\": " << percentile(r.samples, 50) / percentile(r.ref_samples, 50) << "," << endl;
+			out << "\t\t\t\"count\": " << r.count << "," << endl;
+			out << "\t\t\t\"samples\": ";
+			array(r.samples);
+			out << endl << "\t\t}" << (i + 1 < results.size() ? "," : "") << endl;
+		}
+		out << "\t}" << endl << "}" << endl;
+
+		cout << "Wrote benchmark: " << filename << endl;
+		return bool(out);
+	}
+
+
+	void printUsage(const char *exe) {
+		cout << "Usage: " << exe << " [options]" << endl;
+		cout << "  --workers N    worker threads (default " << job_system::default_workers() << ")" << endl;
+		cout << "  --jobs N       jobs per pass for the empty job benchmarks (default 100000)" << endl;
+		cout << "  --size N       elements for the parallel_for benchmarks (default 4000000)" << endl;
+		cout << "  --reps N       timed passes per benchmark (default 20)" << endl;
+		cout << "  --filter TEXT  only run benchmarks whose name contains TEXT" << endl;
+		cout << "  --json FILE    write results (compare runs with perf_compare)" << endl;
+	}
+
+}
+
+
+int main(int argc, char **argv) {
+	unsigned workers = job_system::default_workers();
+	size_t jobs = 100000;
+	size_t n = 4000000;
+	int reps = 20;
+	string filter, json;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--workers" && i + 1 < argc) workers = unsigned(atoi(argv[++i]));
+		else if (arg == "--jobs" && i + 1 < argc) jobs = size_t(atol(argv[++i]));
+		else if (arg == "--size" && i + 1 < argc) n = size_t(atol(argv[++i]));
+		else if (arg == "--reps" && i + 1 < argc) reps = atoi(argv[++i]);
+		else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--json" && i + 1 < argc) json = argv[++i];
+		else {
+			printUsage(argv[0]);
+			return arg == "--help" ? EXIT_SUCCESS : 2;
+		}
+	}
+	if (jobs < 10 || n == 0 || reps <= 0) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	job_system js(workers);
+	vector<float> data(n);
+	for (size_t i = 0; i < n; i++) data[i] = float(i % 1000) * 0.001f;
+
+	vector<bench_result> results;
+	for (auto &c : makeCases(js, jobs, data)) {
+		if (c.name.find(filter) == string::npos) continue;
+		results.push_back(runCase(c, reps));
+	}
+	if (results.empty()) {
+		cerr << "Error: No benchmarks match '" << filter << "'" << endl;
+		return 2;
+	}
+
+	cout << "workers: " << js.workers() << " (+ main thread), " << reps << " passes" << endl;
+	report(cout, results);
+
+	if (!json.empty() && !writeJson(json, results, js.workers(), reps)) return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,915 @@
+//----------------------------------------------------------------------------
+//
+// cgra_math micro-benchmarks
+// Measures the throughput of hot cgra_math operations over large arrays and
+// compares them to hand-written references (SSE where it makes sense) to see
+// how well the generic templates are optimized. The JSON output uses the
+// same layout as base --benchmark, so perf_compare can gate regressions.
+// With --accuracy, checks the cgra::fast approximations against std instead
+//
+//----------------------------------------------------------------------------
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_BENCH_SSE
+#include <emmintrin.h>
+#endif
+
+// project
+#include <cgra/cgra_fast_math.hpp>
+#include <cgra/cgra_flat_hash.hpp>
+#include <cgra/cgra_math.hpp>
+#include <cgra/cgra_soa.hpp>
+#include <cgra/cgra_transform.hpp>
+
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+
+	// results of one benchmark, times are ns per element
+	struct bench_result {
+		string name;
+		string reference;
+		vector<double> samples;
+		vector<double> ref_samples;
+		double max_error = -1;
+	};
+
+
+	// one benchmark: the cgra_math kernel and a hand-written reference, both
+	// process every element of the data set. error() compares their outputs
+	struct bench_case {
+		string name;
+		string reference;
+		function<void()> run;
+		function<void()> run_ref;
+		function<double()> error;
+
+		bench_case(string name_, string reference_) : name(move(name_)), reference(move(reference_)) { }
+	};
+
+
+	double mean(const vector<double> &v) {
+		if (v.empty()) return 0;
+		return accumulate(v.begin(), v.end(), 0.0) / v.size();
+	}
+
+
+	double percentile(vector<double> v, double p) {
+		if (v.empty()) return 0;
+		sort(v.begin(), v.end());
+		double rank = p / 100 * (v.size() - 1);
+		size_t lo = size_t(floor(rank)), hi = std::min(lo + 1, v.size() - 1);
+		return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+	}
+
+
+	// largest difference relative to the magnitude of the reference value
+	double relativeError(const float *a, const float *b, size_t count) {
+		double e = 0;
+		for (size_t i = 0; i < count; i++) {
+			double d = std::abs(double(a[i]) - double(b[i])) / std::max(1.0, std::abs(double(b[i])));
+			if (!(d <= e)) e = d; // propagates nan
+		}
+		return e;
+	}
+
+
+	// input and output arrays for every benchmark
+	// arrays have one spare element so SSE loads of the last vec3 stay in bounds
+	struct bench_data {
+		size_t n;
+		vector<vec3> a3, b3, r3, s3;
+		vector<vec4> a4, r4, s4;
+		vector<mat4> am, bm, rm, sm;
+		vector<mat3> rn, sn;
+		vector<quat> aq, bq, rq, sq;
+		vector<float> t, rf, sf;
+		vector<size_t> rh, sh;
+		vec3_soa a_soa, b_soa, r_soa;
+		flat_hash_map<ivec3, int> cells;
+		unordered_map<ivec3, int> cells_ref;
+		transform_hierarchy transforms;
+		vector<transform_hierarchy::node> nodes;
+
+		explicit bench_data(size_t n_) : n(n_) {
+			mt19937 rng(1234);
+			uniform_real_distribution<float> dist(-1, 1);
+			auto rnd = [&]() { return dist(rng); };
+
+			a3.resize(n + 1); b3.resize(n + 1); r3.resize(n + 1); s3.resize(n + 1);
+			a4.resize(n); r4.resize(n); s4.resize(n);
+			am.resize(n); bm.resize(n); rm.resize(n); sm.resize(n);
+			rn.resize(n); sn.resize(n);
+			aq.resize(n); bq.resize(n); rq.resize(n); sq.resize(n);
+			t.resize(n); rf.resize(n); sf.resize(n);
+			rh.resize(n); sh.resize(n);
+
+			for (size_t i = 0; i < n; i++) {
+				a3[i] = vec3(rnd(), rnd(), rnd());
+				b3[i] = vec3(rnd(), rnd(), rnd());
+				a4[i] = vec4(rnd(), rnd(), rnd(), 1);
+				// well conditioned affine and rigid transforms
+				am[i] = translate3(vec3(rnd(), rnd(), rnd()) * 10.f)
+					* rotate3(normalize(quat(rnd(), rnd(), rnd(), rnd())))
+					* scale3(vec3(rnd(), rnd(), rnd()) * 0.5f + 1.5f);
+				bm[i] = rotate3(normalize(quat(rnd(), rnd(), rnd(), rnd()))) * translate3(rnd(), rnd(), rnd());
+				aq[i] = normalize(quat(rnd(), rnd(), rnd(), rnd()));
+				bq[i] = normalize(quat(rnd(), rnd(), rnd(), rnd()));
+				t[i] = rnd() * 0.5f + 0.5f;
+			}
+
+			a_soa = vec3_soa(vector<vec3>(a3.begin(), a3.begin() + n));
+			b_soa = vec3_soa(vector<vec3>(b3.begin(), b3.begin() + n));
+
+			// tree with 8 children per node, created breadth first
+			// so node i is also in slot i
+			transforms.reserve(n);
+			for (size_t i = 0; i < n; i++) {
+				auto parent = i ? nodes[(i - 1) / 8] : transform_hierarchy::npos;
+				nodes.push_back(transforms.create(parent, a3[i], aq[i], b3[i] * 0.1f + 1.f));
+			}
+			transforms.update();
+		}
+	};
+
+
+#ifdef MATH_BENCH_SSE
+
+	// loads 4 consecutive vec3 as x, y, z registers (reads one float past the end)
+	inline void load4x3(const vec3 *p, __m128 &x, __m128 &y, __m128 &z) {
+		const float *f = &p[0].x;
+		__m128 r0 = _mm_loadu_ps(f), r1 = _mm_loadu_ps(f + 3), r2 = _mm_loadu_ps(f + 6), r3 = _mm_loadu_ps(f + 9);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		x = r0; y = r1; z = r2;
+	}
+
+	// stores x, y, z registers as 4 consecutive vec3 (writes one float past the end)
+	inline void store4x3(vec3 *p, __m128 x, __m128 y, __m128 z) {
+		float *f = &p[0].x;
+		__m128 w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(f, x);
+		_mm_storeu_ps(f + 3, y);
+		_mm_storeu_ps(f + 6, z);
+		_mm_storeu_ps(f + 9, w);
+	}
+
+	inline __m128 dot4x3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	}
+
+	// column-major mat4 * vec4 as a linear combination of columns
+	inline __m128 mulMat4Vec4(const float *m, __m128 v) {
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+
+#endif
+
+
+	// 4x4 inverse by Laplace expansion over 2x2 sub-determinants
+	// the layout doesn't matter, inverse and transpose commute
+	inline float inverse4x4Ref(const float *a, float *b) {
+		const float s0 = a[0] * a[5] - a[4] * a[1];
+		const float s1 = a[0] * a[6] - a[4] * a[2];
+		const float s2 = a[0] * a[7] - a[4] * a[3];
+		const float s3 = a[1] * a[6] - a[5] * a[2];
+		const float s4 = a[1] * a[7] - a[5] * a[3];
+		const float s5 = a[2] * a[7] - a[6] * a[3];
+		const float c5 = a[10] * a[15] - a[14] * a[11];
+		const float c4 = a[9] * a[15] - a[13] * a[11];
+		const float c3 = a[9] * a[14] - a[13] * a[10];
+		const float c2 = a[8] * a[15] - a[12] * a[11];
+		const float c1 = a[8] * a[14] - a[12] * a[10];
+		const float c0 = a[8] * a[13] - a[12] * a[9];
+		const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		if (!b) return det;
+		const float k = 1 / det;
+		b[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * k;
+		b[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * k;
+		b[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * k;
+		b[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * k;
+		b[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * k;
+		b[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * k;
+		b[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * k;
+		b[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * k;
+		b[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * k;
+		b[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * k;
+		b[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * k;
+		b[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * k;
+		b[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * k;
+		b[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * k;
+		b[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * k;
+		b[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * k;
+		return det;
+	}
+
+
+	// same algorithm as cgra::slerp, written out on plain floats (w, x, y, z)
+	inline void slerpRef(const float *q1, const float *q2, float t, float *r) {
+		float l1 = 1 / sqrt(q1[0] * q1[0] + q1[1] * q1[1] + q1[2] * q1[2] + q1[3] * q1[3]);
+		float l2 = 1 / sqrt(q2[0] * q2[0] + q2[1] * q2[1] + q2[2] * q2[2] + q2[3] * q2[3]);
+		float q[4], p[4];
+		for (int j = 0; j < 4; j++) {
+			q[j] = q1[j] * l1;
+			p[j] = q2[j] * l2;
+		}
+		float d = p[0] * q[0] + p[1] * q[1] + p[2] * q[2] + p[3] * q[3];
+		if (d < 0) {
+			for (int j = 0; j < 4; j++) q[j] = -q[j];
+			d = -d;
+		}
+		float u = 1 - t, v = t;
+		if (1 - d > 0.0001f) {
+			float w = acos(d), k = 1 / sin(w);
+			u = sin((1 - t) * w) * k;
+			v = sin(t * w) * k;
+		}
+		for (int j = 0; j < 4; j++) r[j] = u * p[j] + v * q[j];
+	}
+
+
+	// 64-bit multiply-xorshift over the raw bits, a baseline for std::hash<vec3>
+	inline size_t hash3Ref(const vec3 &v) {
+		uint32_t b[3];
+		memcpy(b, &v.x, sizeof(b));
+		uint64_t h = 73;
+		for (uint32_t x : b) {
+			h = (h ^ x) * 0x9E3779B97F4A7C15ull;
+			h ^= h >> 32;
+		}
+		return size_t(h);
+	}
+
+
+	vector<bench_case> makeCases(bench_data &d) {
+		vector<bench_case> cases;
+		const size_t n = d.n;
+
+		auto vec_error = [](const float *a, const float *b, size_t floats) {
+			return [=]() { return relativeError(a, b, floats); };
+		};
+
+#ifdef MATH_BENCH_SSE
+		const string sse = "sse";
+#else
+		const string sse = "";
+#endif
+
+		{
+			bench_case c("vec3_add", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = d.a3[i] + d.b3[i]; };
+#ifdef MATH_BENCH_SSE
+			// vec3 arrays are contiguous floats, no need to deinterleave
+			c.run_ref = [&d, n]() {
+				const float *a = &d.a3[0].x, *b = &d.b3[0].x;
+				float *r = &d.s3[0].x;
+				size_t i = 0;
+				for (; i + 4 <= 3 * n; i += 4) _mm_storeu_ps(r + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+				for (; i < 3 * n; i++) r[i] = a[i] + b[i];
+			};
+#endif
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("vec3_dot", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rf[i] = dot(d.a3[i], d.b3[i]); };
+#ifdef MATH_BENCH_SSE
+			c.run_ref = [&d, n]() {
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) {
+					__m128 ax, ay, az, bx, by, bz;
+					load4x3(&d.a3[i], ax, ay, az);
+					load4x3(&d.b3[i], bx, by, bz);
+					_mm_storeu_ps(&d.sf[i], dot4x3(ax, ay, az, bx, by, bz));
+				}
+				for (; i < n; i++) d.sf[i] = d.a3[i].x * d.b3[i].x + d.a3[i].y * d.b3[i].y + d.a3[i].z * d.b3[i].z;
+			};
+#endif
+			c.error = vec_error(d.rf.data(), d.sf.data(), n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("vec3_cross", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = cross(d.a3[i], d.b3[i]); };
+#ifdef MATH_BENCH_SSE
+			c.run_ref = [&d, n]() {
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) {
+					__m128 ax, ay, az, bx, by, bz;
+					load4x3(&d.a3[i], ax, ay, az);
+					load4x3(&d.b3[i], bx, by, bz);
+					store4x3(&d.s3[i],
+						_mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)),
+						_mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)),
+						_mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx))
+					);
+				}
+				for (; i < n; i++) {
+					const vec3 &a = d.a3[i], &b = d.b3[i];
+					d.s3[i] = vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+				}
+			};
+#endif
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("vec3_normalize", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = normalize(d.a3[i]); };
+#ifdef MATH_BENCH_SSE
+			c.run_ref = [&d, n]() {
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) {
+					__m128 x, y, z;
+					load4x3(&d.a3[i], x, y, z);
+					__m128 l = _mm_sqrt_ps(dot4x3(x, y, z, x, y, z));
+					store4x3(&d.s3[i], _mm_div_ps(x, l), _mm_div_ps(y, l), _mm_div_ps(z, l));
+				}
+				for (; i < n; i++) {
+					const vec3 &a = d.a3[i];
+					float l = sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+					d.s3[i] = vec3(a.x / l, a.y / l, a.z / l);
+				}
+			};
+#endif
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat4_mul_mat4", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rm[i] = d.am[i] * d.bm[i]; };
+#ifdef MATH_BENCH_SSE
+			c.run_ref = [&d, n]() {
+				for (size_t i = 0; i < n; i++) {
+					const float *a = &d.am[i][0][0], *b = &d.bm[i][0][0];
+					float *r = &d.sm[i][0][0];
+					for (int j = 0; j < 4; j++) _mm_storeu_ps(r + 4 * j, mulMat4Vec4(a, _mm_loadu_ps(b + 4 * j)));
+				}
+			};
+#endif
+			c.error = vec_error(&d.rm[0][0][0], &d.sm[0][0][0], 16 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat4_mul_vec4", sse);
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r4[i] = d.am[i] * d.a4[i]; };
+#ifdef MATH_BENCH_SSE
+			c.run_ref = [&d, n]() {
+				for (size_t i = 0; i < n; i++) {
+					_mm_storeu_ps(&d.s4[i].x, mulMat4Vec4(&d.am[i][0][0], _mm_loadu_ps(&d.a4[i].x)));
+				}
+			};
+#endif
+			c.error = vec_error(&d.r4[0].x, &d.s4[0].x, 4 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat4_inverse", "scalar");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rm[i] = inverse(d.am[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) inverse4x4Ref(&d.am[i][0][0], &d.sm[i][0][0]); };
+			c.error = vec_error(&d.rm[0][0][0], &d.sm[0][0][0], 16 * n);
+			cases.push_back(c);
+		}
+
+		// specialized inverses against the general one
+		{
+			bench_case c("mat4_inverse_affine", "inverse");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rm[i] = inverse_affine(d.am[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.sm[i] = inverse(d.am[i]); };
+			c.error = vec_error(&d.rm[0][0][0], &d.sm[0][0][0], 16 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat4_inverse_rigid", "inverse");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rm[i] = inverse_rigid(d.bm[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.sm[i] = inverse(d.bm[i]); };
+			c.error = vec_error(&d.rm[0][0][0], &d.sm[0][0][0], 16 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat3_normal_matrix", "inverse");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rn[i] = inverse_transpose3x3(d.am[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.sn[i] = mat3(transpose(inverse(d.am[i]))); };
+			c.error = vec_error(&d.rn[0][0][0], &d.sn[0][0][0], 9 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("mat4_determinant", "scalar");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rf[i] = determinant(d.am[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.sf[i] = inverse4x4Ref(&d.am[i][0][0], nullptr); };
+			c.error = vec_error(d.rf.data(), d.sf.data(), n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("quat_slerp", "scalar");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rq[i] = slerp(d.aq[i], d.bq[i], d.t[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) slerpRef(&d.aq[i].w, &d.bq[i].w, d.t[i], &d.sq[i].w); };
+			c.error = vec_error(&d.rq[0].w, &d.sq[0].w, 4 * n);
+			cases.push_back(c);
+		}
+
+		// structure-of-arrays kernels against the same cgra_math loops on arrays of vec3
+		{
+			bench_case c("soa_transform_points", "aos");
+			c.run = [&d]() { transform_points(d.am[0], d.a_soa, d.r_soa); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = vec3(d.am[0] * vec4(d.a3[i], 1)); };
+			c.error = [&d, n]() {
+				vector<vec3> r = d.r_soa.to_vector();
+				return relativeError(&r[0].x, &d.s3[0].x, 3 * n);
+			};
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("soa_normalize", "aos");
+			c.run = [&d]() { normalize(d.a_soa, d.r_soa); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = normalize(d.a3[i]); };
+			c.error = [&d, n]() {
+				vector<vec3> r = d.r_soa.to_vector();
+				return relativeError(&r[0].x, &d.s3[0].x, 3 * n);
+			};
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("soa_min_max", "aos");
+			c.run = [&d]() { vec3 lo, hi; min_max(d.a_soa, lo, hi); d.r3[0] = lo; d.r3[1] = hi; };
+			c.run_ref = [&d, n]() {
+				vec3 lo = d.a3[0], hi = d.a3[0];
+				for (size_t i = 1; i < n; i++) {
+					lo = min(lo, d.a3[i]);
+					hi = max(hi, d.a3[i]);
+				}
+				d.s3[0] = lo;
+				d.s3[1] = hi;
+			};
+			c.error = [&d]() { return relativeError(&d.r3[0].x, &d.s3[0].x, 6); };
+			cases.push_back(c);
+		}
+
+		// counter-based random numbers against the scalar engine, the results should match
+		{
+			bench_case c("random_fill_vec3", "scalar");
+			c.run = [&d, n]() { random_fill(d.r3.data(), n, vec3(-1), vec3(1), 42); };
+			c.run_ref = [&d, n]() {
+				philox4x32 g(42);
+				uniform_vec_distribution<float, 3> dist({vec3(-1), vec3(1)});
+				for (size_t i = 0; i < n; i++) {
+					g.seek(i);
+					d.s3[i] = dist(g);
+				}
+			};
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		// cgra::fast approximations against the exact versions, the error is the
+		// largest absolute difference (relative for values larger than 1)
+		{
+			bench_case c("fast_normalize", "exact");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = fast::normalize(d.a3[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = normalize(d.a3[i]); };
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("fast_sin", "exact");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = fast::sin(d.a3[i] * 100.f); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = sin(d.a3[i] * 100.f); };
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("fast_atan2", "exact");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = fast::atan2(d.a3[i], d.b3[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = atan(d.a3[i], d.b3[i]); };
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("fast_exp", "exact");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = fast::exp(d.a3[i] * 10.f); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = exp(d.a3[i] * 10.f); };
+			// relative error for the large values
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("fast_log", "exact");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.r3[i] = fast::log(abs(d.a3[i]) * 100.f); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = log(abs(d.a3[i]) * 100.f); };
+			c.error = vec_error(&d.r3[0].x, &d.s3[0].x, 3 * n);
+			cases.push_back(c);
+		}
+
+		{
+			bench_case c("fast_sin_soa", "exact");
+			c.run = [&d]() { fast::sin(d.a_soa, d.r_soa); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.s3[i] = sin(d.a3[i]); };
+			c.error = [&d, n]() {
+				vector<vec3> r = d.r_soa.to_vector();
+				return relativeError(&r[0].x, &d.s3[0].x, 3 * n);
+			};
+			cases.push_back(c);
+		}
+
+		// moving 1% of the nodes (all leaves) against recomputing the whole hierarchy
+		{
+			bench_case c("transform_update", "full");
+			c.run = [&d, n]() {
+				for (size_t i = n - n / 100; i < n; i++) d.transforms.set_rotation(d.nodes[i], d.aq[i]);
+				d.transforms.update();
+			};
+			c.run_ref = [&d, n]() {
+				for (size_t i = 0; i < n; i++) {
+					mat4 m = rotate3(d.aq[i]);
+					const vec3 s = d.b3[i] * 0.1f + 1.f;
+					m[0] *= s.x;
+					m[1] *= s.y;
+					m[2] *= s.z;
+					m[3] = vec4(d.a3[i], 1);
+					d.sm[i] = i ? d.sm[(i - 1) / 8] * m : m;
+				}
+			};
+			c.error = vec_error(d.transforms.world_matrices()[0].data(), d.sm[0].data(), 16 * n);
+			cases.push_back(c);
+		}
+
+		// spatial hashing, count the points in each grid cell (32^3 cells)
+		auto grid_cell = [](const vec3 &p) { return ivec3(floor(p * 16.f)); };
+
+		{
+			bench_case c("flat_hash_insert", "unordered_map");
+			c.run = [&d, n, grid_cell]() {
+				d.cells.clear();
+				for (size_t i = 0; i < n; i++) d.cells[grid_cell(d.a3[i])]++;
+			};
+			c.run_ref = [&d, n, grid_cell]() {
+				d.cells_ref.clear();
+				for (size_t i = 0; i < n; i++) d.cells_ref[grid_cell(d.a3[i])]++;
+			};
+			// number of cells that differ
+			c.error = [&d]() {
+				double e = std::abs(double(d.cells.size()) - double(d.cells_ref.size()));
+				for (auto &cell : d.cells_ref) {
+					auto it = d.cells.find(cell.first);
+					if (it == d.cells.end() || it->second != cell.second) e++;
+				}
+				return e;
+			};
+			cases.push_back(c);
+		}
+
+		{
+			// uses the cells from flat_hash_insert
+			bench_case c("flat_hash_find", "unordered_map");
+			c.run = [&d, n, grid_cell]() {
+				for (size_t i = 0; i < n; i++) {
+					auto it = d.cells.find(grid_cell(d.b3[i]));
+					d.rh[i] = it == d.cells.end() ? 0 : it->second;
+				}
+			};
+			c.run_ref = [&d, n, grid_cell]() {
+				for (size_t i = 0; i < n; i++) {
+					auto it = d.cells_ref.find(grid_cell(d.b3[i]));
+					d.sh[i] = it == d.cells_ref.end() ? 0 : it->second;
+				}
+			};
+			c.error = [&d, n]() {
+				double e = 0;
+				for (size_t i = 0; i < n; i++) e += d.rh[i] != d.sh[i];
+				return e;
+			};
+			cases.push_back(c);
+		}
+
+		{
+			// different hash functions, so there is nothing to compare
+			bench_case c("vec3_hash", "scalar");
+			c.run = [&d, n]() { for (size_t i = 0; i < n; i++) d.rh[i] = std::hash<vec3>()(d.a3[i]); };
+			c.run_ref = [&d, n]() { for (size_t i = 0; i < n; i++) d.rh[i] ^= hash3Ref(d.a3[i]); };
+			cases.push_back(c);
+		}
+
+		return cases;
+	}
+
+
+	// ns per element for one pass over the data
+	double timePass(const function<void()> &f, size_t n) {
+		auto start = chrono::steady_clock::now();
+		f();
+		auto end = chrono::steady_clock::now();
+		return chrono::duration<double, nano>(end - start).count() / n;
+	}
+
+
+	bench_result runCase(const bench_case &c, size_t n, int reps) {
+		bench_result r;
+		r.name = c.name;
+		r.reference = c.run_ref ? c.reference : "";
+
+		// one untimed pass of each to warm the caches and check the outputs
+		c.run();
+		if (c.run_ref) c.run_ref();
+		if (c.error) r.max_error = c.error();
+
+		// interleave the two so that clock and thermal changes affect both
+		for (int i = 0; i < reps; i++) {
+			r.samples.push_back(timePass(c.run, n));
+			if (c.run_ref) r.ref_samples.push_back(timePass(c.run_ref, n));
+		}
+		return r;
+	}
+
+
+	void report(ostream &out, const vector<bench_result> &results) {
+		out << fixed << setprecision(3);
+		out << left << setw(20) << "benchmark" << right << setw(10) << "ns/op" << setw(10) << "min";
+		out << setw(10) << "ref" << setw(10) << "ratio" << setw(12) << "max error" << endl;
+		for (auto &r : results) {
+			double p50 = percentile(r.samples, 50);
+			out << left << setw(20) << r.name << right << setw(10) << p50;
+			out << setw(10) << *min_element(r.samples.begin(), r.samples.end());
+			if (!r.ref_samples.empty()) {
+				double ref = percentile(r.ref_samples, 50);
+				out << setw(10) << ref << setw(9) << p50 / ref << 'x';
+			}
+			else {
+				out << setw(10) << "-" << setw(10) << "-";
+			}
+			if (r.max_error >= 0) out << setw(12) << scientific << setprecision(2) << r.max_error << fixed << setprecision(3);
+			else out << setw(12) << "-";
+			out << "  " << r.reference << endl;
+		}
+		out << defaultfloat;
+	}
+
+
+	bool writeJson(const string &filename, const vector<bench_result> &results, size_t n, int reps) {
+		ofstream out(filename);
+		if (!out) {
+			cerr << "Error: Could not open file " << filename << " for writing" << endl;
+			return false;
+		}
+
+		auto array = [&](const vector<double> &v) {
+			out << "[";
+			for (size_t i = 0; i < v.size(); i++) out << (i ? ", " : "") << v[i];
+			out << "]";
+		};
+
+		out << setprecision(9);
+		out << "{" << endl;
+		out << "\t\"scene\": \"math\"," << endl;
+		out << "\t\"size\": " << n << "," << endl;
+		out << "\t\"reps\": " << reps << "," << endl;
+		out << "\t\"timestamp\": " << chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() << "," << endl;
+		out << "\t\"metrics\": {" << endl;
+		for (size_t i = 0; i < results.size(); i++) {
+			auto &r = results[i];
+			out << "\t\t\"" << r.name << "\": {" << endl;
+			out << "\t\t\t\"mean\": " << mean(r.samples) << "," << endl;
+			out << "\t\t\t\"p50\": " << percentile(r.samples, 50) << "," << endl;
+			out << "\t\t\t\"min\": " << *min_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			out << "\t\t\t\"max\": " << *max_element(r.samples.begin(), r.samples.end()) << "," << endl;
+			if (!r.ref_samples.empty()) {
+				out << "\t\t\t\"reference\": \"" << r.reference << "\"," << endl;
+				out << "\t\t\t\"ref_p50\": " << percentile(r.ref_samples, 50) << "," << endl;
+				out << "\t\t\t\"ratio\": " << percentile(r.samples, 50) / percentile(r.ref_samples, 50) << "," << endl;
+			}
+			out << "\t\t\t\"max_error\": " << r.max_error << "," << endl;
+			out << "\t\t\t\"samples\": ";
+			array(r.samples);
+			out << endl << "\t\t}" << (i + 1 < results.size() ? "," : "") << endl;
+		}
+		out << "\t}" << endl << "}" << endl;
+
+		cout << "Wrote benchmark: " << filename << endl;
+		return bool(out);
+	}
+
+
+	// one function checked by --accuracy, with x in [x0, x1] and y in [y0, y1]
+	struct accuracy_case {
+		string name;
+		float x0, x1, y0, y1;
+		bool log_x;       // sample x log-uniformly instead of uniformly
+		bool relative;    // error relative to the exact value
+		double bound;     // documented maximum error
+		function<float(float, float)> fast;
+		function<float(float, float)> fast_vec;
+		function<void(const vector<float> &, const vector<float> &, vector<float> &)> fast_bulk;
+		function<double(double, double)> exact;
+		function<double(double, double)> scale; // error is divided by this (if set)
+	};
+
+
+	// largest error of each cgra::fast function against the std version (in
+	// double precision) over the ranges documented in cgra_fast_math.hpp, and
+	// whether the scalar, vector and bulk versions give identical results
+	bool checkAccuracy(size_t samples) {
+		auto bulk = [](void (*f)(const float *, float *, size_t)) {
+			return [f](const vector<float> &x, const vector<float> &, vector<float> &r) { f(x.data(), r.data(), x.size()); };
+		};
+
+		auto bulk2 = [](void (*f)(const float *, const float *, float *, size_t)) {
+			return [f](const vector<float> &x, const vector<float> &y, vector<float> &r) { f(x.data(), y.data(), r.data(), x.size()); };
+		};
+
+		vector<accuracy_case> cases;
+		cases.push_back({ "rsqrt", 1e-30f, 1e30f, 0, 0, true, true, 4e-7,
+			[](float x, float) { return fast::rsqrt(x); },
+			[](float x, float) { return fast::rsqrt(vec3(x)).z; },
+			bulk(fast::rsqrt),
+			[](double x, double) { return 1 / std::sqrt(x); }, nullptr });
+		cases.push_back({ "sqrt", 1e-30f, 1e30f, 0, 0, true, true, 4e-7,
+			[](float x, float) { return fast::sqrt(x); },
+			[](float x, float) { return fast::sqrt(vec3(x)).z; },
+			bulk(fast::sqrt),
+			[](double x, double) { return std::sqrt(x); }, nullptr });
+		cases.push_back({ "sin", -8192, 8192, 0, 0, false, false, 1.5e-7,
+			[](float x, float) { return fast::sin(x); },
+			[](float x, float) { return fast::sin(vec3(x)).z; },
+			bulk(fast::sin),
+			[](double x, double) { return std::sin(x); }, nullptr });
+		cases.push_back({ "cos", -8192, 8192, 0, 0, false, false, 1.5e-7,
+			[](float x, float) { return fast::cos(x); },
+			[](float x, float) { return fast::cos(vec3(x)).z; },
+			bulk(fast::cos),
+			[](double x, double) { return std::cos(x); }, nullptr });
+		cases.push_back({ "atan2", -100, 100, -100, 100, false, false, 3e-7,
+			[](float y, float x) { return fast::atan2(y, x); },
+			[](float y, float x) { return fast::atan2(vec3(y), vec3(x)).z; },
+			bulk2(fast::atan2),
+			[](double y, double x) { return std::atan2(y, x); }, nullptr });
+		cases.push_back({ "exp", -87.3f, 88.7f, 0, 0, false, true, 1.5e-7,
+			[](float x, float) { return fast::exp(x); },
+			[](float x, float) { return fast::exp(vec3(x)).z; },
+			bulk(fast::exp),
+			[](double x, double) { return std::exp(x); }, nullptr });
+		cases.push_back({ "log", 0.5f, 2, 0, 0, false, false, 1e-7,
+			[](float x, float) { return fast::log(x); },
+			[](float x, float) { return fast::log(vec3(x)).z; },
+			bulk(fast::log),
+			[](double x, double) { return std::log(x); }, nullptr });
+		cases.push_back({ "log", 1e-45f, 0.5f, 0, 0, true, true, 1.5e-7,
+			[](float x, float) { return fast::log(x); },
+			[](float x, float) { return fast::log(vec3(x)).z; },
+			bulk(fast::log),
+			[](double x, double) { return std::log(x); }, nullptr });
+		cases.push_back({ "log", 2, 3e38f, 0, 0, true, true, 1.5e-7,
+			[](float x, float) { return fast::log(x); },
+			[](float x, float) { return fast::log(vec3(x)).z; },
+			bulk(fast::log),
+			[](double x, double) { return std::log(x); }, nullptr });
+		cases.push_back({ "pow", 0.01f, 100, -8, 8, true, true, 2e-7,
+			[](float x, float y) { return fast::pow(x, y); },
+			[](float x, float y) { return fast::pow(vec3(x), vec3(y)).z; },
+			bulk2(fast::pow),
+			[](double x, double y) { return std::pow(x, y); },
+			[](double x, double y) { return 1 + std::abs(y * std::log(x)); } });
+		cases.push_back({ "normalize", -100, 100, -100, 100, false, false, 4e-7,
+			[](float x, float y) { return fast::normalize(vec3(x, y, 1)).x; },
+			[](float x, float y) { return fast::normalize(vec4(x, y, 1, 0)).x; },
+			[](const vector<float> &x, const vector<float> &y, vector<float> &r) {
+				vec3_soa v(x.size()), n;
+				for (size_t i = 0; i < x.size(); i++) v.set(i, vec3(x[i], y[i], 1));
+				fast::normalize(v, n);
+				copy(n.x(), n.x() + n.size(), r.begin());
+			},
+			[](double x, double y) { return x / std::sqrt(x * x + y * y + 1); }, nullptr });
+
+		mt19937 rng(4321);
+		bool pass = true;
+
+		cout << "cgra::fast accuracy: " << samples << " samples per range" << endl;
+		cout << left << setw(12) << "function" << setw(26) << "range" << right;
+		cout << setw(12) << "max error" << setw(12) << "bound" << setw(12) << "mismatch" << endl;
+		for (auto &c : cases) {
+			uniform_real_distribution<float> ydist(c.y0, c.y1);
+			vector<float> x(samples), y(samples), r(samples);
+			for (size_t i = 0; i < samples; i++) {
+				const double t = (i + 0.5) / samples;
+				x[i] = c.log_x ? float(std::exp(std::log(c.x0) + (std::log(c.x1) - std::log(c.x0)) * t)) : float(c.x0 + (c.x1 - c.x0) * t);
+				y[i] = c.y0 < c.y1 ? ydist(rng) : c.y0;
+			}
+			c.fast_bulk(x, y, r);
+
+			double e = 0;
+			size_t mismatch = 0;
+			for (size_t i = 0; i < samples; i++) {
+				const float f = c.fast(x[i], y[i]), fv = c.fast_vec(x[i], y[i]);
+				if (memcmp(&f, &r[i], sizeof(f)) != 0 || memcmp(&f, &fv, sizeof(f)) != 0) mismatch++;
+				const double exact = c.exact(x[i], y[i]);
+				double d = std::abs(double(f) - exact);
+				if (c.relative) d /= std::abs(exact);
+				if (c.scale) d /= c.scale(x[i], y[i]);
+				if (!(d <= e)) e = d; // propagates nan
+			}
+
+			const bool ok = e <= c.bound && mismatch == 0;
+			pass = pass && ok;
+			ostringstream range;
+			range << "[" << c.x0 << ", " << c.x1 << "]";
+			cout << left << setw(12) << c.name << setw(26) << range.str() << right << scientific << setprecision(2);
+			cout << setw(12) << e << setw(12) << c.bound << defaultfloat << setw(12) << mismatch;
+			cout << (ok ? "" : "  FAIL") << endl;
+		}
+		return pass;
+	}
+
+
+	void printUsage(const char *exe) {
+		cout << "Usage: " << exe << " [options]" << endl;
+		cout << "  --size N       elements per pass (default 65536)" << endl;
+		cout << "  --reps N       timed passes per benchmark (default 50)" << endl;
+		cout << "  --filter TEXT  only run benchmarks whose name contains TEXT" << endl;
+		cout << "  --json FILE    write results (compare runs with perf_compare)" << endl;
+		cout << "  --accuracy     check the cgra::fast approximations instead (16 * size samples each)" << endl;
+	}
+
+}
+
+
+int main(int argc, char **argv) {
+	size_t n = 1 << 16;
+	int reps = 50;
+	string filter, json;
+	bool accuracy = false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc) n = size_t(atol(argv[++i]));
+		else if (arg == "--reps" && i + 1 < argc) reps = atoi(argv[++i]);
+		else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--json" && i + 1 < argc) json = argv[++i];
+		else if (arg == "--accuracy") accuracy = true;
+		else {
+			printUsage(argv[0]);
+			return arg == "--help" ? EXIT_SUCCESS : 2;
+		}
+	}
+	if (n == 0 || reps <= 0) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	if (accuracy) return checkAccuracy(16 * n) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	bench_data data(n);
+	vector<bench_result> results;
+	for (auto &c : makeCases(data)) {
+		if (c.name.find(filter) == string::npos) continue;
+		results.push_back(runCase(c, n, reps));
+	}
+	if (results.empty()) {
+		cerr << "Error: No benchmarks match '" << filter << "'" << endl;
+		return 2;
+	}
+
+	cout << "cgra_math: " << n << " elements, " << reps << " passes" << endl;
+	report(cout, results);
+
+	if (!json.empty() && !writeJson(json, results, n, reps)) return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+//----------------------------------------------------------------------------
+//
+// Performance regression gate
+// Compares a benchmark JSON (from base --benchmark --json) against a baseline
+// and exits non-zero if any metric regressed significantly
+//
+//----------------------------------------------------------------------------
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+namespace {
+
+	// minimal JSON value, enough for the benchmark output
+	struct json {
+		enum kind_t { null_t, number_t, string_t, array_t, object_t, bool_t } kind = null_t;
+		double number = 0;
+		string text;
+		vector<json> items;
+		map<string, json> members;
+
+		const json * get(const string &key) const {
+			auto it = members.find(key);
+			return it == members.end() ? nullptr : &it->second;
+		}
+	};
+
+
+	class json_parser {
+	private:
+		const string &m_src;
+		size_t m_pos = 0;
+
+		void skip() {
+			while (m_pos < m_src.size() && isspace((unsigned char)m_src[m_pos])) m_pos++;
+		}
+
+		char peek() {
+			skip();
+			if (m_pos >= m_src.size()) throw runtime_error("unexpected end of JSON");
+			return m_src[m_pos];
+		}
+
+		void expect(char c) {
+			if (peek() != c) throw runtime_error(string("expected '") + c + "' in JSON at " + to_string(m_pos));
+			m_pos++;
+		}
+
+		string parseString() {
+			expect('"');
+			string s;
+			while (m_pos < m_src.size() && m_src[m_pos] != '"') {
+				if (m_src[m_pos] == '\\' && m_pos + 1 < m_src.size()) m_pos++;
+				s += m_src[m_pos++];
+			}
+			expect('"');
+			return s;
+		}
+
+	public:
+		explicit json_parser(const string &src) : m_src(src) { }
+
+		json parse() {
+			json v;
+			char c = peek();
+			if (c == '{') {
+				v.kind = json::object_t;
+				m_pos++;
+				if (peek() == '}') { m_pos++; return v; }
+				do {
+					string key = parseString();
+					expect(':');
+					v.members[key] = parse();
+				} while (peek() == ',' && ++m_pos);
+				expect('}');
+			}
+			else if (c == '[') {
+				v.kind = json::array_t;
+				m_pos++;
+				if (peek() == ']') { m_pos++; return v; }
+				do {
+					v.items.push_back(parse());
+				} while (peek() == ',' && ++m_pos);
+				expect(']');
+			}
+			else if (c == '"') {
+				v.kind = json::string_t;
+				v.text = parseString();
+			}
+			else if (m_src.compare(m_pos, 4, "true") == 0 || m_src.compare(m_pos, 5, "false") == 0) {
+				v.kind = json::bool_t;
+				v.number = (c == 't');
+				m_pos += (c == 't') ? 4 : 5;
+			}
+			else if (m_src.compare(m_pos, 4, "null") == 0) {
+				m_pos += 4;
+			}
+			else {
+				v.kind = json::number_t;
+				const char *begin = m_src.c_str() + m_pos;
+				char *end = nullptr;
+				v.number = strtod(begin, &end);
+				if (end == begin) throw runtime_error("bad JSON value at " + to_string(m_pos));
+				m_pos += end - begin;
+			}
+			return v;
+		}
+	};
+
+
+	json loadJson(const string &filename) {
+		ifstream in(filename);
+		if (!in) throw runtime_error("could not open " + filename);
+		stringstream buffer;
+		buffer << in.rdbuf();
+		return json_parser(buffer.str()).parse();
+	}
+
+
+	// Mann-Whitney U test, one sided: probability of seeing samples of b at
+	// least this much larger than a if both come from the same distribution.
+	// Uses the normal approximation with tie correction (fine for n > 20)
+	double mannWhitneyGreater(const vector<double> &a, const vector<double> &b) {
+		const double n1 = double(a.size()), n2 = double(b.size());
+		if (a.empty() || b.empty()) return 1;
+
+		// rank all samples together, averaging ties
+		vector<pair<double, int>> all;
+		for (double x : a) all.emplace_back(x, 0);
+		for (double x : b) all.emplace_back(x, 1);
+		sort(all.begin(), all.end());
+
+		double rank_sum_b = 0, tie_term = 0;
+		for (size_t i = 0; i < all.size(); ) {
+			size_t j = i;
+			while (j < all.size() && all[j].first == all[i].first) j++;
+			double rank = (i + 1 + j) / 2.0;
+			double t = double(j - i);
+			tie_term += t * t * t - t;
+			for (size_t k = i; k < j; k++) {
+				if (all[k].second == 1) rank_sum_b += rank;
+			}
+			i = j;
+		}
+
+		const double n = n1 + n2;
+		double u = rank_sum_b - n2 * (n2 + 1) / 2;
+		double mean = n1 * n2 / 2;
+		double var = n1 * n2 / 12 * ((n + 1) - tie_term / (n * (n - 1)));
+		if (var <= 0) return 1;
+
+		// continuity correction
+		double z = (u - mean - 0.5) / sqrt(var);
+		return 0.5 * erfc(z / sqrt(2.0));
+	}
+
+
+	double percentile(vector<double> v, double p) {
+		if (v.empty()) return 0;
+		sort(v.begin(), v.end());
+		double rank = p / 100 * (v.size() - 1);
+		size_t lo = size_t(floor(rank)), hi = min(lo + 1, v.size() - 1);
+		return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+	}
+
+
+	vector<double> samples(const json &metric) {
+		vector<double> s;
+		if (const json *arr = metric.get("samples")) {
+			for (auto &x : arr->items) s.push_back(x.number);
+		}
+		return s;
+	}
+
+
+	void printUsage(const char *exe) {
+		cout << "Usage: " << exe << " BASELINE.json NEW.json [options]" << endl;
+		cout << "  --threshold PCT  relative increase that counts as a regression (default 5)" << endl;
+		cout << "  --single-threshold PCT" << endl;
+		cout << "                   the same for the single-sample load time and peak memory (default 20)" << endl;
+		cout << "  --alpha P        significance level for the Mann-Whitney U test (default 0.01)" << endl;
+	}
+
+}
+
+
+int main(int argc, char **argv) {
+	vector<string> files;
+	double threshold = 5;
+	double single_threshold = 20;
+	double alpha = 0.01;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--threshold" && i + 1 < argc) threshold = atof(argv[++i]);
+		else if (arg == "--single-threshold" && i + 1 < argc) single_threshold = atof(argv[++i]);
+		else if (arg == "--alpha" && i + 1 < argc) alpha = atof(argv[++i]);
+		else if (arg.compare(0, 2, "--") != 0) files.push_back(arg);
+		else {
+			printUsage(argv[0]);
+			return arg == "--help" ? EXIT_SUCCESS : 2;
+		}
+	}
+	if (files.size() != 2) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	json base, next;
+	try {
+		base = loadJson(files[0]);
+		next = loadJson(files[1]);
+	}
+	catch (exception &e) {
+		cerr << "Error: " << e.what() << endl;
+		return 2;
+	}
+
+	if (base.get("scene") && next.get("scene") && base.get("scene")->text != next.get("scene")->text) {
+		cerr << "Warning: comparing different scenes" << endl;
+	}
+
+	int regressions = 0;
+	cout << fixed << setprecision(3);
+	cout << left << setw(24) << "metric" << right << setw(12) << "baseline" << setw(12) << "new";
+	cout << setw(10) << "change" << setw(10) << "p-value" << "  result" << endl;
+
+	// anything in the baseline that the new run lacks is an error, not a pass
+	int missing = 0, compared = 0;
+	auto absent = [&](const string &name) {
+		cerr << "Error: " << name << " is in the baseline but not in " << files[1] << endl;
+		missing++;
+	};
+
+	auto line = [&](const string &name, double b, double n, double p, bool significant, double limit) {
+		compared++;
+		double change = (b != 0) ? (n - b) / b * 100 : 0;
+		bool regressed = significant && change > limit;
+		regressions += regressed;
+		cout << left << setw(24) << name << right << setw(12) << b << setw(12) << n;
+		cout << setw(9) << change << '%';
+		if (p >= 0) cout << setw(10) << p;
+		else cout << setw(10) << "-";
+		cout << "  " << (regressed ? "REGRESSION" : "ok") << endl;
+	};
+
+	// single values have no samples to test and vary more from run to run,
+	// so only their own looser threshold applies
+	for (const char *scalar : { "load_ms", "peak_memory_kb" }) {
+		const json *b = base.get(scalar), *n = next.get(scalar);
+		if (b && n) line(scalar, b->number, n->number, -1, true, single_threshold);
+		else if (b) absent(scalar);
+	}
+
+	// per-frame samples: a regression must be significant and beyond the threshold
+	const json *base_metrics = base.get("metrics"), *next_metrics = next.get("metrics");
+	if (base_metrics) {
+		for (auto &m : base_metrics->members) {
+			const json *other = next_metrics ? next_metrics->get(m.first) : nullptr;
+			vector<double> sb = samples(m.second), sn = other ? samples(*other) : vector<double>();
+			if (sb.empty()) continue;
+			if (sn.empty()) {
+				absent(m.first);
+				continue;
+			}
+			double p = mannWhitneyGreater(sb, sn);
+			for (double pct : { 50.0, 95.0, 99.0 }) {
+				ostringstream name;
+				name << m.first << " p" << int(pct);
+				line(name.str(), percentile(sb, pct), percentile(sn, pct), p, p < alpha, threshold);
+			}
+		}
+	}
+
+	if (missing || !compared) {
+		if (!compared) cerr << "Error: no metrics to compare" << endl;
+		return 2;
+	}
+	if (regressions) {
+		cout << regressions << " regression(s)" << endl;
+		return EXIT_FAILURE;
+	}
+	cout << "No significant regressions" << endl;
+	return EXIT_SUCCESS;
+}